@@ -0,0 +1,361 @@
+// advisor.c
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "advisor.h"
+#include "pattern_math.h"
+
+// Function to reset the advisor
+void advisor_init(PatternAdvisor *advisor) {
+    memset(advisor, 0, sizeof(*advisor));
+}
+
+// Function to release the cached system
+void advisor_free(PatternAdvisor *advisor) {
+    free(advisor->inverse);
+    free(advisor->g);
+    free(advisor->w);
+    advisor_init(advisor);
+}
+
+// Function to get Conway's leading number a : b (sum of 2^(k-1) over the
+// k for which the last k tosses of a equal the first k tosses of b)
+static double correlation(PatternKey a, PatternKey b) {
+    return (double)pattern_correlation_vector(a.pattern, a.length, b.pattern, b.length);
+}
+
+// Function to order patterns by length, then bits
+static int compare_keys(const void *left, const void *right) {
+    const PatternKey *a = left, *b = right;
+    if (a->length != b->length) {
+        return a->length - b->length;
+    }
+    return (a->pattern > b->pattern) - (a->pattern < b->pattern);
+}
+
+// Function to invert an n x n matrix in place (Gauss-Jordan, partial pivoting).
+// Returns -1 if it is singular.
+static int invert(double *matrix, double *inverse, int n) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            inverse[i * n + j] = i == j;
+        }
+    }
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < n; row++) {
+            if (fabs(matrix[row * n + col]) > fabs(matrix[pivot * n + col])) {
+                pivot = row;
+            }
+        }
+        if (fabs(matrix[pivot * n + col]) < 1e-12) {
+            return -1;
+        }
+        if (pivot != col) {
+            for (int j = 0; j < n; j++) {
+                double t = matrix[col * n + j];
+                matrix[col * n + j] = matrix[pivot * n + j];
+                matrix[pivot * n + j] = t;
+                t = inverse[col * n + j];
+                inverse[col * n + j] = inverse[pivot * n + j];
+                inverse[pivot * n + j] = t;
+            }
+        }
+        double scale = 1.0 / matrix[col * n + col];
+        for (int j = 0; j < n; j++) {
+            matrix[col * n + j] *= scale;
+            inverse[col * n + j] *= scale;
+        }
+        for (int row = 0; row < n; row++) {
+            double factor = matrix[row * n + col];
+            if (row == col || factor == 0) {
+                continue;
+            }
+            for (int j = 0; j < n; j++) {
+                matrix[row * n + j] -= factor * matrix[col * n + j];
+                inverse[row * n + j] -= factor * inverse[col * n + j];
+            }
+        }
+    }
+    return 0;
+}
+
+// Function to reduce a table to its distinct patterns that can win, and solve
+// it unless the same composition is already solved. Returns -1 on failure.
+static int prepare_field(PatternAdvisor *advisor, const PatternKey table[], int table_count) {
+    if (table_count < 1 || table_count > ADVISOR_MAX_FIELD) {
+        return -1;
+    }
+    PatternKey *sorted = malloc(sizeof(PatternKey) * table_count);
+    if (!sorted) {
+        return -1;
+    }
+    memcpy(sorted, table, sizeof(PatternKey) * table_count);
+    qsort(sorted, table_count, sizeof(PatternKey), compare_keys);
+
+    // Composition: FNV-1a over the distinct patterns
+    uint64_t composition = 0xCBF29CE484222325ULL;
+    int distinct = 0;
+    for (int i = 0; i < table_count; i++) {
+        if (distinct > 0 && compare_keys(&sorted[distinct - 1], &sorted[i]) == 0) {
+            continue;
+        }
+        sorted[distinct++] = sorted[i];
+        composition = (composition ^ sorted[i].pattern) * 0x100000001B3ULL;
+        composition = (composition ^ (uint64_t)sorted[i].length) * 0x100000001B3ULL;
+    }
+    if (advisor->solved && advisor->composition == composition) {
+        free(sorted);
+        return 0;
+    }
+
+    // A pattern containing another one can never finish first
+    advisor->field_count = 0;
+    for (int i = 0; i < distinct; i++) {
+        int dominated = 0;
+        for (int j = 0; j < distinct && !dominated; j++) {
+            dominated = j != i && sorted[j].length < sorted[i].length &&
+                        pattern_contains(sorted[i].pattern, sorted[i].length, sorted[j].pattern, sorted[j].length);
+        }
+        if (!dominated) {
+            advisor->field[advisor->field_count++] = sorted[i];
+        }
+    }
+    free(sorted);
+
+    int n = advisor->field_count;
+    if (n > advisor->capacity) {
+        free(advisor->inverse);
+        free(advisor->g);
+        free(advisor->w);
+        advisor->inverse = malloc(sizeof(double) * n * n);
+        advisor->g = malloc(sizeof(double) * n);
+        advisor->w = malloc(sizeof(double) * n);
+        advisor->capacity = advisor->inverse && advisor->g && advisor->w ? n : 0;
+        if (!advisor->capacity) {
+            advisor->solved = 0;
+            return -1;
+        }
+    }
+    double *matrix = malloc(sizeof(double) * n * n);
+    if (!matrix) {
+        advisor->solved = 0;
+        return -1;
+    }
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            matrix[j * n + i] = correlation(advisor->field[i], advisor->field[j]); // C^T
+        }
+    }
+    int result = invert(matrix, advisor->inverse, n);
+    free(matrix);
+    if (result < 0) {
+        advisor->solved = 0;
+        return -1;
+    }
+
+    advisor->g_sum = 0;
+    for (int i = 0; i < n; i++) {
+        advisor->g[i] = 0;
+        advisor->w[i] = 0;
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            advisor->g[i] += advisor->inverse[i * n + j];
+            advisor->w[j] += advisor->inverse[i * n + j];
+        }
+        advisor->g_sum += advisor->g[i];
+    }
+    advisor->composition = composition;
+    advisor->solved = 1;
+    return 0;
+}
+
+// Function to get the win probabilities of a table. Writes the reduced table
+// (patterns that can never win are left out) and returns its size, or -1.
+int advisor_field_odds(PatternAdvisor *advisor, const PatternKey table[], int table_count,
+                       PatternKey field[], double odds[]) {
+    if (prepare_field(advisor, table, table_count) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < advisor->field_count; i++) {
+        field[i] = advisor->field[i];
+        odds[i] = advisor->g[i] / advisor->g_sum;
+    }
+    return advisor->field_count;
+}
+
+// Function to score a candidate against the solved table, -1 if it cannot win
+static double score_candidate(PatternAdvisor *advisor, PatternKey candidate, double *scratch) {
+    int n = advisor->field_count;
+    int removed = 0; // Table patterns containing the candidate never finish first against it
+    int *remove = (int *)(scratch + 3 * n);
+    for (int i = 0; i < n; i++) {
+        PatternKey a = advisor->field[i];
+        if (a.length <= candidate.length &&
+            pattern_contains(candidate.pattern, candidate.length, a.pattern, a.length)) {
+            return -1; // Equal to or containing a table pattern
+        }
+        if (pattern_contains(a.pattern, a.length, candidate.pattern, candidate.length)) {
+            remove[removed++] = i;
+        }
+    }
+    if (removed == n) {
+        return 1;
+    }
+
+    // Border the table's system with the candidate X:
+    //   M y + v z = 1, u^T y + d z = 1 with v_j = X : A_j, u_i = A_i : X, d = X : X
+    //   a = M^-1 1, h = M^-1 v, z = (1 - u.a) / (d - u.h), p_X = z / (sum(a) - z sum(h) + z)
+    // M is the cached C^T, less the rows and columns of removed patterns.
+    double *v = scratch;
+    double *a = scratch + n;
+    double *h = scratch + 2 * n;
+    for (int j = 0; j < n; j++) {
+        v[j] = correlation(candidate, advisor->field[j]);
+    }
+    for (int r = 0; r < removed; r++) {
+        v[remove[r]] = 0;
+    }
+
+    double a_sum = 0, h_sum = 0;
+    if (removed == 0) {
+        // Cached G 1 and G^T 1 leave one matrix-vector product
+        a_sum = advisor->g_sum;
+        for (int i = 0; i < n; i++) {
+            a[i] = advisor->g[i];
+            h_sum += advisor->w[i] * v[i];
+            const double *row = &advisor->inverse[i * n];
+            double sum = 0;
+            for (int j = 0; j < n; j++) {
+                sum += row[j] * v[j];
+            }
+            h[i] = sum;
+        }
+    } else {
+        // Inverse of the kept block R from G (Schur complement of the removed block S):
+        //   M_RR^-1 b = G_RR b - G_RS G_SS^-1 G_SR b
+        double *block = malloc(sizeof(double) * removed * removed * 2 + sizeof(double) * removed * 4);
+        if (!block) {
+            return -1;
+        }
+        double *block_inverse = block + removed * removed;
+        double *sa = block_inverse + removed * removed, *sh = sa + removed;
+        double *ta = sh + removed, *th = ta + removed;
+        for (int r = 0; r < removed; r++) {
+            for (int c = 0; c < removed; c++) {
+                block[r * removed + c] = advisor->inverse[remove[r] * n + remove[c]];
+            }
+        }
+        if (invert(block, block_inverse, removed) < 0) {
+            free(block);
+            return -1;
+        }
+        // a and h over all rows, treating removed entries of 1 and v as zero
+        for (int i = 0; i < n; i++) {
+            const double *row = &advisor->inverse[i * n];
+            double sum_a = 0, sum_h = 0;
+            for (int j = 0; j < n; j++) {
+                sum_a += row[j];
+                sum_h += row[j] * v[j];
+            }
+            for (int r = 0; r < removed; r++) {
+                sum_a -= row[remove[r]];
+            }
+            a[i] = sum_a;
+            h[i] = sum_h;
+        }
+        for (int r = 0; r < removed; r++) {
+            ta[r] = a[remove[r]];
+            th[r] = h[remove[r]];
+        }
+        for (int r = 0; r < removed; r++) {
+            sa[r] = 0;
+            sh[r] = 0;
+            for (int c = 0; c < removed; c++) {
+                sa[r] += block_inverse[r * removed + c] * ta[c];
+                sh[r] += block_inverse[r * removed + c] * th[c];
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            const double *row = &advisor->inverse[i * n];
+            for (int r = 0; r < removed; r++) {
+                a[i] -= row[remove[r]] * sa[r];
+                h[i] -= row[remove[r]] * sh[r];
+            }
+        }
+        free(block);
+        for (int r = 0; r < removed; r++) {
+            a[remove[r]] = 0;
+            h[remove[r]] = 0;
+        }
+        for (int i = 0; i < n; i++) {
+            a_sum += a[i];
+            h_sum += h[i];
+        }
+    }
+
+    double u_a = 0, u_h = 0;
+    for (int i = 0; i < n; i++) {
+        double u = correlation(advisor->field[i], candidate);
+        u_a += u * a[i];
+        u_h += u * h[i];
+    }
+    double d = correlation(candidate, candidate);
+    double z = (1 - u_a) / (d - u_h);
+    return z / (a_sum - z * h_sum + z);
+}
+
+// Function to find the pattern of the given length with the highest win
+// probability against the table. Returns -1 if the table cannot be solved.
+int advisor_best_counter(PatternAdvisor *advisor, const PatternKey table[], int table_count, int length, Advice *advice) {
+    if (length < 1 || length > ADVISOR_MAX_SEARCH_LENGTH || prepare_field(advisor, table, table_count) < 0) {
+        return -1;
+    }
+
+    for (int slot = 0; slot < ADVISOR_CACHE_SLOTS; slot++) {
+        AdviceCacheEntry *entry = &advisor->cache[slot];
+        if (entry->valid && entry->composition == advisor->composition && entry->length == length) {
+            advice->best = entry->best;
+            advice->win_probability = entry->win_probability;
+            advice->candidates = entry->candidates;
+            advice->cached = 1;
+            advisor->hits++;
+            return 0;
+        }
+    }
+    advisor->misses++;
+
+    double *scratch = malloc((sizeof(double) * 3 + sizeof(int)) * advisor->field_count);
+    if (!scratch) {
+        return -1;
+    }
+    advice->win_probability = -1;
+    advice->candidates = 0;
+    advice->cached = 0;
+    for (uint64_t pattern = 0; pattern < (1ULL << length); pattern++) {
+        PatternKey candidate = {pattern, length};
+        double p = score_candidate(advisor, candidate, scratch);
+        advice->candidates++;
+        if (p > advice->win_probability) {
+            advice->win_probability = p;
+            advice->best = candidate;
+        }
+    }
+    free(scratch);
+    if (advice->win_probability < 0) {
+        return -1; // Every candidate contains a table pattern
+    }
+
+    AdviceCacheEntry *entry = &advisor->cache[advisor->cache_next];
+    advisor->cache_next = (advisor->cache_next + 1) % ADVISOR_CACHE_SLOTS;
+    entry->valid = 1;
+    entry->composition = advisor->composition;
+    entry->length = length;
+    entry->best = advice->best;
+    entry->win_probability = advice->win_probability;
+    entry->candidates = advice->candidates;
+    return 0;
+}
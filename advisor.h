@@ -0,0 +1,65 @@
+// advisor.h
+//
+// Pattern advisor: win probabilities of a table of patterns and the best
+// counter-pattern against it. Uses the Guibas-Odlyzko linear system on the
+// patterns' correlations: for the table A_1..A_n the win probabilities p solve
+// sum_i p_i * (A_i : A_j) = constant for every j, with sum_i p_i = 1.
+//
+// The inverted correlation matrix of the table is cached by table
+// composition, so scoring a candidate only borders the cached system
+// (O(n^2) per candidate instead of O(n^3)). Answers are cached too.
+
+#ifndef ADVISOR_H
+#define ADVISOR_H
+
+#include <stdint.h>
+
+#define ADVISOR_MAX_FIELD 4096         // Distinct patterns on a table
+#define ADVISOR_MAX_SEARCH_LENGTH 16   // Longest counter-pattern searched exhaustively
+#define ADVISOR_CACHE_SLOTS 16
+
+typedef struct {
+    uint64_t pattern; // Tosses oldest first, last toss in bit 0 (1 = tails)
+    int length;
+} PatternKey;
+
+typedef struct {
+    PatternKey best;
+    double win_probability;
+    int candidates;   // Candidates scored (not counting cache hits)
+    int cached;       // Answer came from the cache
+} Advice;
+
+typedef struct {
+    uint64_t composition;
+    int length;
+    int valid;
+    PatternKey best;
+    double win_probability;
+    int candidates;
+} AdviceCacheEntry;
+
+typedef struct {
+    // Solved table: the last composition seen
+    uint64_t composition;
+    int solved;
+    PatternKey field[ADVISOR_MAX_FIELD]; // Reduced table: distinct, none contains another
+    int field_count;
+    double *inverse;  // G = (C^T)^-1, row major, C[i][j] = A_i : A_j
+    double *g;        // G * 1, proportional to the table's win probabilities
+    double *w;        // G^T * 1
+    double g_sum;
+    int capacity;     // Rows allocated for inverse
+    AdviceCacheEntry cache[ADVISOR_CACHE_SLOTS];
+    int cache_next;
+    unsigned long long hits;
+    unsigned long long misses;
+} PatternAdvisor;
+
+void advisor_init(PatternAdvisor *advisor);
+void advisor_free(PatternAdvisor *advisor);
+int advisor_field_odds(PatternAdvisor *advisor, const PatternKey table[], int table_count,
+                       PatternKey field[], double odds[]);
+int advisor_best_counter(PatternAdvisor *advisor, const PatternKey table[], int table_count, int length, Advice *advice);
+
+#endif // ADVISOR_H
@@ -0,0 +1,119 @@
+// bots.c
+//
+// Bot players on one socket, built on the client library (pen_client.h).
+// Every pattern on the command line is a session that registers, plays,
+// and readies up again until every session has played the requested number
+// of games; then the per-pattern results are printed.
+//
+// Usage: ./bots [-a server_address] [-p server_port] [-g games] pattern ...   (default HHT THH)
+// All sessions share one source address: give the server a rate limit (-r, -b) to match.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "pen_client.h"
+
+#define BOTS_EVENTS 256
+
+int main(int argc, char *argv[]) {
+    const char *address = "127.0.0.1";
+    int port = PORT;
+    int games = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:g:")) != -1) {
+        switch (opt) {
+            case 'a':
+                address = optarg;
+                break;
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'g':
+                games = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-a server_address] [-p server_port] [-g games] pattern ...\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (games < 1) {
+        fprintf(stderr, "Games must be at least 1\n");
+        exit(EXIT_FAILURE);
+    }
+
+    static PenClient client;
+    if (pen_client_init(&client, address, port) < 0) {
+        perror("Client setup failed");
+        exit(EXIT_FAILURE);
+    }
+
+    char *default_patterns[] = {"HHT", "THH"};
+    char **patterns = optind < argc ? &argv[optind] : default_patterns;
+    int pattern_count = optind < argc ? argc - optind : 2;
+    for (int i = 0; i < pattern_count; i++) {
+        uint64_t pattern;
+        int length;
+        if (pen_parse_pattern(patterns[i], &pattern, &length) < 0 || pen_client_add(&client, pattern, length, 1) < 0) {
+            fprintf(stderr, "Cannot play pattern %s (use H and T, at most %d sessions)\n", patterns[i],
+                    PEN_CLIENT_MAX_SESSIONS);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Sessions that played their games keep playing until every one has, so nobody waits alone
+    PenEvent events[BOTS_EVENTS];
+    int done[PEN_CLIENT_MAX_SESSIONS] = {0};
+    int finished = 0;
+    while (finished < pattern_count) {
+        struct pollfd waiter = {pen_client_fd(&client), POLLIN, 0};
+        if (poll(&waiter, 1, pen_client_timeout_ms(&client)) < 0 && errno != EINTR) {
+            perror("Poll failed");
+            exit(EXIT_FAILURE);
+        }
+        int count = pen_client_poll(&client, events, BOTS_EVENTS);
+        for (int e = 0; e < count; e++) {
+            PenEvent *event = &events[e];
+            PenSession *session = &client.sessions[event->session];
+            switch (event->type) {
+                case PEN_EVENT_REGISTERED:
+                    printf("%s registered as client ID %d\n", patterns[event->session], event->client_id);
+                    break;
+                case PEN_EVENT_FAILED:
+                    printf("%s: server did not answer\n", patterns[event->session]);
+                    if (session->state == PEN_SESSION_FAILED) {
+                        finished += !done[event->session];
+                        done[event->session] = 1;
+                        break;
+                    }
+                    // An unacknowledged claim ends the game like a verdict
+                    // fall through
+                case PEN_EVENT_WON:
+                case PEN_EVENT_LOST:
+                    if (!done[event->session] && session->wins + session->losses >= games) {
+                        done[event->session] = 1;
+                        finished++;
+                    }
+                    if (finished < pattern_count) {
+                        pen_client_ready(&client, event->session);
+                    }
+                    break;
+            }
+        }
+    }
+
+    printf("\nPATTERN          GAMES   WINS   WIN%%\n");
+    for (int i = 0; i < pattern_count; i++) {
+        PenSession *session = &client.sessions[i];
+        int played = session->wins + session->losses;
+        printf("%-15s  %5d  %5d  %5.1f\n", patterns[i], played, session->wins,
+               played ? 100.0 * session->wins / played : 0);
+    }
+    printf("Frames sent %llu, received %llu (%llu toss frames shared by several sessions)\n", client.frames_sent,
+           client.frames_received, client.shared_tosses);
+    pen_client_close(&client);
+    return 0;
+}
@@ -0,0 +1,118 @@
+// checkpoint.c
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+// Function to checksum a slot (FNV-1a)
+static uint32_t checkpoint_checksum(const uint8_t *data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Function to map (creating if needed) the snapshot file.
+// Returns 0 on success, -1 on error. A file written for another state
+// layout is reset, losing its snapshots.
+int checkpoint_open(Checkpoint *checkpoint, const char *path, size_t state_size) {
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    long page = sysconf(_SC_PAGESIZE);
+    size_t slot_size = (state_size + page - 1) / page * page;
+    size_t map_size = page + 2 * slot_size; // Header page, then the two slots
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("Checkpoint file open failed");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || ((size_t)st.st_size != map_size && ftruncate(fd, map_size) < 0)) {
+        perror("Checkpoint file sizing failed");
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("Checkpoint file mapping failed");
+        return -1;
+    }
+
+    checkpoint->map = map;
+    checkpoint->map_size = map_size;
+    checkpoint->state_size = state_size;
+    checkpoint->header = map;
+    checkpoint->slots[0] = (uint8_t *)map + page;
+    checkpoint->slots[1] = (uint8_t *)map + page + slot_size;
+
+    CheckpointHeader *header = checkpoint->header;
+    if (header->magic != CHECKPOINT_MAGIC || header->version != CHECKPOINT_VERSION ||
+        header->state_size != state_size) {
+        memset(header, 0, sizeof(*header));
+        header->state_size = state_size;
+        header->version = CHECKPOINT_VERSION;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        header->magic = CHECKPOINT_MAGIC;
+    }
+    checkpoint->generation = header->generation[0] > header->generation[1] ? header->generation[0]
+                                                                           : header->generation[1];
+    return 0;
+}
+
+// Function to load the newest complete snapshot.
+// Returns 1 when state was filled in, 0 when the file holds none.
+int checkpoint_restore(Checkpoint *checkpoint, void *state) {
+    CheckpointHeader *header = checkpoint->header;
+    int order[2] = {0, 1};
+    if (header->generation[1] > header->generation[0]) {
+        order[0] = 1;
+        order[1] = 0;
+    }
+    for (int i = 0; i < 2; i++) {
+        int slot = order[i];
+        if (header->generation[slot] == 0 ||
+            checkpoint_checksum(checkpoint->slots[slot], checkpoint->state_size) != header->checksum[slot]) {
+            continue; // Empty, or torn by a crash in the middle of a save
+        }
+        memcpy(state, checkpoint->slots[slot], checkpoint->state_size);
+        return 1;
+    }
+    return 0;
+}
+
+// Function to snapshot the state into the older slot.
+// Returns 1 when a snapshot was written, 0 when the state is unchanged.
+int checkpoint_save(Checkpoint *checkpoint, const void *state) {
+    CheckpointHeader *header = checkpoint->header;
+    int newest = header->generation[1] > header->generation[0];
+    if (checkpoint->generation && memcmp(checkpoint->slots[newest], state, checkpoint->state_size) == 0) {
+        checkpoint->skipped++; // Leave the pages clean, there is nothing to write back
+        return 0;
+    }
+
+    int slot = !newest;
+    header->generation[slot] = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(checkpoint->slots[slot], state, checkpoint->state_size);
+    header->checksum[slot] = checkpoint_checksum(checkpoint->slots[slot], checkpoint->state_size);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    header->generation[slot] = ++checkpoint->generation;
+    msync(checkpoint->map, checkpoint->map_size, MS_ASYNC); // Schedules write-back, does not wait for it
+    checkpoint->saves++;
+    return 1;
+}
+
+// Function to unmap the snapshot file, the snapshots stay on disk
+void checkpoint_close(Checkpoint *checkpoint) {
+    if (checkpoint->map) {
+        munmap(checkpoint->map, checkpoint->map_size);
+    }
+    checkpoint->map = NULL;
+}
@@ -0,0 +1,43 @@
+// checkpoint.h
+//
+// Crash-safe snapshots of a fixed-size state block in an mmap'd file.
+// The file holds a header and two slots (double buffering): a save goes to
+// the older slot and only then publishes its generation, so the newest slot
+// with a matching checksum is always complete. Saves are plain memory
+// copies into the mapping; the kernel writes the pages back in the
+// background, so the caller never waits on the disk.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CHECKPOINT_MAGIC   0x50454E43 // "PENC"
+#define CHECKPOINT_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t state_size;    // Snapshots of another size are ignored
+    uint64_t generation[2]; // Per slot, 0 while empty or being written
+    uint32_t checksum[2];   // FNV-1a of the slot
+} CheckpointHeader;
+
+typedef struct {
+    CheckpointHeader *header;
+    uint8_t *slots[2];
+    void *map;
+    size_t map_size;
+    size_t state_size;
+    uint64_t generation;    // Generation of the newest slot
+    unsigned long long saves;
+    unsigned long long skipped; // Saves avoided because nothing changed
+} Checkpoint;
+
+int checkpoint_open(Checkpoint *checkpoint, const char *path, size_t state_size);
+int checkpoint_restore(Checkpoint *checkpoint, void *state);
+int checkpoint_save(Checkpoint *checkpoint, const void *state);
+void checkpoint_close(Checkpoint *checkpoint);
+
+#endif // CHECKPOINT_H
@@ -11,65 +11,95 @@
 #include <netinet/in.h>
 #include <sys/select.h>
 #include <stdint.h> // For uint8_t and uint16_t
+#include <time.h>
+#include <endian.h>
+
+#include "protocol.h"
+#include "shm_transport.h"
+#include "pen_client.h" // ALP codec, reliable state and toss window
 
-#define PORT 8080
 #define BUFFER_SIZE 256
-#define MAX_PATTERN_LENGTH 8 // Now limited to 8 bits
-
-// Message Codes
-#define MSG_LOSE     0b00
-#define MSG_WIN      0b01
-#define MSG_REGISTER 0b10
-#define MSG_READY    0b11
-
-// Bit Masks and Shifts
-#define BIT_TRANSMITTER 15
-#define BIT_TOSS        14
-#define BITS_MESSAGE    12
-#define BITS_CLIENT_ID  8
-#define BITS_SEQUENCE   0
-
-#define MASK_TRANSMITTER (1 << BIT_TRANSMITTER)
-#define MASK_TOSS        (1 << BIT_TOSS)
-#define MASK_MESSAGE     (0b11 << BITS_MESSAGE)
-#define MASK_CLIENT_ID   (0b1111 << BITS_CLIENT_ID)
-#define MASK_SEQUENCE    (0xFF << BITS_SEQUENCE)
+#define IDLE_TIMEOUT_MS 5000
+#define SHM_SPIN_LIMIT 1000 // Empty ring polls before backing off
+#define SHM_BACKOFF_NS 50000
+
+// Structure to hold the ways the client talks to the server
+typedef struct {
+    int sock;                     // Unicast UDP socket
+    int group_sock;               // Multicast toss socket, -1 if unused
+    struct sockaddr_in serv_addr;
+    socklen_t addr_len;
+    ShmGameRegion *shm;           // Shared-memory game region, NULL if unused
+    uint64_t shm_cursor;          // Our read position in the broadcast ring
+    uint8_t client_id;            // Frames in the ring for other players are skipped
+} ClientTransport;
 
 // Function prototypes
 int create_udp_socket();
-void get_user_pattern(char *pattern, uint8_t *pattern_binary, int *pattern_length);
+void get_user_pattern(char *pattern, uint64_t *pattern_binary, int *pattern_length);
 void set_server_address(struct sockaddr_in *serv_addr);
-void register_with_server(int sock, struct sockaddr_in *serv_addr, socklen_t addr_len, uint8_t pattern_binary, int pattern_length, uint8_t *client_id);
-void game_loop(int sock, struct sockaddr_in *serv_addr, socklen_t addr_len, char *pattern, uint8_t pattern_binary, int pattern_length, uint8_t client_id);
-uint16_t create_client_message(uint8_t message_code, uint8_t client_id, uint8_t sequence, uint8_t pattern_length);
-void parse_server_message(uint16_t message, uint8_t *toss, uint8_t *message_code, uint8_t *client_id);
-
-int main() {
-    int sock = 0;
-    struct sockaddr_in serv_addr;
-    socklen_t addr_len = sizeof(struct sockaddr_in);
-    char pattern[MAX_PATTERN_LENGTH + 1]; // User's pattern
-    uint8_t pattern_binary = 0; // Pattern converted to binary
+void register_with_server(ClientTransport *transport, ReliableState *rel, uint64_t pattern_binary, int pattern_length, int want_shm, uint8_t *client_id);
+void game_loop(ClientTransport *transport, ReliableState *rel, char *pattern, uint64_t pattern_binary, int pattern_length, uint8_t client_id);
+ssize_t receive_frame(ClientTransport *transport, uint8_t *buffer, size_t buffer_size, ControlFrame *frame, int timeout_ms);
+ssize_t receive_shm_frame(ClientTransport *transport, uint8_t *buffer, size_t buffer_size, int timeout_ms);
+void send_frame(ClientTransport *transport, const void *frame, size_t length);
+int join_multicast_group(const uint8_t *payload, size_t payload_len, struct sockaddr_in *serv_addr);
+ShmGameRegion *open_shm_offer(const uint8_t *payload, size_t payload_len, uint64_t *cursor);
+void drain_socket(int sock);
+void send_reliable(ClientTransport *transport, ReliableState *rel, uint16_t message, uint8_t flags,
+                   const void *payload, size_t payload_len);
+void transmit_pending(ClientTransport *transport, const ReliableSlot *slot);
+int service_retransmission(ClientTransport *transport, ReliableState *rel);
+int accept_reliable(ClientTransport *transport, ReliableState *rel, ControlFrame *frame, uint8_t client_id, uint8_t ack_flags);
+int next_timeout_ms(ReliableState *rel);
+void request_repair(ClientTransport *transport, TossWindow *window, uint8_t client_id);
+long long now_ms();
+uint32_t now_us();
+void answer_probe(ClientTransport *transport, const uint8_t *payload, size_t payload_len, uint8_t client_id, uint32_t received_us);
+
+int main(int argc, char *argv[]) {
+    ClientTransport transport;
+    char pattern[MAX_PATTERN_LENGTH + 2]; // User's pattern, one extra char to detect overlong input
+    uint64_t pattern_binary = 0; // Pattern converted to binary
     int pattern_length;
     uint8_t client_id = 0;
+    int want_shm = 0; // Ask a local server for the shared-memory transport
+    ReliableState rel;
+    memset(&rel, 0, sizeof(rel));
+    memset(&transport, 0, sizeof(transport));
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s")) != -1) {
+        if (opt == 's') {
+            want_shm = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [-s]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
 
     // Create UDP socket
-    sock = create_udp_socket();
+    transport.sock = create_udp_socket();
+    transport.group_sock = -1;
+    transport.addr_len = sizeof(struct sockaddr_in);
 
     // Get pattern from user and convert it
     get_user_pattern(pattern, &pattern_binary, &pattern_length);
 
     // Set server address
-    set_server_address(&serv_addr);
+    set_server_address(&transport.serv_addr);
 
     // Register with server
-    register_with_server(sock, &serv_addr, addr_len, pattern_binary, pattern_length, &client_id);
+    register_with_server(&transport, &rel, pattern_binary, pattern_length, want_shm, &client_id);
 
     // Start game loop
-    game_loop(sock, &serv_addr, addr_len, pattern, pattern_binary, pattern_length, client_id);
+    game_loop(&transport, &rel, pattern, pattern_binary, pattern_length, client_id);
 
-    // Close the socket
-    close(sock);
+    // Close the sockets
+    if (transport.group_sock >= 0) {
+        close(transport.group_sock);
+    }
+    close(transport.sock);
     printf("Connection closed.\n");
 
     return 0;
@@ -86,12 +116,21 @@ int create_udp_socket() {
 }
 
 // Function to get user pattern and convert it to binary
-void get_user_pattern(char *pattern, uint8_t *pattern_binary, int *pattern_length) {
+void get_user_pattern(char *pattern, uint64_t *pattern_binary, int *pattern_length) {
     printf("Enter your pattern (max %d characters, e.g., HHT): ", MAX_PATTERN_LENGTH);
-    scanf("%s", pattern);
+    // pattern holds MAX_PATTERN_LENGTH + 2 chars, so an overlong line still reads as too long
+    if (!fgets(pattern, MAX_PATTERN_LENGTH + 2, stdin)) {
+        printf("No pattern given\n");
+        exit(EXIT_FAILURE);
+    }
+    pattern[strcspn(pattern, "\r\n")] = '\0';
 
     // Validate and convert pattern to binary
     *pattern_length = strlen(pattern);
+    if (*pattern_length == 0) {
+        printf("Pattern is empty. Use 'H' and 'T', e.g., HHT\n");
+        exit(EXIT_FAILURE);
+    }
     if (*pattern_length > MAX_PATTERN_LENGTH) {
         printf("Pattern too long. Maximum length is %d\n", MAX_PATTERN_LENGTH);
         exit(EXIT_FAILURE);
@@ -126,90 +165,175 @@ void set_server_address(struct sockaddr_in *serv_addr) {
 }
 
 // Function to register with the server
-void register_with_server(int sock, struct sockaddr_in *serv_addr, socklen_t addr_len, uint8_t pattern_binary, int pattern_length, uint8_t *client_id) {
-    uint16_t message;
+void register_with_server(ClientTransport *transport, ReliableState *rel, uint64_t pattern_binary, int pattern_length, int want_shm, uint8_t *client_id) {
+    uint8_t buffer[BUFFER_SIZE];
+    ControlFrame frame;
     ssize_t valread;
 
-    // Create registration message
-    message = create_client_message(MSG_REGISTER, 0, pattern_binary, pattern_length);
-
-    // Send registration message to server
-    sendto(sock, &message, sizeof(message), 0, (const struct sockaddr *)serv_addr, addr_len);
+    // Create registration message and send it reliably; the reply carrying our ID acknowledges it
+    // The ALP word holds patterns of up to 8 tosses, the payload always carries the full one
+    int short_length = pattern_length < SHORT_PATTERN_LENGTH ? pattern_length : SHORT_PATTERN_LENGTH;
+    uint16_t message = create_client_message(MSG_REGISTER, 0, pattern_binary & 0xFF, short_length);
+    PatternPayload full = {pattern_length, htobe64(pattern_binary)};
+    send_reliable(transport, rel, message, FRAME_FLAG_PATTERN | FRAME_FLAG_TIMING | (want_shm ? FRAME_FLAG_SHM : 0),
+                  &full, sizeof(full));
     printf("Pattern sent to server for registration.\n");
 
-    // Receive client ID from server
-    valread = recvfrom(sock, &message, sizeof(message), 0, NULL, NULL);
-    if (valread > 0) {
+    // Receive client ID from server, retransmitting the registration with backoff
+    while (1) {
+        valread = receive_frame(transport, buffer, sizeof(buffer), &frame, next_timeout_ms(rel));
+        if (valread < 0) {
+            perror("Failed to receive client ID from server");
+            close(transport->sock);
+            exit(EXIT_FAILURE);
+        }
+        if (valread == 0) {
+            if (service_retransmission(transport, rel) < 0) {
+                printf("Failed to receive client ID from server.\n");
+                close(transport->sock);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
         uint8_t toss, message_code, server_client_id;
-        parse_server_message(message, &toss, &message_code, &server_client_id);
-        if (message_code == MSG_REGISTER) {
+        parse_server_message(frame.message, &toss, &message_code, &server_client_id);
+        if (message_code == MSG_REGISTER && !(frame.flags & FRAME_FLAG_ACK)) {
             *client_id = server_client_id;
+            reliable_settle(rel, MSG_REGISTER);
+
+            // Switch to the transports the server offers, our ACK tells it which ones we took.
+            // Payloads follow the header in the order of their flag bits.
+            const uint8_t *payload = buffer + sizeof(ControlFrame);
+            size_t payload_len = valread > (ssize_t)sizeof(ControlFrame) ? valread - sizeof(ControlFrame) : 0;
+            const uint8_t *multicast_offer = NULL;
+            uint8_t ack_flags = 0;
+            if ((frame.flags & FRAME_FLAG_MULTICAST) && payload_len >= sizeof(MulticastPayload)) {
+                multicast_offer = payload;
+                payload += sizeof(MulticastPayload);
+                payload_len -= sizeof(MulticastPayload);
+            }
+            if ((frame.flags & FRAME_FLAG_SHM) && !transport->shm) {
+                transport->shm = open_shm_offer(payload, payload_len, &transport->shm_cursor);
+            }
+            if (transport->shm) {
+                ack_flags |= FRAME_FLAG_SHM;
+            } else if (multicast_offer && transport->group_sock < 0) {
+                transport->group_sock = join_multicast_group(multicast_offer, sizeof(MulticastPayload), &transport->serv_addr);
+            }
+            if (transport->group_sock >= 0) {
+                ack_flags |= FRAME_FLAG_MULTICAST;
+            }
+            transport->client_id = *client_id;
+            accept_reliable(transport, rel, &frame, *client_id, ack_flags);
             printf("Received client ID: %d\n", *client_id);
-        } else {
-            printf("Failed to receive client ID from server.\n");
-            close(sock);
-            exit(EXIT_FAILURE);
+            return;
         }
-    } else {
-        perror("Failed to receive client ID from server");
-        close(sock);
-        exit(EXIT_FAILURE);
     }
 }
 
 // Main game loop function
-void game_loop(int sock, struct sockaddr_in *serv_addr, socklen_t addr_len, char *pattern, uint8_t pattern_binary, int pattern_length, uint8_t client_id) {
-    uint16_t message;
+void game_loop(ClientTransport *transport, ReliableState *rel, char *pattern, uint64_t pattern_binary, int pattern_length, uint8_t client_id) {
+    uint8_t buffer[BUFFER_SIZE];
+    ControlFrame frame;
     ssize_t valread;
     int flips = 0;
     int game_over = 0;
+    int claimed = 0; // Win claimed, waiting for the server's verdict
+    uint32_t received_us = 0; // When the last frame arrived, the WIN reports how long we held it
+    TossWindow window;
+    memset(&window, 0, sizeof(window));
 
     // Wait for game to start
     printf("Waiting for game to start...\n");
 
-    // Set socket timeout to prevent blocking indefinitely
-    struct timeval timeout;
-    timeout.tv_sec = 5;
-    timeout.tv_usec = 0; // 5 seconds
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-
-    uint8_t sequence_buffer = 0;
+    uint64_t sequence_buffer = 0; // Rolling window of the last pattern_length tosses
+    uint64_t pattern_mask = PATTERN_MASK(pattern_length);
 
     while (1) {
         while (!game_over) {
-            // Receive data from the server
-            valread = recvfrom(sock, &message, sizeof(message), 0, NULL, NULL);
+            // Receive data from the server, waking up for retransmissions
+            int timeout_ms = next_timeout_ms(rel);
+            if (window.repair_pending && timeout_ms > REPAIR_TIMEOUT_MS) {
+                timeout_ms = REPAIR_TIMEOUT_MS;
+            }
+            valread = receive_frame(transport, buffer, sizeof(buffer), &frame, timeout_ms);
+            if (service_retransmission(transport, rel) < 0 && claimed) {
+                printf("Server did not acknowledge the win claim.\n");
+                game_over = 1;
+                break;
+            }
             if (valread > 0) {
                 uint8_t toss, message_code, server_client_id;
+                received_us = now_us();
 
-                parse_server_message(message, &toss, &message_code, &server_client_id);
+                parse_server_message(frame.message, &toss, &message_code, &server_client_id);
+                if (frame.flags & FRAME_FLAG_ACK) {
+                    // Server acknowledges our pending WIN or READY
+                    reliable_ack(rel, frame.seq);
+                    continue;
+                }
+                if ((frame.flags & FRAME_FLAG_TIMING) && message_code == MSG_ACK) {
+                    // RTT probe: echo it at once
+                    answer_probe(transport, buffer + sizeof(ControlFrame), valread - sizeof(ControlFrame),
+                                 client_id, received_us);
+                    continue;
+                }
+                if (frame.flags & FRAME_FLAG_REPAIR) {
+                    // Server fills a gap in our toss stream
+                    accept_repair(&window, buffer + sizeof(ControlFrame), valread - sizeof(ControlFrame));
+                } else if ((frame.flags & FRAME_FLAG_RELIABLE) &&
+                    !accept_reliable(transport, rel, &frame, client_id, 0)) {
+                    continue; // Duplicate of a control message we already handled
+                }
+                if ((message_code == MSG_LOSE || message_code == MSG_WIN) && server_client_id == client_id) {
+                    reliable_settle(rel, MSG_WIN); // A verdict settles the claim even if its ACK was lost
+                }
                 if (message_code == MSG_LOSE && server_client_id == client_id) {
                     printf("You have lost the game after %d flips. Better luck next time!\n", flips);
                     game_over = 1;
                     break;
                 }
-                if (!game_over) {
-                    // This is a coin flip message
-                    flips++;
-                    // Convert toss bit to 'H' or 'T'
-                    char coin_flip = (toss == 0) ? 'H' : 'T';
-
-                    printf("Received coin flip: %c\n", coin_flip);
-                    // Parse the message
-                    // Update sequence buffer to keep last pattern_length bits
-                    sequence_buffer = ((sequence_buffer << 1) | toss) & ((1 << pattern_length) - 1);
-
-                    if (flips >= pattern_length) {
-                        if (sequence_buffer == pattern_binary) {
-                            // Send WIN message to server
-                            uint16_t win_message = create_client_message(MSG_WIN, client_id, 0, pattern_length);
-                            sendto(sock, &win_message, sizeof(win_message), 0, (const struct sockaddr *)serv_addr, addr_len);
-                            printf("Your pattern '%s' occurred after %d flips. Claiming win...\n", pattern, flips);
-                            game_over = 1;
-                        }
+                if (message_code == MSG_WIN && server_client_id == client_id) {
+                    printf("The server confirmed your win after %d flips!\n", flips);
+                    game_over = 1;
+                    break;
+                }
+                if (message_code == MSG_TOSSING && !(frame.flags & FRAME_FLAG_REPAIR)) {
+                    // Bits 7-0 carry the toss index, buffer it until every earlier toss is in
+                    uint8_t sequence = ntohs(frame.message) & MASK_SEQUENCE;
+                    accept_toss(&window, sequence, toss);
+                }
+            }
+
+            // Ask once for the whole missing range in front of the buffered tosses
+            if (window.received && !(window.received & 1) &&
+                (!window.repair_pending || now_ms() >= window.repair_deadline_ms)) {
+                request_repair(transport, &window, client_id);
+            }
+
+            uint8_t toss;
+            while (!claimed && pop_toss(&window, &toss)) {
+                // Apply the next coin flip in order
+                flips++;
+                // Convert toss bit to 'H' or 'T'
+                char coin_flip = (toss == 0) ? 'H' : 'T';
+
+                printf("Received coin flip: %c\n", coin_flip);
+                // Parse the message
+                // Update sequence buffer to keep last pattern_length bits
+                sequence_buffer = ((sequence_buffer << 1) | toss) & pattern_mask;
+
+                if (flips >= pattern_length) {
+                    if (sequence_buffer == pattern_binary) {
+                        // Send WIN message to server
+                        uint16_t win_message = create_client_message(MSG_WIN, client_id, (window.next_toss - 1) & 0xFF, pattern_length);
+                        TimingPayload timing = {0, htonl(now_us() - received_us)};
+                        send_reliable(transport, rel, win_message, FRAME_FLAG_TIMING, &timing, sizeof(timing));
+                        printf("Your pattern '%s' occurred after %d flips. Claiming win...\n", pattern, flips);
+                        claimed = 1;
                     }
                 }
-                
             }
         }
         // After game over
@@ -218,13 +342,22 @@ void game_loop(int sock, struct sockaddr_in *serv_addr, socklen_t addr_len, char
         printf("Do you want to play again? (y/n): ");
         scanf(" %c", &choice);
         if (choice == 'y' || choice == 'Y') {
+            // Tosses multicast while we were away belong to other games
+            if (transport->group_sock >= 0) {
+                drain_socket(transport->group_sock);
+            }
+            if (transport->shm) {
+                shm_skip(transport->shm, &transport->shm_cursor);
+            }
             // Send READY message to the server
             uint16_t ready_message = create_client_message(MSG_READY, client_id, 0, pattern_length);
-            sendto(sock, &ready_message, sizeof(ready_message), 0, (const struct sockaddr *)serv_addr, addr_len);
+            send_reliable(transport, rel, ready_message, 0, NULL, 0);
             printf("Sent READY message to server.\n");
             // Reset game variables
             game_over = 0;
+            claimed = 0;
             flips = 0;
+            memset(&window, 0, sizeof(window));
             sequence_buffer = 0;
             printf("Waiting for game to start...\n");
         } else {
@@ -234,42 +367,263 @@ void game_loop(int sock, struct sockaddr_in *serv_addr, socklen_t addr_len, char
     }
 }
 
-// Function to create a client message according to the ALP protocol
-uint16_t create_client_message(uint8_t message_code, uint8_t client_id, uint8_t sequence, uint8_t pattern_length) {
-    uint16_t message = 0;
-    // Transmitter flag is 0 (client)
-    // Toss bit is 0
-    // Set message code in bits 13-12
-    message |= (message_code & 0b11) << BITS_MESSAGE;
-
-    if (message_code == MSG_REGISTER) {
-        // In registration, encode pattern length in bits 11-9
-        message |= ((pattern_length - 1) & 0b111) << 9;
-        // Bit 8 is unused and set to 0
+// Function to wait up to timeout_ms for a frame from the server.
+// Returns the number of bytes received, 0 on timeout and -1 on error.
+ssize_t receive_frame(ClientTransport *transport, uint8_t *buffer, size_t buffer_size, ControlFrame *frame, int timeout_ms) {
+    ssize_t valread;
+
+    if (transport->shm) {
+        valread = receive_shm_frame(transport, buffer, buffer_size, timeout_ms);
     } else {
-        // Set client ID in bits 11-8
-        message |= (client_id & 0b1111) << BITS_CLIENT_ID;
+        fd_set readfds;
+        struct timeval timeout;
+
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_usec = (timeout_ms % 1000) * 1000;
+        FD_ZERO(&readfds);
+        FD_SET(transport->sock, &readfds);
+        int max_sd = transport->sock;
+        if (transport->group_sock >= 0) {
+            FD_SET(transport->group_sock, &readfds);
+            max_sd = (transport->group_sock > max_sd) ? transport->group_sock : max_sd;
+        }
+
+        int activity = select(max_sd + 1, &readfds, NULL, NULL, &timeout);
+        if (activity < 0) {
+            return (errno == EINTR) ? 0 : -1;
+        }
+        if (activity == 0) {
+            return 0;
+        }
+
+        // Control traffic on the unicast socket goes first
+        int ready_sock = FD_ISSET(transport->sock, &readfds) ? transport->sock : transport->group_sock;
+        valread = recvfrom(ready_sock, buffer, buffer_size, 0, NULL, NULL);
+    }
+    if (valread < (ssize_t)sizeof(uint16_t)) {
+        return (valread < 0) ? -1 : 0;
     }
+    // Plain 2-byte messages are best-effort and carry no flags
+    memset(frame, 0, sizeof(*frame));
+    memcpy(frame, buffer, valread < (ssize_t)sizeof(*frame) ? (size_t)valread : sizeof(*frame));
+    return valread;
+}
+
+// Function to poll the shared-memory ring for the next frame addressed to us
+// (or to every player). Spins while frames keep coming and only sleeps after
+// the ring stayed empty for a while, so a running game costs no syscalls.
+ssize_t receive_shm_frame(ClientTransport *transport, uint8_t *buffer, size_t buffer_size, int timeout_ms) {
+    long long deadline = now_ms() + timeout_ms;
+    int idle_polls = 0;
+    uint8_t data[SHM_FRAME_MAX];
+    size_t length;
+
+    while (1) {
+        int status = shm_read(transport->shm, &transport->shm_cursor, data, &length);
+        if (status > 0) {
+            uint16_t message;
+            memcpy(&message, data, sizeof(message));
+            uint8_t frame_client_id = (ntohs(message) & MASK_CLIENT_ID) >> BITS_CLIENT_ID;
+            if (length < sizeof(message) || (frame_client_id != 0 && frame_client_id != transport->client_id)) {
+                continue;
+            }
+            if (length > buffer_size) {
+                length = buffer_size;
+            }
+            memcpy(buffer, data, length);
+            return length;
+        }
+        if (status < 0) {
+            continue; // Fell behind: lost tosses are repaired, lost control frames retransmitted
+        }
+        if (now_ms() >= deadline) {
+            return 0;
+        }
+        if (++idle_polls >= SHM_SPIN_LIMIT) {
+            struct timespec pause = {0, SHM_BACKOFF_NS};
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+// Function to send a frame to the server over the transport in use
+void send_frame(ClientTransport *transport, const void *frame, size_t length) {
+    if (transport->shm && shm_command_push(transport->shm, frame, length)) {
+        return;
+    }
+    // Not local, or the command queue is full: UDP always reaches the server
+    sendto(transport->sock, frame, length, 0, (const struct sockaddr *)&transport->serv_addr, transport->addr_len);
+}
+
+// Function to send a control message that is retransmitted until acknowledged.
+// Up to RELIABLE_WINDOW of them are in flight, each in its own slot.
+void send_reliable(ClientTransport *transport, ReliableState *rel, uint16_t message, uint8_t flags,
+                   const void *payload, size_t payload_len) {
+    transmit_pending(transport, reliable_queue(rel, message, flags, payload, payload_len, now_ms()));
+}
+
+// Function to (re)send a reliable control message with its payload
+void transmit_pending(ClientTransport *transport, const ReliableSlot *slot) {
+    uint8_t buffer[sizeof(ControlFrame) + sizeof(slot->payload)];
+    memcpy(buffer, &slot->frame, sizeof(slot->frame));
+    memcpy(buffer + sizeof(slot->frame), slot->payload, slot->payload_len);
+    send_frame(transport, buffer, sizeof(slot->frame) + slot->payload_len);
+}
+
+// Function to retransmit the control messages whose timer expired.
+// Returns -1 when a message was dropped after too many attempts, 0 otherwise.
+int service_retransmission(ClientTransport *transport, ReliableState *rel) {
+    int result = 0;
+    long long now = now_ms();
+    for (int i = 0; i < RELIABLE_WINDOW; i++) {
+        ReliableSlot *slot = &rel->pending[i];
+        if (!slot->active || now < slot->deadline_ms) {
+            continue;
+        }
+        if (reliable_backoff(slot, now) < 0) {
+            result = -1;
+            continue;
+        }
+        transmit_pending(transport, slot);
+    }
+    return result;
+}
+
+// Function to acknowledge a reliable frame from the server.
+// Returns 1 if the frame is new, 0 if it is a retransmission we already handled.
+int accept_reliable(ClientTransport *transport, ReliableState *rel, ControlFrame *frame, uint8_t client_id, uint8_t ack_flags) {
+    if (!(frame->flags & FRAME_FLAG_RELIABLE)) {
+        return 1;
+    }
+    // Always acknowledge, our previous ACK may have been lost
+    ControlFrame ack = {create_client_message(MSG_ACK, client_id, 0, 0), FRAME_FLAG_ACK | ack_flags, frame->seq};
+    send_frame(transport, &ack, sizeof(ack));
 
-    // Set sequence/pattern in bits 7-0
-    message |= (sequence & 0xFF);
+    // The server keeps a window of frames in flight: remember the last RELIABLE_WINDOW taken
+    return reliable_seq_accept(&rel->rx_seq, &rel->rx_seen, frame->seq);
+}
+
+// Function to join the toss multicast group named in a REGISTER reply.
+// Returns the group socket, or -1 to keep receiving tosses by unicast.
+int join_multicast_group(const uint8_t *payload, size_t payload_len, struct sockaddr_in *serv_addr) {
+    MulticastPayload group;
+    if (payload_len < sizeof(group)) {
+        return -1;
+    }
+    memcpy(&group, payload, sizeof(group));
+
+    int group_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (group_sock < 0) {
+        perror("Multicast socket creation error");
+        return -1;
+    }
+    // Several players on one host listen on the same group port
+    int reuse = 1;
+    setsockopt(group_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in group_addr;
+    memset(&group_addr, 0, sizeof(group_addr));
+    group_addr.sin_family = AF_INET;
+    group_addr.sin_addr.s_addr = group.group;
+    group_addr.sin_port = group.port;
+    if (bind(group_sock, (struct sockaddr *)&group_addr, sizeof(group_addr)) < 0) {
+        perror("Multicast bind failed");
+        close(group_sock);
+        return -1;
+    }
+
+    // Join on the interface that reaches the server (loopback for a local server)
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = group.group;
+    mreq.imr_interface.s_addr = (ntohl(serv_addr->sin_addr.s_addr) >> 24 == 127) ? serv_addr->sin_addr.s_addr : htonl(INADDR_ANY);
+    if (setsockopt(group_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        perror("Joining multicast group failed");
+        close(group_sock);
+        return -1;
+    }
+
+    printf("Joined toss multicast group %s:%d\n", inet_ntoa(group_addr.sin_addr), ntohs(group.port));
+    return group_sock;
+}
+
+// Function to map the shared-memory region offered in a REGISTER reply.
+// Returns NULL to stay on the network transports (e.g. the server is remote).
+ShmGameRegion *open_shm_offer(const uint8_t *payload, size_t payload_len, uint64_t *cursor) {
+    ShmOfferPayload offer;
+    if (payload_len < sizeof(offer)) {
+        return NULL;
+    }
+    memcpy(&offer, payload, sizeof(offer));
+    ShmGameRegion *region = shm_open_region(ntohs(offer.port), ntohs(offer.game_index), cursor);
+    if (region) {
+        printf("Using the shared-memory transport\n");
+    } else {
+        printf("Shared-memory region not available, staying on UDP\n");
+    }
+    return region;
+}
 
-    return htons(message); // Convert to network byte order
+// Function to discard every datagram queued on a socket
+void drain_socket(int sock) {
+    uint8_t buffer[BUFFER_SIZE];
+    while (recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+    }
 }
 
-// Function to parse a server message according to the ALP protocol
-void parse_server_message(uint16_t message, uint8_t *toss, uint8_t *message_code, uint8_t *client_id) {
-    // Convert message from network byte order to host byte order
-    message = ntohs(message);
-    // Extract bits according to the protocol
-    uint8_t transmitter_flag = (message >> BIT_TRANSMITTER) & 0b1;
-    *toss = (message >> BIT_TOSS) & 0b1;
-    *message_code = (message >> BITS_MESSAGE) & 0b11;
-    *client_id = (message >> BITS_CLIENT_ID) & 0b1111;
-    // Bits 7-0 (sequence) are ignored for server messages
-    // printf("Parsed server message:\n");
-    // printf("  Transmitter Flag: %d\n", transmitter_flag);
-    // printf("  Toss: %d\n", *toss);
-    // printf("  Message Code: %d\n", *message_code);
-    // printf("  Client ID: %d\n", *client_id);
+// Function to compute how long we may block before a retransmission is due
+int next_timeout_ms(ReliableState *rel) {
+    long long deadline = reliable_deadline_ms(rel);
+    if (deadline < 0) {
+        return IDLE_TIMEOUT_MS;
+    }
+    long long remaining = deadline - now_ms();
+    return remaining > 0 ? (int)remaining : 0;
+}
+
+// Function to request the missing tosses in front of the first buffered one
+void request_repair(ClientTransport *transport, TossWindow *window, uint8_t client_id) {
+    struct __attribute__((packed)) {
+        ControlFrame header;
+        uint16_t first_toss;
+        uint8_t count;
+    } request;
+
+    request.header.message = create_client_message(MSG_ACK, client_id, 0, 0);
+    request.header.flags = FRAME_FLAG_REPAIR;
+    request.header.seq = 0;
+    request.first_toss = htons(window->next_toss & 0xFFFF);
+    request.count = __builtin_ctzll(window->received);
+
+    send_frame(transport, &request, sizeof(request));
+    window->repair_pending = 1;
+    window->repair_deadline_ms = now_ms() + REPAIR_TIMEOUT_MS;
+}
+
+// Function to read a monotonic clock in milliseconds
+long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Function to get the time in microseconds for latency stamps (wraps every ~71 minutes)
+uint32_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+// Function to echo an RTT probe with the time it waited in the client
+void answer_probe(ClientTransport *transport, const uint8_t *payload, size_t payload_len, uint8_t client_id, uint32_t received_us) {
+    TimingPayload timing;
+    if (payload_len < sizeof(timing)) {
+        return;
+    }
+    memcpy(&timing, payload, sizeof(timing));
+    timing.hold_us = htonl(now_us() - received_us);
+    uint8_t echo[sizeof(ControlFrame) + sizeof(TimingPayload)];
+    ControlFrame frame = {create_client_message(MSG_ACK, client_id, 0, 0), FRAME_FLAG_TIMING, 0};
+    memcpy(echo, &frame, sizeof(frame));
+    memcpy(echo + sizeof(frame), &timing, sizeof(timing));
+    send_frame(transport, echo, sizeof(echo));
 }
@@ -0,0 +1,421 @@
+// experiment.c
+//
+// Parallel Penney's game matchup runner. Every ordered pair of distinct
+// patterns of one length is a task; tasks are spread over worker threads
+// with work-stealing deques. Each matchup is simulated in batches until the
+// 95% Wilson interval of the first pattern's win rate is narrower than the
+// target half-width. Patterns use the server's encoding (tosses oldest first,
+// last toss in bit 0, 1 = tails) and the generated pattern tables.
+//
+// Usage: ./experiment [-l length] [-w half_width] [-m min_games] [-M max_games]
+//                     [-t threads] [-S seed] [-o matchups.csv]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "protocol.h"
+#include "pattern_tables.h"
+
+#define EXPERIMENT_MAX_LENGTH 10 // 2^20 matchups
+#define EXPERIMENT_BATCH 256     // Games between two interval checks
+#define CONFIDENCE_Z 1.96        // 95% confidence
+
+// Per-matchup result, written only by the worker that ran the matchup
+typedef struct {
+    uint64_t games;
+    uint64_t wins;   // Games won by the first pattern
+    uint64_t flips;
+} MatchupResult;
+
+// Work-stealing deque (Chase-Lev). All tasks are pushed before the workers
+// start, so the owner only pops from the bottom and thieves take from the top.
+typedef struct {
+    _Alignas(64) _Atomic int64_t top;
+    _Alignas(64) _Atomic int64_t bottom;
+    uint32_t *tasks;
+} TaskDeque;
+
+// Random bit source of a worker (xoshiro256**), reseeded for every matchup
+typedef struct {
+    uint64_t state[4];
+    uint64_t bits;      // Unused random bits
+    int bits_left;
+} RandomStream;
+
+// Structure to hold the experiment shared by all workers
+typedef struct {
+    int length;
+    int pattern_count;
+    double half_width;
+    uint64_t min_games;
+    uint64_t max_games;
+    uint64_t seed;
+    int worker_count;
+    TaskDeque *deques;
+    MatchupResult *results;
+    // PatternStats-style totals per pattern, merged lock-free as matchups finish
+    _Atomic uint64_t *pattern_wins;
+    _Atomic uint64_t *pattern_games;
+    _Atomic uint64_t *pattern_flips;
+    _Atomic uint64_t steals;
+    _Atomic uint64_t total_games;
+} Experiment;
+
+typedef struct {
+    Experiment *experiment;
+    int index;
+} Worker;
+
+// Function to advance a splitmix64 state, used to seed the xoshiro streams
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Function to seed a stream for one matchup, so results do not depend on scheduling
+static void stream_seed(RandomStream *stream, uint64_t seed, uint32_t task) {
+    uint64_t state = seed ^ ((uint64_t)task << 32 | task);
+    for (int i = 0; i < 4; i++) {
+        stream->state[i] = splitmix64(&state);
+    }
+    stream->bits_left = 0;
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Function to draw 64 random bits (xoshiro256**)
+static inline uint64_t stream_next(RandomStream *stream) {
+    uint64_t *s = stream->state;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// Function to toss one fair coin
+static inline uint64_t stream_toss(RandomStream *stream) {
+    if (stream->bits_left == 0) {
+        stream->bits = stream_next(stream);
+        stream->bits_left = 64;
+    }
+    uint64_t toss = stream->bits & 1;
+    stream->bits >>= 1;
+    stream->bits_left--;
+    return toss;
+}
+
+// Function to play one game of a against b, returns 1 if a appears first
+static inline int play_game(RandomStream *stream, uint64_t a, uint64_t b, int length, uint64_t mask, uint64_t *flips) {
+    uint64_t window = 0;
+    uint64_t tosses = 0;
+    while (1) {
+        window = ((window << 1) | stream_toss(stream)) & mask;
+        tosses++;
+        if (tosses >= (uint64_t)length) {
+            if (window == a) {
+                *flips += tosses;
+                return 1;
+            }
+            if (window == b) {
+                *flips += tosses;
+                return 0;
+            }
+        }
+    }
+}
+
+// Function to compute the half-width of the Wilson score interval
+static double wilson_half_width(uint64_t wins, uint64_t games) {
+    double n = games;
+    double p = wins / n;
+    double z2 = CONFIDENCE_Z * CONFIDENCE_Z;
+    return CONFIDENCE_Z * sqrt(p * (1 - p) / n + z2 / (4 * n * n)) / (1 + z2 / n);
+}
+
+// Function to take a task from the bottom of our own deque, -1 when it is empty
+static int64_t deque_pop(TaskDeque *deque) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return -1;
+    }
+    int64_t task = deque->tasks[bottom];
+    if (top == bottom) {
+        // Last task: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            task = -1;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Function to steal a task from the top of another deque.
+// Returns the task, -1 when the deque is empty and -2 when we lost a race.
+static int64_t deque_steal(TaskDeque *deque) {
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return -1;
+    }
+    int64_t task = deque->tasks[top];
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return -2;
+    }
+    return task;
+}
+
+// Function to find the next task: our own deque first, then the others'
+static int64_t next_task(Experiment *experiment, int index) {
+    int64_t task = deque_pop(&experiment->deques[index]);
+    while (task < 0) {
+        int contended = 0;
+        for (int n = 1; n < experiment->worker_count; n++) {
+            int victim = (index + n) % experiment->worker_count;
+            task = deque_steal(&experiment->deques[victim]);
+            if (task >= 0) {
+                atomic_fetch_add_explicit(&experiment->steals, 1, memory_order_relaxed);
+                return task;
+            }
+            if (task == -2) {
+                contended = 1;
+            }
+        }
+        if (!contended) {
+            return -1; // Tasks are never added, so every deque being empty means we are done
+        }
+    }
+    return task;
+}
+
+// Function to run one matchup until its interval is narrow enough
+static void run_matchup(Experiment *experiment, RandomStream *stream, uint32_t task) {
+    uint64_t a = task / experiment->pattern_count;
+    uint64_t b = task % experiment->pattern_count;
+    uint64_t mask = pattern_length_masks[experiment->length];
+    MatchupResult result = {0, 0, 0};
+
+    stream_seed(stream, experiment->seed, task);
+    while (result.games < experiment->max_games) {
+        for (int i = 0; i < EXPERIMENT_BATCH; i++) {
+            result.wins += play_game(stream, a, b, experiment->length, mask, &result.flips);
+        }
+        result.games += EXPERIMENT_BATCH;
+        if (result.games >= experiment->min_games &&
+            wilson_half_width(result.wins, result.games) <= experiment->half_width) {
+            break;
+        }
+    }
+    experiment->results[task] = result;
+
+    // Merge into the per-pattern totals
+    atomic_fetch_add_explicit(&experiment->pattern_wins[a], result.wins, memory_order_relaxed);
+    atomic_fetch_add_explicit(&experiment->pattern_wins[b], result.games - result.wins, memory_order_relaxed);
+    atomic_fetch_add_explicit(&experiment->pattern_games[a], result.games, memory_order_relaxed);
+    atomic_fetch_add_explicit(&experiment->pattern_games[b], result.games, memory_order_relaxed);
+    atomic_fetch_add_explicit(&experiment->pattern_flips[a], result.flips, memory_order_relaxed);
+    atomic_fetch_add_explicit(&experiment->pattern_flips[b], result.flips, memory_order_relaxed);
+    atomic_fetch_add_explicit(&experiment->total_games, result.games, memory_order_relaxed);
+}
+
+// Function run by every worker thread
+static void *worker_main(void *arg) {
+    Worker *worker = arg;
+    RandomStream stream;
+    int64_t task;
+    while ((task = next_task(worker->experiment, worker->index)) >= 0) {
+        run_matchup(worker->experiment, &stream, task);
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    Experiment experiment;
+    memset(&experiment, 0, sizeof(experiment));
+    experiment.length = 8;
+    experiment.half_width = 0.01;
+    experiment.min_games = 1024;
+    experiment.max_games = 1 << 20;
+    experiment.seed = time(NULL);
+    experiment.worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *csv_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:w:m:M:t:S:o:")) != -1) {
+        switch (opt) {
+            case 'l':
+                experiment.length = atoi(optarg);
+                break;
+            case 'w':
+                experiment.half_width = atof(optarg);
+                break;
+            case 'm':
+                experiment.min_games = strtoull(optarg, NULL, 10);
+                break;
+            case 'M':
+                experiment.max_games = strtoull(optarg, NULL, 10);
+                break;
+            case 't':
+                experiment.worker_count = atoi(optarg);
+                break;
+            case 'S':
+                experiment.seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'o':
+                csv_path = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-l length] [-w half_width] [-m min_games] [-M max_games] "
+                                "[-t threads] [-S seed] [-o matchups.csv]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (experiment.length < 1 || experiment.length > EXPERIMENT_MAX_LENGTH) {
+        fprintf(stderr, "Pattern length must be 1 to %d\n", EXPERIMENT_MAX_LENGTH);
+        exit(EXIT_FAILURE);
+    }
+    if (experiment.half_width <= 0 || experiment.worker_count < 1 || experiment.max_games < EXPERIMENT_BATCH) {
+        fprintf(stderr, "Half-width must be positive, threads at least 1 and max games at least %d\n", EXPERIMENT_BATCH);
+        exit(EXIT_FAILURE);
+    }
+
+    experiment.pattern_count = 1 << experiment.length;
+    uint32_t task_count = (uint32_t)experiment.pattern_count * experiment.pattern_count;
+    experiment.results = calloc(task_count, sizeof(MatchupResult));
+    experiment.pattern_wins = calloc(experiment.pattern_count, sizeof(_Atomic uint64_t));
+    experiment.pattern_games = calloc(experiment.pattern_count, sizeof(_Atomic uint64_t));
+    experiment.pattern_flips = calloc(experiment.pattern_count, sizeof(_Atomic uint64_t));
+    experiment.deques = calloc(experiment.worker_count, sizeof(TaskDeque));
+    if (!experiment.results || !experiment.pattern_wins || !experiment.pattern_games ||
+        !experiment.pattern_flips || !experiment.deques) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Deal the matchups (a against b, a != b) out in contiguous blocks, stealing evens out the rest
+    uint32_t matchups = task_count - experiment.pattern_count;
+    uint32_t per_worker = (matchups + experiment.worker_count - 1) / experiment.worker_count;
+    int worker = 0;
+    for (int w = 0; w < experiment.worker_count; w++) {
+        experiment.deques[w].tasks = malloc(per_worker * sizeof(uint32_t));
+        if (!experiment.deques[w].tasks) {
+            perror("Allocation failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (uint32_t task = 0; task < task_count; task++) {
+        if (task / experiment.pattern_count == task % experiment.pattern_count) {
+            continue;
+        }
+        TaskDeque *deque = &experiment.deques[worker];
+        int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+        deque->tasks[bottom] = task;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        if (bottom + 1 == per_worker) {
+            worker++;
+        }
+    }
+
+    printf("Running %u matchups of %d-toss patterns on %d threads (target half-width %.4f)\n",
+           matchups, experiment.length, experiment.worker_count, experiment.half_width);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t *threads = malloc(experiment.worker_count * sizeof(pthread_t));
+    Worker *workers = malloc(experiment.worker_count * sizeof(Worker));
+    if (!threads || !workers) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int w = 0; w < experiment.worker_count; w++) {
+        workers[w].experiment = &experiment;
+        workers[w].index = w;
+        if (pthread_create(&threads[w], NULL, worker_main, &workers[w]) != 0) {
+            perror("Thread creation failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int w = 0; w < experiment.worker_count; w++) {
+        pthread_join(threads[w], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (csv_path) {
+        FILE *csv = fopen(csv_path, "w");
+        if (!csv) {
+            perror("Opening CSV file failed");
+            exit(EXIT_FAILURE);
+        }
+        fprintf(csv, "pattern_a,pattern_b,games,wins_a,win_rate_a,half_width,average_flips\n");
+        for (uint32_t task = 0; task < task_count; task++) {
+            MatchupResult *result = &experiment.results[task];
+            if (result->games == 0) {
+                continue;
+            }
+            char scratch_a[MAX_PATTERN_LENGTH + 1], scratch_b[MAX_PATTERN_LENGTH + 1];
+            fprintf(csv, "%s,%s,%llu,%llu,%.5f,%.5f,%.3f\n",
+                    pattern_display(task / experiment.pattern_count, experiment.length, scratch_a),
+                    pattern_display(task % experiment.pattern_count, experiment.length, scratch_b),
+                    (unsigned long long)result->games, (unsigned long long)result->wins,
+                    (double)result->wins / result->games, wilson_half_width(result->wins, result->games),
+                    (double)result->flips / result->games);
+        }
+        fclose(csv);
+        printf("Matchups written to %s\n", csv_path);
+    }
+
+    printf("\n--- Statistics ---\n");
+    for (int p = 0; p < experiment.pattern_count; p++) {
+        uint64_t games = atomic_load(&experiment.pattern_games[p]);
+        char scratch[MAX_PATTERN_LENGTH + 1];
+        printf("Pattern: %s, Wins: %llu, Total Games: %llu, Win Probability: %.4f, Average Flips: %.2f, Expected Flips Alone: %.0f\n",
+               pattern_display(p, experiment.length, scratch),
+               (unsigned long long)atomic_load(&experiment.pattern_wins[p]), (unsigned long long)games,
+               games ? (double)atomic_load(&experiment.pattern_wins[p]) / games : 0,
+               games ? (double)atomic_load(&experiment.pattern_flips[p]) / games : 0,
+               pattern_expected_wait(p, experiment.length));
+    }
+    printf("-------------------\n");
+
+    uint64_t total_games = atomic_load(&experiment.total_games);
+    printf("Games: %llu in %.2f s (%.0f games/s), seed %llu, %llu steals\n",
+           (unsigned long long)total_games, elapsed, total_games / elapsed,
+           (unsigned long long)experiment.seed, (unsigned long long)atomic_load(&experiment.steals));
+
+    for (int w = 0; w < experiment.worker_count; w++) {
+        free(experiment.deques[w].tasks);
+    }
+    free(experiment.deques);
+    free(experiment.results);
+    free(experiment.pattern_wins);
+    free(experiment.pattern_games);
+    free(experiment.pattern_flips);
+    free(threads);
+    free(workers);
+    return 0;
+}
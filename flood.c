@@ -0,0 +1,89 @@
+// flood.c
+//
+// Local registration flood generator for exercising the server's rate limiter.
+// Binds to a loopback alias (127.0.0.2 by default) so that real players on
+// 127.0.0.1 keep their own token buckets, and fires REGISTER datagrams at the
+// server as fast as the socket allows.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <stdint.h> // For uint8_t and uint16_t
+
+#include "protocol.h"
+
+int main(int argc, char *argv[]) {
+    const char *source = "127.0.0.2";
+    const char *target = "127.0.0.1";
+    long count = 0; // 0 floods until interrupted
+    int opt;
+    while ((opt = getopt(argc, argv, "a:t:n:")) != -1) {
+        switch (opt) {
+            case 'a':
+                source = optarg;
+                break;
+            case 't':
+                target = optarg;
+                break;
+            case 'n':
+                count = atol(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-a source_address] [-t server_address] [-n packets]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("Socket creation error");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_in source_addr;
+    memset(&source_addr, 0, sizeof(source_addr));
+    source_addr.sin_family = AF_INET;
+    source_addr.sin_port = 0;
+    if (inet_pton(AF_INET, source, &source_addr.sin_addr) <= 0 ||
+        bind(sock, (const struct sockaddr *)&source_addr, sizeof(source_addr)) < 0) {
+        perror("Bind to source address failed");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(PORT);
+    if (inet_pton(AF_INET, target, &serv_addr.sin_addr) <= 0) {
+        printf("\nInvalid address/ Address not supported \n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Flooding %s:%d with REGISTER from %s\n", target, PORT, source);
+
+    // REGISTER for pattern HHT (length 3), exactly what a real client sends first
+    uint16_t message = htons((MSG_REGISTER << BITS_MESSAGE) | ((3 - 1) << 9) | 0b110);
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long sent = 0;
+    while (count == 0 || sent < count) {
+        if (sendto(sock, &message, sizeof(message), 0,
+                   (const struct sockaddr *)&serv_addr, sizeof(serv_addr)) != sizeof(message)) {
+            continue;
+        }
+        if (++sent % 100000 == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            double elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+            printf("Sent %ld packets (%.0f packets/s)\n", sent, sent / elapsed);
+        }
+    }
+
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,33 @@
+// gen_pattern_tables.c
+//
+// Build-time generator for pattern_tables.c, see pattern_tables.h.
+// Usage: ./gen_pattern_tables > pattern_tables.c
+
+#include <stdio.h>
+
+#include "pattern_tables.h"
+
+int main() {
+    printf("// pattern_tables.c\n");
+    printf("//\n");
+    printf("// Generated by gen_pattern_tables.c, do not edit.\n\n");
+    printf("#include \"pattern_tables.h\"\n\n");
+
+    printf("const uint64_t pattern_length_masks[MAX_PATTERN_LENGTH + 1] = {\n");
+    for (int length = 0; length <= MAX_PATTERN_LENGTH; length++) {
+        printf("    0x%016llXULL,\n", (unsigned long long)PATTERN_MASK(length));
+    }
+    printf("};\n\n");
+
+    printf("const PatternEntry pattern_table[PATTERN_TABLE_SIZE] = {\n");
+    for (int length = 1; length <= PATTERN_TABLE_MAX_LENGTH; length++) {
+        for (uint64_t pattern = 0; pattern < (1ULL << length); pattern++) {
+            char display[PATTERN_TABLE_MAX_LENGTH + 1];
+            pattern_format(pattern, length, display);
+            uint64_t overlap = pattern_overlap_vector(pattern, length);
+            printf("    {\"%s\", 0x%02X, %.1f},\n", display, (unsigned)overlap, pattern_waiting_time(overlap, length));
+        }
+    }
+    printf("};\n");
+    return 0;
+}
@@ -0,0 +1,568 @@
+// history.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "history.h"
+
+// Function to checksum a record (FNV-1a), never 0 so that 0 marks unwritten space
+static uint32_t history_checksum(const uint8_t *data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+// Function to scramble a 64-bit value (splitmix64 finalizer)
+static uint64_t history_mix(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBULL;
+    key ^= key >> 31;
+    return key;
+}
+
+// Function to key a pattern; the length is part of it (HT and HHT are different patterns)
+static uint64_t history_pattern_key(uint64_t pattern, int pattern_length) {
+    return history_mix(pattern ^ history_mix(pattern_length));
+}
+
+// Function to key a client by its address and port
+static uint64_t history_client_key(uint32_t address, uint16_t port) {
+    return ((uint64_t)address << 16) | port;
+}
+
+// Function to build the path of a segment file ("log") or of its index ("idx")
+static void history_path(const HistoryStore *store, uint32_t number, const char *extension, char *path, size_t size) {
+    snprintf(path, size, "%s/segment-%08u.%s", store->directory, number, extension);
+}
+
+// Function to order index entries by key, then by record (game order)
+static int history_compare_entries(const void *a, const void *b) {
+    const HistoryIndexEntry *x = a;
+    const HistoryIndexEntry *y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    uint32_t x_offset = x->offset & ~HISTORY_WON;
+    uint32_t y_offset = y->offset & ~HISTORY_WON;
+    return x_offset < y_offset ? -1 : x_offset > y_offset;
+}
+
+// Function to index a record of a segment being built (active, or sealed without its index).
+// Returns -1 when the entry arrays cannot grow.
+static int history_add_entries(HistorySegment *segment, const HistoryRecord *record, uint32_t offset) {
+    HistoryIndexHeader *header = &segment->header;
+    if (header->client_entries + record->player_count > segment->entries_capacity) {
+        size_t capacity = segment->entries_capacity ? segment->entries_capacity * 2 : 4096;
+        while (capacity < header->client_entries + record->player_count) {
+            capacity *= 2;
+        }
+        HistoryIndexEntry *clients = realloc(segment->clients, capacity * sizeof(HistoryIndexEntry));
+        if (!clients) {
+            return -1;
+        }
+        segment->clients = clients;
+        HistoryIndexEntry *patterns = realloc(segment->patterns, capacity * sizeof(HistoryIndexEntry));
+        if (!patterns) {
+            return -1;
+        }
+        segment->patterns = patterns;
+        segment->entries_capacity = capacity;
+    }
+
+    uint32_t ended_s = record->ended_us / 1000000;
+    const HistoryPlayer *players = (const HistoryPlayer *)(record + 1);
+    for (int p = 0; p < record->player_count; p++) {
+        uint32_t entry_offset = offset | (players[p].won ? HISTORY_WON : 0);
+        segment->clients[header->client_entries++] =
+            (HistoryIndexEntry){history_client_key(players[p].address, players[p].port), entry_offset, ended_s};
+        segment->patterns[header->pattern_entries++] =
+            (HistoryIndexEntry){history_pattern_key(players[p].pattern, players[p].pattern_length), entry_offset, ended_s};
+    }
+    if (header->records == 0) {
+        header->first_game_id = record->game_id;
+        header->min_ended_s = ended_s;
+    }
+    if (ended_s > header->max_ended_s) {
+        header->max_ended_s = ended_s;
+    }
+    header->records++;
+    return 0;
+}
+
+// Function to walk the records of a segment from the start, indexing them, up to the
+// first one that is unwritten or torn. Returns -1 when indexing runs out of memory.
+static int history_scan(HistorySegment *segment) {
+    size_t offset = 0;
+    while (offset + sizeof(HistoryRecord) <= segment->map_size) {
+        const HistoryRecord *record = (const HistoryRecord *)(segment->data + offset);
+        if (record->checksum == 0 || record->player_count > HISTORY_MAX_PLAYERS ||
+            record->size != sizeof(HistoryRecord) + record->player_count * sizeof(HistoryPlayer) ||
+            offset + record->size > segment->map_size ||
+            history_checksum((const uint8_t *)record + sizeof(uint32_t), record->size - sizeof(uint32_t)) != record->checksum) {
+            break;
+        }
+        if (history_add_entries(segment, record, offset) < 0) {
+            return -1;
+        }
+        offset += record->size;
+    }
+    segment->data_size = offset;
+    segment->header.data_size = offset;
+    return 0;
+}
+
+// Function to sort a segment's entries and write them as its index file.
+// The file appears under its final name only once complete.
+static int history_write_index(HistoryStore *store, HistorySegment *segment) {
+    HistoryIndexHeader *header = &segment->header;
+    header->magic = HISTORY_MAGIC;
+    header->version = HISTORY_VERSION;
+    header->data_size = segment->data_size;
+    qsort(segment->clients, header->client_entries, sizeof(HistoryIndexEntry), history_compare_entries);
+    qsort(segment->patterns, header->pattern_entries, sizeof(HistoryIndexEntry), history_compare_entries);
+
+    char path[HISTORY_PATH_MAX + 32];
+    char temporary[HISTORY_PATH_MAX + 32];
+    history_path(store, segment->number, "idx", path, sizeof(path));
+    history_path(store, segment->number, "idx.tmp", temporary, sizeof(temporary));
+    FILE *file = fopen(temporary, "wb");
+    if (!file) {
+        perror("History index open failed");
+        return -1;
+    }
+    // Totals per client, one per run of the sorted client entries
+    header->client_totals = 0;
+    for (uint32_t e = 0; e < header->client_entries; e++) {
+        header->client_totals += e == 0 || segment->clients[e].key != segment->clients[e - 1].key;
+    }
+    HistoryClientTotals *totals = calloc(header->client_totals ? header->client_totals : 1, sizeof(HistoryClientTotals));
+    if (!totals) {
+        fclose(file);
+        unlink(temporary);
+        return -1;
+    }
+    int run = -1;
+    for (uint32_t e = 0; e < header->client_entries; e++) {
+        if (e == 0 || segment->clients[e].key != segment->clients[e - 1].key) {
+            totals[++run].key = segment->clients[e].key;
+        }
+        totals[run].games++;
+        totals[run].wins += (segment->clients[e].offset & HISTORY_WON) != 0;
+    }
+
+    int ok = fwrite(header, sizeof(*header), 1, file) == 1 &&
+             fwrite(segment->clients, sizeof(HistoryIndexEntry), header->client_entries, file) == header->client_entries &&
+             fwrite(segment->patterns, sizeof(HistoryIndexEntry), header->pattern_entries, file) == header->pattern_entries &&
+             fwrite(totals, sizeof(HistoryClientTotals), header->client_totals, file) == header->client_totals;
+    free(totals);
+    if (fclose(file) != 0 || !ok || rename(temporary, path) < 0) {
+        perror("History index write failed");
+        unlink(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to map a sealed segment and its index, rebuilding the index if it is missing
+// or does not match the segment. Returns 0 on success, -1 on error.
+static int history_load_sealed(HistoryStore *store, HistorySegment *segment) {
+    char path[HISTORY_PATH_MAX + 32];
+    history_path(store, segment->number, "log", path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror("History segment open failed");
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    segment->map_size = st.st_size;
+    segment->data = st.st_size ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : NULL;
+    close(fd);
+    if (segment->data == MAP_FAILED) {
+        perror("History segment mapping failed");
+        segment->data = NULL;
+        return -1;
+    }
+    segment->data_size = st.st_size;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        history_path(store, segment->number, "idx", path, sizeof(path));
+        fd = open(path, O_RDONLY);
+        if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(HistoryIndexHeader)) {
+            void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            const HistoryIndexHeader *header = map;
+            if (map != MAP_FAILED && header->magic == HISTORY_MAGIC && header->version == HISTORY_VERSION &&
+                header->data_size <= segment->map_size &&
+                (size_t)st.st_size == sizeof(*header) +
+                                          ((size_t)header->client_entries + header->pattern_entries) * sizeof(HistoryIndexEntry) +
+                                          (size_t)header->client_totals * sizeof(HistoryClientTotals)) {
+                close(fd);
+                segment->index_map = map;
+                segment->index_map_size = st.st_size;
+                segment->header = *header;
+                segment->data_size = header->data_size; // Untrimmed if the crash came right after the index
+                segment->clients = (HistoryIndexEntry *)(header + 1);
+                segment->patterns = segment->clients + header->client_entries;
+                segment->totals = (HistoryClientTotals *)(segment->patterns + header->pattern_entries);
+                return 0;
+            }
+            if (map != MAP_FAILED) {
+                munmap(map, st.st_size);
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (attempt == 1) {
+            break;
+        }
+        // Crash while sealing: index the records again and write the index
+        printf("Rebuilding history index of segment %u\n", segment->number);
+        memset(&segment->header, 0, sizeof(segment->header));
+        int failed = history_scan(segment) < 0 || history_write_index(store, segment) < 0;
+        free(segment->clients);
+        free(segment->patterns);
+        segment->clients = segment->patterns = NULL;
+        segment->entries_capacity = 0;
+        if (failed) {
+            return -1;
+        }
+    }
+    fprintf(stderr, "History index of segment %u is unreadable\n", segment->number);
+    return -1;
+}
+
+// Function to open (creating if needed) a segment for appending and index what it already holds
+static int history_load_active(HistoryStore *store, HistorySegment *segment) {
+    char path[HISTORY_PATH_MAX + 32];
+    history_path(store, segment->number, "log", path, sizeof(path));
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror("History segment open failed");
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    // Sized for a full segment up front; the file stays sparse until written
+    segment->map_size = (size_t)st.st_size > HISTORY_SEGMENT_BYTES ? (size_t)st.st_size : HISTORY_SEGMENT_BYTES;
+    if ((size_t)st.st_size < segment->map_size && ftruncate(fd, segment->map_size) < 0) {
+        perror("History segment sizing failed");
+        close(fd);
+        return -1;
+    }
+    segment->data = mmap(NULL, segment->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment->data == MAP_FAILED) {
+        perror("History segment mapping failed");
+        segment->data = NULL;
+        return -1;
+    }
+    return history_scan(segment);
+}
+
+// Function to add an empty slot for segment `number` to the store
+static HistorySegment *history_add_segment(HistoryStore *store, uint32_t number) {
+    if (store->segment_count == store->segment_capacity) {
+        int capacity = store->segment_capacity ? store->segment_capacity * 2 : 64;
+        HistorySegment *segments = realloc(store->segments, capacity * sizeof(HistorySegment));
+        if (!segments) {
+            return NULL;
+        }
+        store->segments = segments;
+        store->segment_capacity = capacity;
+    }
+    HistorySegment *segment = &store->segments[store->segment_count++];
+    memset(segment, 0, sizeof(*segment));
+    segment->number = number;
+    return segment;
+}
+
+// Function to seal the active segment (index written, file trimmed, mapped read-only) and
+// start the next one. Returns 0 on success, -1 on error.
+static int history_seal(HistoryStore *store) {
+    HistorySegment *segment = &store->segments[store->segment_count - 1];
+    if (history_write_index(store, segment) < 0) {
+        return -1;
+    }
+    char path[HISTORY_PATH_MAX + 32];
+    history_path(store, segment->number, "log", path, sizeof(path));
+    munmap(segment->data, segment->map_size);
+    free(segment->clients);
+    free(segment->patterns);
+    if (truncate(path, segment->data_size) < 0) {
+        perror("History segment trim failed");
+    }
+    uint32_t number = segment->number;
+    memset(segment, 0, sizeof(*segment));
+    segment->number = number;
+    if (history_load_sealed(store, segment) < 0) {
+        return -1;
+    }
+    HistorySegment *active = history_add_segment(store, number + 1);
+    return active ? history_load_active(store, active) : -1;
+}
+
+// Function to order segment numbers
+static int history_compare_numbers(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Function to open (creating if needed) the store in a directory.
+// Returns 0 on success, -1 on error.
+int history_open(HistoryStore *store, const char *directory) {
+    memset(store, 0, sizeof(*store));
+    snprintf(store->directory, sizeof(store->directory), "%s", directory);
+    if (mkdir(directory, 0755) < 0 && errno != EEXIST) {
+        perror("History directory creation failed");
+        return -1;
+    }
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        perror("History directory open failed");
+        return -1;
+    }
+    uint32_t *numbers = NULL;
+    int count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        uint32_t number;
+        char extension[8];
+        if (sscanf(entry->d_name, "segment-%8u.%7s", &number, extension) == 2 && strcmp(extension, "log") == 0) {
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                uint32_t *grown = realloc(numbers, capacity * sizeof(uint32_t));
+                if (!grown) {
+                    break;
+                }
+                numbers = grown;
+            }
+            numbers[count++] = number;
+        }
+    }
+    closedir(dir);
+    qsort(numbers, count, sizeof(uint32_t), history_compare_numbers);
+
+    // Every segment but the last is sealed; the last is sealed too if its index made it to disk
+    int failed = 0;
+    for (int i = 0; i < count && !failed; i++) {
+        char path[HISTORY_PATH_MAX + 32];
+        history_path(store, numbers[i], "idx", path, sizeof(path));
+        HistorySegment *segment = history_add_segment(store, numbers[i]);
+        if (!segment) {
+            failed = 1;
+        } else if (i < count - 1 || access(path, F_OK) == 0) {
+            failed = history_load_sealed(store, segment) < 0;
+        } else {
+            failed = history_load_active(store, segment) < 0;
+        }
+    }
+    if (!failed && (count == 0 || store->segments[store->segment_count - 1].index_map)) {
+        HistorySegment *segment = history_add_segment(store, count ? numbers[count - 1] + 1 : 0);
+        failed = !segment || history_load_active(store, segment) < 0;
+    }
+    free(numbers);
+    if (failed) {
+        history_close(store);
+        return -1;
+    }
+
+    store->next_game_id = 1;
+    for (int s = 0; s < store->segment_count; s++) {
+        if (store->segments[s].header.records) {
+            store->next_game_id = store->segments[s].header.first_game_id + store->segments[s].header.records;
+        }
+    }
+    return 0;
+}
+
+// Function to append a completed game; its ID is filled in.
+// Returns 0 on success, -1 on error.
+int history_append(HistoryStore *store, HistoryGame *game) {
+    if (game->player_count < 1 || game->player_count > HISTORY_MAX_PLAYERS) {
+        return -1;
+    }
+    size_t size = sizeof(HistoryRecord) + game->player_count * sizeof(HistoryPlayer);
+    HistorySegment *segment = &store->segments[store->segment_count - 1];
+    if (segment->header.records >= HISTORY_SEGMENT_RECORDS || segment->data_size + size > segment->map_size) {
+        if (history_seal(store) < 0) {
+            return -1;
+        }
+        segment = &store->segments[store->segment_count - 1];
+    }
+
+    game->game_id = store->next_game_id;
+    HistoryRecord *record = (HistoryRecord *)(segment->data + segment->data_size);
+    record->size = size;
+    record->player_count = game->player_count;
+    record->reserved = 0;
+    record->game_id = game->game_id;
+    record->started_us = game->started_us;
+    record->ended_us = game->ended_us;
+    record->flips = game->flips;
+    memcpy(record + 1, game->players, game->player_count * sizeof(HistoryPlayer));
+    uint32_t checksum = history_checksum((const uint8_t *)record + sizeof(uint32_t), size - sizeof(uint32_t));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record->checksum = checksum; // Written last: the record counts once this is in place
+
+    if (history_add_entries(segment, record, segment->data_size) < 0) {
+        record->checksum = 0;
+        return -1;
+    }
+    segment->data_size += size;
+    segment->header.data_size = segment->data_size;
+    store->next_game_id++;
+    store->appended++;
+    return 0;
+}
+
+// Function to find the run of entries with a key in a sealed index: [*first, *last)
+static void history_find_run(const HistoryIndexEntry *entries, uint32_t count, uint64_t key, uint32_t *first, uint32_t *last) {
+    uint32_t low = 0, high = count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (entries[middle].key < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *first = low;
+    high = count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (entries[middle].key <= key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *last = low;
+}
+
+// Function to copy a record out of a segment
+static void history_decode(const HistorySegment *segment, uint32_t offset, HistoryGame *game) {
+    const HistoryRecord *record = (const HistoryRecord *)(segment->data + (offset & ~HISTORY_WON));
+    game->game_id = record->game_id;
+    game->started_us = record->started_us;
+    game->ended_us = record->ended_us;
+    game->flips = record->flips;
+    game->player_count = record->player_count;
+    memcpy(game->players, record + 1, record->player_count * sizeof(HistoryPlayer));
+}
+
+// Function to fetch the most recent games a pattern played in, newest first.
+// Returns the number of games filled in (at most limit).
+int history_recent_by_pattern(HistoryStore *store, uint64_t pattern, int pattern_length, HistoryGame games[], int limit) {
+    uint64_t key = history_pattern_key(pattern, pattern_length);
+    int found = 0;
+    for (int s = store->segment_count - 1; s >= 0 && found < limit; s--) {
+        const HistorySegment *segment = &store->segments[s];
+        uint32_t first = 0, last = segment->header.pattern_entries;
+        if (segment->index_map) {
+            history_find_run(segment->patterns, segment->header.pattern_entries, key, &first, &last);
+        }
+        for (uint32_t e = last; e > first && found < limit; e--) {
+            if (segment->patterns[e - 1].key != key) {
+                continue; // Active segment: entries are in game order, not sorted
+            }
+            history_decode(segment, segment->patterns[e - 1].offset, &games[found]);
+            for (int p = 0; p < games[found].player_count; p++) {
+                if (games[found].players[p].pattern == pattern && games[found].players[p].pattern_length == pattern_length) {
+                    found++; // Keys are hashes: keep the game only if the pattern is really in it
+                    break;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+// Function to count a client's games and wins that ended at or after since_s.
+// Returns 0.
+int history_client_summary(HistoryStore *store, uint32_t address, uint16_t port, uint32_t since_s,
+                           HistorySummary *summary) {
+    uint64_t key = history_client_key(address, port);
+    summary->games = 0;
+    summary->wins = 0;
+    for (int s = store->segment_count - 1; s >= 0; s--) {
+        const HistorySegment *segment = &store->segments[s];
+        if (segment->header.records && segment->header.max_ended_s < since_s) {
+            break; // This segment and all older ones ended before the window
+        }
+        uint32_t first = 0, last = segment->header.client_entries;
+        if (segment->index_map && segment->header.min_ended_s >= since_s) {
+            // The whole segment is in the window: the client's totals answer for it
+            uint32_t low = 0, high = segment->header.client_totals;
+            while (low < high) {
+                uint32_t middle = low + (high - low) / 2;
+                if (segment->totals[middle].key < key) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            if (low < segment->header.client_totals && segment->totals[low].key == key) {
+                summary->games += segment->totals[low].games;
+                summary->wins += segment->totals[low].wins;
+            }
+            continue;
+        }
+        if (segment->index_map) {
+            history_find_run(segment->clients, segment->header.client_entries, key, &first, &last);
+        }
+        for (uint32_t e = first; e < last; e++) {
+            const HistoryIndexEntry *entry = &segment->clients[e];
+            if (entry->key == key && entry->ended_s >= since_s) {
+                summary->games++;
+                summary->wins += (entry->offset & HISTORY_WON) != 0;
+            }
+        }
+    }
+    return 0;
+}
+
+// Function to count the games in the store
+uint64_t history_games(const HistoryStore *store) {
+    uint64_t games = 0;
+    for (int s = 0; s < store->segment_count; s++) {
+        games += store->segments[s].header.records;
+    }
+    return games;
+}
+
+// Function to unmap the store, the games stay on disk (the active segment keeps its spare room)
+void history_close(HistoryStore *store) {
+    for (int s = 0; s < store->segment_count; s++) {
+        HistorySegment *segment = &store->segments[s];
+        if (segment->data) {
+            munmap(segment->data, segment->map_size);
+        }
+        if (segment->index_map) {
+            munmap(segment->index_map, segment->index_map_size);
+        } else {
+            free(segment->clients);
+            free(segment->patterns);
+        }
+    }
+    free(store->segments);
+    store->segments = NULL;
+    store->segment_count = 0;
+    store->segment_capacity = 0;
+}
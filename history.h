@@ -0,0 +1,135 @@
+// history.h
+//
+// Append-only store of completed games with secondary indexes by client
+// and by pattern.
+//
+// Games are appended to the active segment, an mmap'd file of at most
+// HISTORY_SEGMENT_RECORDS records; appending is a memory copy, the kernel
+// writes the pages back. A full segment is sealed: the file is trimmed and
+// an index file is written next to it holding (key, record offset, end
+// time, won) entries sorted by key, one run per client and per pattern in
+// game order, plus each client's game and win totals for the segment.
+// Queries binary-search each sealed index, newest segment first, and stop
+// once they have enough games (or reach games older than asked for); a
+// client's totals over whole segments come from the totals, so only the
+// segment the time window starts in and the active segment (from memory)
+// are walked entry by entry.
+//
+// Each record carries a checksum, so a record torn by a crash ends the
+// active segment when it is reopened. A missing index (crash while
+// sealing) is rebuilt from its segment.
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HISTORY_MAGIC           0x50454E49 // "PENI", index files
+#define HISTORY_VERSION         1
+#define HISTORY_MAX_PLAYERS     15         // Players of one game (4-bit client IDs)
+#define HISTORY_SEGMENT_RECORDS 131072     // Games per segment
+#define HISTORY_PATH_MAX        256
+
+// Record as stored in a segment, followed by player_count HistoryPlayer
+typedef struct __attribute__((packed)) {
+    uint32_t checksum;     // FNV-1a of everything after this field, never 0 once written
+    uint16_t size;         // Whole record in bytes
+    uint8_t player_count;
+    uint8_t reserved;
+    uint64_t game_id;      // Assigned by the store, increasing
+    uint64_t started_us;   // Wall clock, microseconds since the epoch
+    uint64_t ended_us;
+    uint32_t flips;        // Tosses the game took
+} HistoryRecord;
+
+typedef struct __attribute__((packed)) {
+    uint64_t pattern;      // Last toss in bit 0 (1 = tails)
+    uint32_t address;      // IPv4, network byte order
+    uint16_t port;         // Network byte order
+    uint8_t pattern_length;
+    uint8_t won;
+} HistoryPlayer;
+
+#define HISTORY_RECORD_MAX (sizeof(HistoryRecord) + HISTORY_MAX_PLAYERS * sizeof(HistoryPlayer))
+#define HISTORY_SEGMENT_BYTES ((size_t)HISTORY_SEGMENT_RECORDS * HISTORY_RECORD_MAX) // Upper bound, sparse
+
+// Index entry: 16 bytes per player of each game
+typedef struct {
+    uint64_t key;          // Client address and port, or pattern hash
+    uint32_t offset;       // Record offset in the segment, HISTORY_WON set when this player won
+    uint32_t ended_s;      // Game end, seconds since the epoch
+} HistoryIndexEntry;
+
+#define HISTORY_WON 0x80000000u
+
+// A client's totals in a sealed segment
+typedef struct {
+    uint64_t key;
+    uint32_t games;
+    uint32_t wins;
+} HistoryClientTotals;
+
+// Header of a sealed segment's index file, followed by the client entries, the pattern
+// entries and the client totals
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t first_game_id;
+    uint64_t data_size;      // Bytes of records in the segment
+    uint32_t records;
+    uint32_t client_entries;
+    uint32_t pattern_entries;
+    uint32_t client_totals;
+    uint32_t min_ended_s;
+    uint32_t max_ended_s;
+} HistoryIndexHeader;
+
+// One segment: the mapped records plus its index (mapped once sealed, in memory while active)
+typedef struct {
+    uint32_t number;
+    uint8_t *data;
+    size_t data_size;        // Bytes of records
+    size_t map_size;
+    HistoryIndexHeader header;
+    void *index_map;         // Sealed index file, NULL while active
+    size_t index_map_size;
+    HistoryIndexEntry *clients;
+    HistoryIndexEntry *patterns;
+    HistoryClientTotals *totals; // Sealed segments only
+    size_t entries_capacity; // Active segment only
+} HistorySegment;
+
+// Game as handed to and returned by the store
+typedef struct {
+    uint64_t game_id;
+    uint64_t started_us;
+    uint64_t ended_us;
+    uint32_t flips;
+    int player_count;
+    HistoryPlayer players[HISTORY_MAX_PLAYERS];
+} HistoryGame;
+
+typedef struct {
+    char directory[HISTORY_PATH_MAX];
+    HistorySegment *segments; // Oldest first, the last one is active
+    int segment_count;
+    int segment_capacity;
+    uint64_t next_game_id;
+    unsigned long long appended;
+} HistoryStore;
+
+typedef struct {
+    uint64_t games;
+    uint64_t wins;
+} HistorySummary;
+
+int history_open(HistoryStore *store, const char *directory);
+int history_append(HistoryStore *store, HistoryGame *game);
+int history_recent_by_pattern(HistoryStore *store, uint64_t pattern, int pattern_length, HistoryGame games[], int limit);
+int history_client_summary(HistoryStore *store, uint32_t address, uint16_t port, uint32_t since_s,
+                           HistorySummary *summary);
+uint64_t history_games(const HistoryStore *store);
+void history_close(HistoryStore *store);
+
+#endif // HISTORY_H
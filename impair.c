@@ -0,0 +1,772 @@
+// impair.c
+//
+// Loopback network impairment proxy for benchmarking the protocol. Sits
+// between the players and the server like router.c (one connected socket
+// per player) and pushes every datagram, in both directions, through a
+// seeded model of a bad network: bursty loss, delay with jitter,
+// duplication and reordering. No root or tc needed.
+//
+// A scenario file switches profiles over time, one line per phase:
+//     # seconds  profile [key=value ...]
+//     0   wifi
+//     10  lossy loss=8 burst=3
+//     20  outage
+//     25  wifi
+//     40  end
+// Profiles: perfect, lan, wifi, lossy, mobile, satellite, outage. Keys:
+// loss (%), burst (mean datagrams per loss burst), delay (ms), jitter (ms,
+// uniform +/-), dup (%), reorder (%), hold (ms a reordered datagram is
+// held back).
+//
+// The proxy reads the ALP words going by and reports per phase: games won
+// and lost, false claims (the pattern is not where the WIN claim says, as
+// checked against the tosses the server sent), late claims (valid, but
+// answered with LOSE), stalled games (no toss or result for STALL_MS), and
+// latencies seen at the player's side of the link. Players must use plain
+// UDP (no -m, no -s), otherwise their tosses bypass the proxy.
+//
+// Usage: ./impair [-s host:port] [-l listen_port] [-P profile] [-x scenario] [-d seconds] [-S seed]
+// The report is printed when the scenario ends, after -d seconds, or on Ctrl-C.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <stdint.h> // For uint8_t and uint16_t
+#include <endian.h> // For be64toh
+
+#include "protocol.h"
+#include "latency.h"
+
+#define IMPAIR_SERVER "127.0.0.1:9001"
+#define IMPAIR_MAX_SESSIONS 64
+#define IMPAIR_FRAME_MAX 64
+#define IMPAIR_QUEUE 8192    // Datagrams held in flight
+#define IMPAIR_MAX_PHASES 32
+#define IMPAIR_EVENTS 64
+#define STALL_MS 2000        // A game with no toss or result for this long is stalled
+
+#define TO_SERVER 0
+#define TO_PLAYER 1
+
+// Structure to hold a network profile
+typedef struct {
+    char name[16];
+    double loss;      // Percent of datagrams dropped
+    double burst;     // Mean length of a loss burst in datagrams (1 = independent losses)
+    double delay_ms;  // One-way delay
+    double jitter_ms; // Uniform +/- around the delay, reorders on its own when large
+    double dup;       // Percent of datagrams sent twice
+    double reorder;   // Percent of datagrams held back so later ones overtake them
+    double hold_ms;   // Extra delay of held-back datagrams
+} Profile;
+
+static const Profile profiles[] = {
+    {"perfect",   0,   1, 0,   0,  0,   0, 0},
+    {"lan",       0,   1, 0.2, 0.1, 0,  0, 0},
+    {"wifi",      1,   2, 3,   2,  0.1, 0.5, 5},
+    {"lossy",     5,   1, 20,  5,  1,   2, 10},
+    {"mobile",    2,   3, 50,  20, 0.5, 3, 30},
+    {"satellite", 0.5, 1, 300, 10, 0,   0, 0},
+    {"outage",    100, 1, 0,   0,  0,   0, 0},
+};
+
+// Structure to hold what happened during a phase
+typedef struct {
+    unsigned long long forwarded[2];
+    unsigned long long lost[2];
+    unsigned long long duplicated[2];
+    unsigned long long reordered[2];
+    unsigned long long overflow;  // Dropped because too many datagrams were in flight
+    unsigned long long wins;
+    unsigned long long losses;
+    unsigned long long false_claims;
+    unsigned long long late_claims;
+    unsigned long long stalls;
+    unsigned long long unfinished; // Games still running when the run ended
+    LatencyHistogram claim;  // Toss delivered to the player -> its WIN claim reaches the proxy
+    LatencyHistogram result; // WIN claim -> result delivered to the player
+    LatencyHistogram game;   // First toss -> result, both as delivered to the player
+} Stats;
+
+typedef struct {
+    double at_s;
+    Profile profile;
+    Stats stats;
+} Phase;
+
+typedef struct {
+    int in_use;
+    struct sockaddr_in client;
+    int fd;                  // Connected to the server
+    int in_game;             // Tosses delivered since the last result
+    int claimed;             // WIN claim seen in this game
+    int claim_valid;
+    uint64_t pattern;        // From the player's REGISTER
+    int pattern_length;
+    uint8_t tosses[256];     // Tosses as the server sent them, by index (low byte)
+    int stalled;
+    long long last_us;       // Last toss or result delivered
+    long long game_start_us;
+    long long claim_us;
+    long long toss_us[256];  // Delivery time by toss index (low byte)
+} Session;
+
+// Datagram waiting for its release time
+typedef struct {
+    long long release_us;
+    unsigned long long order; // Keeps arrival order among equal release times
+    int session;
+    int direction;
+    uint8_t length;
+    uint8_t data[IMPAIR_FRAME_MAX];
+} Delayed;
+
+typedef struct {
+    int listen_fd;
+    int epoll_fd;
+    struct sockaddr_in server;
+    Session sessions[IMPAIR_MAX_SESSIONS];
+    Delayed queue[IMPAIR_QUEUE]; // Binary min-heap on release time
+    int queued;
+    unsigned long long order;
+    Phase phases[IMPAIR_MAX_PHASES];
+    int phase_count;
+    int phase;
+    double end_s;            // 0 runs until interrupted
+    long long start_us;
+    uint64_t rng;
+    int losing[2];           // Loss burst in progress, per direction
+} Impairment;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+// Function prototypes
+long long now_us();
+double random_unit(Impairment *impairment);
+int parse_address(const char *text, struct sockaddr_in *address);
+int parse_profile(char *spec, Profile *profile);
+int load_scenario(const char *path, Impairment *impairment);
+int find_session(Impairment *impairment, const struct sockaddr_in *client);
+void impair_datagram(Impairment *impairment, int session, int direction, const uint8_t *frame, size_t length);
+void push_delayed(Impairment *impairment, int session, int direction, const uint8_t *frame, size_t length, long long release_us);
+void pop_delayed(Impairment *impairment, Delayed *out);
+void deliver(Impairment *impairment, const Delayed *datagram);
+void observe_player(Impairment *impairment, Session *session, const uint8_t *frame, size_t length);
+void observe_server(Session *session, const uint8_t *frame, size_t length);
+void observe_delivery(Impairment *impairment, Session *session, const uint8_t *frame, size_t length);
+void check_stalls(Impairment *impairment);
+void print_profile(FILE *out, const Profile *profile);
+void print_stats(FILE *out, const Stats *stats);
+void print_report(Impairment *impairment);
+void handle_stop(int signal_number);
+
+int main(int argc, char *argv[]) {
+    static Impairment impairment; // Delay queue and sessions, keep them off the stack
+    memset(&impairment, 0, sizeof(impairment));
+    const char *server = IMPAIR_SERVER;
+    const char *scenario = NULL;
+    char steady[128] = "perfect";
+    int listen_port = PORT;
+    uint64_t seed = time(NULL);
+    int opt;
+    while ((opt = getopt(argc, argv, "s:l:P:x:d:S:")) != -1) {
+        switch (opt) {
+            case 's':
+                server = optarg;
+                break;
+            case 'l':
+                listen_port = atoi(optarg);
+                break;
+            case 'P':
+                snprintf(steady, sizeof(steady), "%s", optarg);
+                break;
+            case 'x':
+                scenario = optarg;
+                break;
+            case 'd':
+                impairment.end_s = atof(optarg);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-s host:port] [-l listen_port] [-P profile] [-x scenario] [-d seconds] [-S seed]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (parse_address(server, &impairment.server) < 0 || listen_port <= 0 || listen_port > 65535) {
+        fprintf(stderr, "Invalid server address %s or listen port %d\n", server, listen_port);
+        exit(EXIT_FAILURE);
+    }
+    if (scenario) {
+        if (load_scenario(scenario, &impairment) < 0) {
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        impairment.phase_count = 1;
+        if (parse_profile(steady, &impairment.phases[0].profile) < 0) {
+            fprintf(stderr, "Invalid profile \"%s\"\n", steady);
+            exit(EXIT_FAILURE);
+        }
+    }
+    impairment.rng = seed ? seed : 1;
+
+    impairment.listen_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    impairment.epoll_fd = epoll_create1(0);
+    struct sockaddr_in listen_addr;
+    memset(&listen_addr, 0, sizeof(listen_addr));
+    listen_addr.sin_family = AF_INET;
+    listen_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listen_addr.sin_port = htons(listen_port);
+    if (impairment.listen_fd < 0 || impairment.epoll_fd < 0 ||
+        bind(impairment.listen_fd, (const struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0) {
+        perror("Proxy setup failed");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(impairment.listen_fd, F_SETFL, fcntl(impairment.listen_fd, F_GETFL, 0) | O_NONBLOCK);
+    struct epoll_event event = {EPOLLIN, {.u32 = (uint32_t)-1}};
+    epoll_ctl(impairment.epoll_fd, EPOLL_CTL_ADD, impairment.listen_fd, &event);
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    printf("Impairing 127.0.0.1:%d -> %s (seed %llu), phase 0: ", listen_port, server, (unsigned long long)seed);
+    print_profile(stdout, &impairment.phases[0].profile);
+    printf("\n");
+    fflush(stdout);
+
+    impairment.start_us = now_us();
+    long long next_check_us = impairment.start_us + 100000;
+    struct epoll_event events[IMPAIR_EVENTS];
+    while (!stop_requested) {
+        long long now = now_us();
+        double elapsed_s = (now - impairment.start_us) / 1e6;
+        if (impairment.end_s > 0 && elapsed_s >= impairment.end_s) {
+            break;
+        }
+        while (impairment.phase + 1 < impairment.phase_count && elapsed_s >= impairment.phases[impairment.phase + 1].at_s) {
+            impairment.phase++;
+            printf("Phase %d at %.1f s: ", impairment.phase, elapsed_s);
+            print_profile(stdout, &impairment.phases[impairment.phase].profile);
+            printf("\n");
+            fflush(stdout);
+        }
+
+        // Sleep until the next release; the last millisecond is spun for sub-ms delays
+        long long wait_us = impairment.queued ? impairment.queue[0].release_us - now : 100000;
+        int timeout_ms = wait_us <= 0 ? 0 : wait_us < 1000 ? 0 : wait_us > 100000 ? 100 : (int)(wait_us / 1000);
+        int ready = epoll_wait(impairment.epoll_fd, events, IMPAIR_EVENTS, timeout_ms);
+        for (int e = 0; e < ready; e++) {
+            uint8_t frame[IMPAIR_FRAME_MAX];
+            uint32_t tag = events[e].data.u32;
+            while (1) {
+                ssize_t length;
+                int session;
+                if (tag == (uint32_t)-1) {
+                    struct sockaddr_in client;
+                    socklen_t client_len = sizeof(client);
+                    length = recvfrom(impairment.listen_fd, frame, sizeof(frame), MSG_DONTWAIT,
+                                      (struct sockaddr *)&client, &client_len);
+                    if (length < 0) {
+                        break;
+                    }
+                    session = find_session(&impairment, &client);
+                    if (session < 0) {
+                        continue;
+                    }
+                    observe_player(&impairment, &impairment.sessions[session], frame, length);
+                    impair_datagram(&impairment, session, TO_SERVER, frame, length);
+                } else {
+                    session = tag;
+                    length = recv(impairment.sessions[session].fd, frame, sizeof(frame), MSG_DONTWAIT);
+                    if (length < 0) {
+                        break;
+                    }
+                    observe_server(&impairment.sessions[session], frame, length);
+                    impair_datagram(&impairment, session, TO_PLAYER, frame, length);
+                }
+            }
+        }
+
+        now = now_us();
+        while (impairment.queued && impairment.queue[0].release_us <= now) {
+            Delayed datagram;
+            pop_delayed(&impairment, &datagram);
+            deliver(&impairment, &datagram);
+        }
+        if (now >= next_check_us) {
+            check_stalls(&impairment);
+            next_check_us = now + 100000;
+        }
+    }
+
+    print_report(&impairment);
+    return 0;
+}
+
+// Function to get a monotonic timestamp in microseconds
+long long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Function to draw a uniform number in [0, 1) from the seeded generator (xorshift64*)
+double random_unit(Impairment *impairment) {
+    impairment->rng ^= impairment->rng >> 12;
+    impairment->rng ^= impairment->rng << 25;
+    impairment->rng ^= impairment->rng >> 27;
+    return ((impairment->rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Function to parse "host:port", returns -1 if it is invalid
+int parse_address(const char *text, struct sockaddr_in *address) {
+    char host[64];
+    int port;
+    if (sscanf(text, "%63[^:]:%d", host, &port) != 2 || port <= 0 || port > 65535) {
+        return -1;
+    }
+    memset(address, 0, sizeof(*address));
+    address->sin_family = AF_INET;
+    address->sin_port = htons(port);
+    return inet_pton(AF_INET, host, &address->sin_addr) == 1 ? 0 : -1;
+}
+
+// Function to parse "[profile] [key=value ...]" (modifies spec), returns -1 if it is invalid
+int parse_profile(char *spec, Profile *profile) {
+    *profile = profiles[0];
+    char *token = strtok(spec, " \t\r\n");
+    if (token && !strchr(token, '=')) {
+        size_t p;
+        for (p = 0; p < sizeof(profiles) / sizeof(profiles[0]) && strcmp(profiles[p].name, token) != 0; p++) {
+        }
+        if (p == sizeof(profiles) / sizeof(profiles[0])) {
+            return -1;
+        }
+        *profile = profiles[p];
+        token = strtok(NULL, " \t\r\n");
+    }
+    for (; token; token = strtok(NULL, " \t\r\n")) {
+        char key[16];
+        double value;
+        if (sscanf(token, "%15[^=]=%lf", key, &value) != 2 || value < 0) {
+            return -1;
+        }
+        if (strcmp(key, "loss") == 0 && value <= 100) {
+            profile->loss = value;
+        } else if (strcmp(key, "burst") == 0 && value >= 1) {
+            profile->burst = value;
+        } else if (strcmp(key, "delay") == 0) {
+            profile->delay_ms = value;
+        } else if (strcmp(key, "jitter") == 0) {
+            profile->jitter_ms = value;
+        } else if (strcmp(key, "dup") == 0 && value <= 100) {
+            profile->dup = value;
+        } else if (strcmp(key, "reorder") == 0 && value <= 100) {
+            profile->reorder = value;
+        } else if (strcmp(key, "hold") == 0) {
+            profile->hold_ms = value;
+        } else {
+            return -1;
+        }
+        if (!strchr(profile->name, '+')) {
+            strncat(profile->name, "+", sizeof(profile->name) - strlen(profile->name) - 1); // Modified profile
+        }
+    }
+    return 0;
+}
+
+// Function to read a scenario file into phases, returns -1 (after saying why) if it is invalid
+int load_scenario(const char *path, Impairment *impairment) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror("Opening scenario failed");
+        return -1;
+    }
+    char line[256];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        double at_s;
+        int consumed;
+        if (sscanf(line, " %lf %n", &at_s, &consumed) != 1) {
+            if (strspn(line, " \t\r\n") != strlen(line)) {
+                fprintf(stderr, "%s:%d: expected \"seconds profile [key=value ...]\"\n", path, line_number);
+                fclose(file);
+                return -1;
+            }
+            continue;
+        }
+        double previous_s = impairment->phase_count ? impairment->phases[impairment->phase_count - 1].at_s : 0;
+        if (at_s < previous_s || (impairment->phase_count == 0 && at_s != 0)) {
+            fprintf(stderr, "%s:%d: phases must start at 0 s and go forward in time\n", path, line_number);
+            fclose(file);
+            return -1;
+        }
+        if (strncmp(line + consumed, "end", 3) == 0) {
+            impairment->end_s = at_s;
+            break;
+        }
+        if (impairment->phase_count == IMPAIR_MAX_PHASES) {
+            fprintf(stderr, "%s:%d: more than %d phases\n", path, line_number, IMPAIR_MAX_PHASES);
+            fclose(file);
+            return -1;
+        }
+        Phase *phase = &impairment->phases[impairment->phase_count];
+        phase->at_s = at_s;
+        if (parse_profile(line + consumed, &phase->profile) < 0) {
+            fprintf(stderr, "%s:%d: unknown profile or setting\n", path, line_number);
+            fclose(file);
+            return -1;
+        }
+        impairment->phase_count++;
+    }
+    fclose(file);
+    if (impairment->phase_count == 0) {
+        fprintf(stderr, "%s: no phases\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to find the session of a player, opening one on its first datagram. -1 when full.
+int find_session(Impairment *impairment, const struct sockaddr_in *client) {
+    int free_slot = -1;
+    for (int i = 0; i < IMPAIR_MAX_SESSIONS; i++) {
+        Session *session = &impairment->sessions[i];
+        if (!session->in_use) {
+            if (free_slot < 0) {
+                free_slot = i;
+            }
+        } else if (session->client.sin_addr.s_addr == client->sin_addr.s_addr &&
+                   session->client.sin_port == client->sin_port) {
+            return i;
+        }
+    }
+    if (free_slot < 0) {
+        return -1;
+    }
+    Session *session = &impairment->sessions[free_slot];
+    memset(session, 0, sizeof(*session));
+    session->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct epoll_event event = {EPOLLIN, {.u32 = (uint32_t)free_slot}};
+    if (session->fd < 0 ||
+        connect(session->fd, (const struct sockaddr *)&impairment->server, sizeof(impairment->server)) < 0 ||
+        epoll_ctl(impairment->epoll_fd, EPOLL_CTL_ADD, session->fd, &event) < 0) {
+        perror("Session socket setup failed");
+        if (session->fd >= 0) {
+            close(session->fd);
+        }
+        return -1;
+    }
+    fcntl(session->fd, F_SETFL, fcntl(session->fd, F_GETFL, 0) | O_NONBLOCK);
+    session->in_use = 1;
+    session->client = *client;
+    printf("New player %s:%d\n", inet_ntoa(client->sin_addr), ntohs(client->sin_port));
+    fflush(stdout);
+    return free_slot;
+}
+
+// Function to run a datagram through the current profile: drop it, or queue it
+// (and maybe a copy) for release after its delay
+void impair_datagram(Impairment *impairment, int session, int direction, const uint8_t *frame, size_t length) {
+    Phase *phase = &impairment->phases[impairment->phase];
+    const Profile *profile = &phase->profile;
+    Stats *stats = &phase->stats;
+    if (length > IMPAIR_FRAME_MAX) {
+        return;
+    }
+
+    // Two-state loss: bursts of mean length `burst`, `loss` percent of datagrams overall
+    double loss = profile->loss / 100;
+    if (loss >= 1) {
+        impairment->losing[direction] = 1;
+    } else if (impairment->losing[direction]) {
+        impairment->losing[direction] = random_unit(impairment) < 1 - 1 / profile->burst;
+    } else {
+        impairment->losing[direction] = random_unit(impairment) < loss / (profile->burst * (1 - loss));
+    }
+    if (impairment->losing[direction]) {
+        stats->lost[direction]++;
+        return;
+    }
+
+    int copies = random_unit(impairment) * 100 < profile->dup ? 2 : 1;
+    for (int copy = 0; copy < copies; copy++) {
+        double delay_ms = profile->delay_ms + (2 * random_unit(impairment) - 1) * profile->jitter_ms;
+        if (random_unit(impairment) * 100 < profile->reorder) {
+            delay_ms += profile->hold_ms;
+            stats->reordered[direction]++;
+        }
+        if (delay_ms < 0) {
+            delay_ms = 0;
+        }
+        push_delayed(impairment, session, direction, frame, length, now_us() + (long long)(delay_ms * 1000));
+    }
+    stats->forwarded[direction]++;
+    stats->duplicated[direction] += copies - 1;
+}
+
+// Function to queue a datagram for release (sift up the heap)
+void push_delayed(Impairment *impairment, int session, int direction, const uint8_t *frame, size_t length, long long release_us) {
+    if (impairment->queued == IMPAIR_QUEUE) {
+        impairment->phases[impairment->phase].stats.overflow++;
+        return;
+    }
+    Delayed datagram = {release_us, impairment->order++, session, direction, (uint8_t)length, {0}};
+    memcpy(datagram.data, frame, length);
+    int k = impairment->queued++;
+    while (k > 0) {
+        Delayed *parent = &impairment->queue[(k - 1) / 2];
+        if (parent->release_us < release_us || (parent->release_us == release_us && parent->order < datagram.order)) {
+            break;
+        }
+        impairment->queue[k] = *parent;
+        k = (k - 1) / 2;
+    }
+    impairment->queue[k] = datagram;
+}
+
+// Function to take the earliest datagram off the queue (sift down the heap)
+void pop_delayed(Impairment *impairment, Delayed *out) {
+    *out = impairment->queue[0];
+    Delayed last = impairment->queue[--impairment->queued];
+    int k = 0;
+    while (1) {
+        int child = 2 * k + 1;
+        if (child >= impairment->queued) {
+            break;
+        }
+        Delayed *queue = impairment->queue;
+        if (child + 1 < impairment->queued &&
+            (queue[child + 1].release_us < queue[child].release_us ||
+             (queue[child + 1].release_us == queue[child].release_us && queue[child + 1].order < queue[child].order))) {
+            child++;
+        }
+        if (last.release_us < queue[child].release_us ||
+            (last.release_us == queue[child].release_us && last.order < queue[child].order)) {
+            break;
+        }
+        queue[k] = queue[child];
+        k = child;
+    }
+    impairment->queue[k] = last;
+}
+
+// Function to send a released datagram on to the server or the player
+void deliver(Impairment *impairment, const Delayed *datagram) {
+    Session *session = &impairment->sessions[datagram->session];
+    if (datagram->direction == TO_SERVER) {
+        send(session->fd, datagram->data, datagram->length, MSG_DONTWAIT);
+    } else {
+        sendto(impairment->listen_fd, datagram->data, datagram->length, MSG_DONTWAIT,
+               (const struct sockaddr *)&session->client, sizeof(session->client));
+        observe_delivery(impairment, session, datagram->data, datagram->length);
+    }
+}
+
+// Function to note a player's pattern and check its WIN claim, as they leave the player
+void observe_player(Impairment *impairment, Session *session, const uint8_t *frame, size_t length) {
+    uint16_t message;
+    uint8_t flags = length >= sizeof(ControlFrame) ? ((const ControlFrame *)frame)->flags : 0;
+    if (length < sizeof(message) || (flags & (FRAME_FLAG_ACK | FRAME_FLAG_REPAIR))) {
+        return;
+    }
+    memcpy(&message, frame, sizeof(message));
+    message = ntohs(message);
+    uint8_t message_code = (message & MASK_MESSAGE) >> BITS_MESSAGE;
+
+    if (message_code == MSG_REGISTER) {
+        // Same layout the server reads: short patterns in the word, long ones in a PatternPayload
+        session->pattern = message & MASK_SEQUENCE;
+        session->pattern_length = ((message >> 9) & 0b111) + 1;
+        PatternPayload full;
+        if ((flags & FRAME_FLAG_PATTERN) && length >= sizeof(ControlFrame) + sizeof(full)) {
+            memcpy(&full, frame + sizeof(ControlFrame), sizeof(full));
+            session->pattern = be64toh(full.pattern) & PATTERN_MASK(full.length);
+            session->pattern_length = full.length <= MAX_PATTERN_LENGTH ? full.length : 0;
+        }
+        return;
+    }
+    if (message_code != MSG_WIN || !session->in_game || session->claimed) {
+        return; // Retransmissions of the claim are counted once
+    }
+    Stats *stats = &impairment->phases[impairment->phase].stats;
+    long long now = now_us();
+    uint8_t index = message & MASK_SEQUENCE;
+    session->claimed = 1;
+    session->claim_us = now;
+
+    uint64_t window = 0;
+    for (int k = session->pattern_length - 1; k >= 0; k--) {
+        window = (window << 1) | session->tosses[(uint8_t)(index - k)];
+    }
+    session->claim_valid = session->pattern_length > 0 && window == session->pattern;
+    stats->false_claims += !session->claim_valid;
+
+    long long toss_us = session->toss_us[index];
+    if (toss_us > 0 && now - toss_us < STALL_MS * 1000LL) {
+        latency_record(&stats->claim, now - toss_us);
+    }
+}
+
+// Function to keep the tosses exactly as the server sent them, before any impairment
+void observe_server(Session *session, const uint8_t *frame, size_t length) {
+    uint16_t message;
+    uint8_t flags = length >= sizeof(ControlFrame) ? ((const ControlFrame *)frame)->flags : 0;
+    if (length < sizeof(message) || (flags & (FRAME_FLAG_ACK | FRAME_FLAG_REPAIR | FRAME_FLAG_TIMING))) {
+        return;
+    }
+    memcpy(&message, frame, sizeof(message));
+    message = ntohs(message);
+    if ((message & MASK_TRANSMITTER) && ((message & MASK_MESSAGE) >> BITS_MESSAGE) == MSG_TOSSING) {
+        session->tosses[message & MASK_SEQUENCE] = (message >> BIT_TOSS) & 0b1;
+    }
+}
+
+// Function to follow a game as the player sees it: tosses and results delivered to it
+void observe_delivery(Impairment *impairment, Session *session, const uint8_t *frame, size_t length) {
+    uint16_t message;
+    uint8_t flags = length >= sizeof(ControlFrame) ? ((const ControlFrame *)frame)->flags : 0;
+    if (length < sizeof(message) || (flags & (FRAME_FLAG_ACK | FRAME_FLAG_REPAIR | FRAME_FLAG_TIMING))) {
+        return; // Acknowledgements, repairs and RTT probes are not game progress
+    }
+    memcpy(&message, frame, sizeof(message));
+    message = ntohs(message);
+    if (!(message & MASK_TRANSMITTER)) {
+        return;
+    }
+    Stats *stats = &impairment->phases[impairment->phase].stats;
+    long long now = now_us();
+    uint8_t message_code = (message & MASK_MESSAGE) >> BITS_MESSAGE;
+    if (message_code == MSG_TOSSING) {
+        if (!session->in_game) {
+            session->in_game = 1;
+            session->claimed = 0;
+            session->game_start_us = now;
+        }
+        session->toss_us[message & MASK_SEQUENCE] = now;
+        session->last_us = now;
+        session->stalled = 0;
+    } else if ((message_code == MSG_WIN || message_code == MSG_LOSE) && session->in_game) {
+        // Results are retransmitted until acknowledged, the first delivery counts
+        if (message_code == MSG_WIN) {
+            stats->wins++;
+        } else {
+            stats->losses++;
+            stats->late_claims += session->claimed && session->claim_valid;
+        }
+        if (session->claimed) {
+            latency_record(&stats->result, now - session->claim_us);
+        }
+        latency_record(&stats->game, now - session->game_start_us);
+        session->in_game = 0;
+        session->last_us = now;
+        session->stalled = 0;
+    }
+}
+
+// Function to count games in which nothing has reached the player for STALL_MS
+void check_stalls(Impairment *impairment) {
+    long long now = now_us();
+    for (int i = 0; i < IMPAIR_MAX_SESSIONS; i++) {
+        Session *session = &impairment->sessions[i];
+        if (session->in_use && session->in_game && !session->stalled && now - session->last_us > STALL_MS * 1000LL) {
+            session->stalled = 1;
+            impairment->phases[impairment->phase].stats.stalls++;
+        }
+    }
+}
+
+// Function to print a profile on one line
+void print_profile(FILE *out, const Profile *profile) {
+    fprintf(out, "%s (loss %.1f%% burst %.1f, delay %.1f +/- %.1f ms, dup %.1f%%, reorder %.1f%% +%.0f ms)",
+            profile->name, profile->loss, profile->burst, profile->delay_ms, profile->jitter_ms,
+            profile->dup, profile->reorder, profile->hold_ms);
+}
+
+// Function to print the counters and latencies of a phase
+void print_stats(FILE *out, const Stats *stats) {
+    static const char *directions[] = {"to server", "to players"};
+    for (int d = 0; d < 2; d++) {
+        fprintf(out, "  Datagrams %s: %llu forwarded, %llu lost, %llu duplicated, %llu reordered\n",
+                directions[d], stats->forwarded[d], stats->lost[d], stats->duplicated[d], stats->reordered[d]);
+    }
+    if (stats->overflow) {
+        fprintf(out, "  Datagrams dropped on a full delay queue: %llu\n", stats->overflow);
+    }
+    fprintf(out, "  Results: %llu wins, %llu losses, %llu false claims, %llu late claims, %llu stalls, %llu unfinished\n",
+            stats->wins, stats->losses, stats->false_claims, stats->late_claims, stats->stalls, stats->unfinished);
+    const LatencyHistogram *histograms[] = {&stats->claim, &stats->result, &stats->game};
+    static const char *labels[] = {"Toss to claim", "Claim to result", "Game"};
+    for (int h = 0; h < 3; h++) {
+        if (histograms[h]->samples == 0) {
+            continue;
+        }
+        fprintf(out, "  %s: %u samples, mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", labels[h],
+                histograms[h]->samples, histograms[h]->total_us / 1000.0 / histograms[h]->samples,
+                latency_percentile(histograms[h], 0.5) / 1000.0, latency_percentile(histograms[h], 0.99) / 1000.0,
+                histograms[h]->max_us / 1000.0);
+    }
+}
+
+// Function to print the per-phase and overall report
+void print_report(Impairment *impairment) {
+    // Games still running belong to the phase they were cut off in
+    for (int i = 0; i < IMPAIR_MAX_SESSIONS; i++) {
+        if (impairment->sessions[i].in_use && impairment->sessions[i].in_game) {
+            impairment->phases[impairment->phase].stats.unfinished++;
+        }
+    }
+
+    Stats total;
+    memset(&total, 0, sizeof(total));
+    printf("\n--- Impairment report (%.1f s) ---\n", (now_us() - impairment->start_us) / 1e6);
+    for (int p = 0; p <= impairment->phase; p++) {
+        Phase *phase = &impairment->phases[p];
+        printf("Phase %d at %.1f s: ", p, phase->at_s);
+        print_profile(stdout, &phase->profile);
+        printf("\n");
+        print_stats(stdout, &phase->stats);
+        for (int d = 0; d < 2; d++) {
+            total.forwarded[d] += phase->stats.forwarded[d];
+            total.lost[d] += phase->stats.lost[d];
+            total.duplicated[d] += phase->stats.duplicated[d];
+            total.reordered[d] += phase->stats.reordered[d];
+        }
+        total.overflow += phase->stats.overflow;
+        total.wins += phase->stats.wins;
+        total.losses += phase->stats.losses;
+        total.false_claims += phase->stats.false_claims;
+        total.late_claims += phase->stats.late_claims;
+        total.stalls += phase->stats.stalls;
+        total.unfinished += phase->stats.unfinished;
+        latency_merge(&total.claim, &phase->stats.claim);
+        latency_merge(&total.result, &phase->stats.result);
+        latency_merge(&total.game, &phase->stats.game);
+    }
+    if (impairment->phase > 0) {
+        printf("Total:\n");
+        print_stats(stdout, &total);
+    }
+    printf("-------------------\n");
+    fflush(stdout);
+}
+
+// Function to stop the proxy from a signal; the report is printed on the way out
+void handle_stop(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
@@ -0,0 +1,36 @@
+#!/bin/bash
+#
+# Plays a scenario end to end: a server on port 9001, the impairment proxy in
+# front of it on 8080, and one client per pattern playing through the proxy
+# until the scenario ends. The proxy prints the report; server output goes to
+# impair-server.log.
+#
+# Usage: ./impair.sh scenario_file [pattern ...]   (default HHT THH HTT TTH)
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 scenario_file [pattern ...]"
+    exit 1
+fi
+scenario=$1
+shift
+patterns=${*:-HHT THH HTT TTH}
+
+make -s compile-server compile-client compile-impair || exit 1
+
+./server -p 9001 -F > impair-server.log 2>&1 &
+server_pid=$!
+sleep 0.5
+./impair -s 127.0.0.1:9001 -x "$scenario" -S "${SEED:-1}" &
+impair_pid=$!
+sleep 0.5
+
+client_pids=""
+for pattern in $patterns; do
+    # Answer "play again" forever, the scenario decides when to stop
+    (echo "$pattern"; yes) | ./client > /dev/null 2>&1 &
+    client_pids="$client_pids $!"
+done
+
+wait $impair_pid
+kill $client_pids $server_pid 2>/dev/null
+wait 2>/dev/null
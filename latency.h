@@ -0,0 +1,60 @@
+// latency.h
+//
+// Log2 latency histograms: constant size, O(1) to record, good enough to
+// read medians and tails (each percentile is the upper edge of its bucket).
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#define LATENCY_BUCKETS 24 // Bucket b holds [2^b, 2^(b+1)) microseconds, up to ~16 s
+
+typedef struct {
+    uint32_t counts[LATENCY_BUCKETS];
+    uint32_t samples;
+    uint32_t max_us;
+    uint64_t total_us;
+} LatencyHistogram;
+
+// Function to add one sample in microseconds
+static inline void latency_record(LatencyHistogram *histogram, uint32_t us) {
+    int bucket = us ? 31 - __builtin_clz(us) : 0;
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+    histogram->counts[bucket]++;
+    histogram->samples++;
+    histogram->total_us += us;
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+}
+
+// Function to add the samples of another histogram
+static inline void latency_merge(LatencyHistogram *into, const LatencyHistogram *from) {
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        into->counts[b] += from->counts[b];
+    }
+    into->samples += from->samples;
+    into->total_us += from->total_us;
+    if (from->max_us > into->max_us) {
+        into->max_us = from->max_us;
+    }
+}
+
+// Function to bound the given fraction of the samples (0.5 for the median), 0 when empty
+static inline uint32_t latency_percentile(const LatencyHistogram *histogram, double fraction) {
+    uint64_t rank = (uint64_t)(fraction * histogram->samples + 0.5);
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += histogram->counts[b];
+        if (seen >= rank && seen > 0) {
+            uint32_t edge = (2u << b) - 1;
+            return edge < histogram->max_us ? edge : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
+}
+
+#endif // LATENCY_H
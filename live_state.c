@@ -0,0 +1,125 @@
+// live_state.c
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "live_state.h"
+
+// Function to build the shared-memory object name of a server's live view
+static void live_region_name(char *name, int port) {
+    snprintf(name, LIVE_NAME_MAX, LIVE_NAME_FORMAT, port);
+}
+
+// Function to create (or recreate) the live view of the server listening on port
+LiveRegion *live_create(int port) {
+    char name[LIVE_NAME_MAX];
+    live_region_name(name, port);
+    shm_unlink(name); // Drop a view left behind by a previous run
+
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_EXCL, 0644); // Observers may only read
+    if (fd < 0) {
+        perror("Live state creation failed");
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(LiveRegion)) < 0) {
+        perror("Live state sizing failed");
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    LiveRegion *region = mmap(NULL, sizeof(LiveRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        perror("Live state mapping failed");
+        shm_unlink(name);
+        return NULL;
+    }
+
+    region->version = LIVE_VERSION;
+    region->server_pid = getpid();
+    region->port = port;
+    atomic_thread_fence(memory_order_release);
+    region->magic = LIVE_MAGIC;
+    return region;
+}
+
+// Function to publish a new state (single writer). Unchanged states are not
+// written, so observers polling an idle server keep reading the same copy;
+// published_us is stamped here and only moves when something changed.
+void live_publish(LiveRegion *region, LiveState *state) {
+    state->published_us = region->state.published_us;
+    if (region->publications && memcmp(&region->state, state, sizeof(*state)) == 0) {
+        return;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    state->published_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+    uint64_t sequence = atomic_load_explicit(&region->sequence, memory_order_relaxed);
+    atomic_store_explicit(&region->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&region->state, state, sizeof(*state));
+    region->publications++;
+    atomic_store_explicit(&region->sequence, sequence + 2, memory_order_release);
+}
+
+// Function to unmap and remove the live view
+void live_destroy(LiveRegion *region, int port) {
+    char name[LIVE_NAME_MAX];
+    live_region_name(name, port);
+    munmap(region, sizeof(LiveRegion));
+    shm_unlink(name);
+}
+
+// Function to map the live view of the server on port, read-only. NULL if there is none.
+const LiveRegion *live_open(int port) {
+    char name[LIVE_NAME_MAX];
+    live_region_name(name, port);
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(LiveRegion)) {
+        close(fd);
+        return NULL;
+    }
+    const LiveRegion *region = mmap(NULL, sizeof(LiveRegion), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    if (region->magic != LIVE_MAGIC || region->version != LIVE_VERSION) {
+        munmap((void *)region, sizeof(LiveRegion));
+        return NULL;
+    }
+    return region;
+}
+
+// Function to take a consistent copy of the state, and the sequence it was published under.
+// Returns 0 on success, -1 if the server kept the block busy (or died writing it).
+int live_read(const LiveRegion *region, LiveState *state, uint64_t *sequence) {
+    for (int attempt = 0; attempt < LIVE_READ_ATTEMPTS; attempt++) {
+        uint64_t before = atomic_load_explicit(&region->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue; // Being written
+        }
+        memcpy(state, &region->state, sizeof(*state));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&region->sequence, memory_order_relaxed) == before) {
+            *sequence = before;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Function to unmap the live view
+void live_close(const LiveRegion *region) {
+    munmap((void *)region, sizeof(LiveRegion));
+}
@@ -0,0 +1,96 @@
+// live_state.h
+//
+// Read-only live view of the server for local observers (dashboards,
+// pen-top). The server copies its registry, game instances and pattern
+// statistics into a shared-memory region every few milliseconds; any number
+// of observers map it read-only and take consistent copies without a
+// syscall and without the server ever waiting on them.
+//
+// The state block is guarded by a seqlock: the server makes the sequence
+// odd, writes the block, then makes it even again. An observer copies the
+// block between two reads of the sequence and retries if it was odd or
+// changed in between.
+
+#ifndef LIVE_STATE_H
+#define LIVE_STATE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define LIVE_NAME_FORMAT  "/pen-%d-live" // Server port
+#define LIVE_NAME_MAX     32
+#define LIVE_MAGIC        0x50454E4C // "PENL"
+#define LIVE_VERSION      1
+#define LIVE_MAX_GAMES    16
+#define LIVE_MAX_PLAYERS  15
+#define LIVE_MAX_PATTERNS 32
+#define LIVE_READ_ATTEMPTS 1000 // Copies tried before giving up on a writer that died mid-write
+
+// Player flags
+#define LIVE_PLAYER_PLAYING   0x01 // Queued or dealt into a game
+#define LIVE_PLAYER_WON       0x02 // Won its last game
+#define LIVE_PLAYER_RELIABLE  0x04
+#define LIVE_PLAYER_MULTICAST 0x08
+#define LIVE_PLAYER_SHM       0x10
+
+typedef struct {
+    uint8_t in_progress;
+    uint8_t players;
+    uint32_t toss_index;     // Tosses so far in the current game
+    uint64_t recent_tosses;  // Last (up to 64) tosses, newest in bit 0 (1 = tails)
+    uint64_t started_us;     // Wall clock
+} LiveGame;
+
+typedef struct {
+    uint8_t client_id;
+    uint8_t flags;
+    int8_t game;             // -1 while queued or idle
+    uint8_t pattern_length;
+    uint64_t pattern;        // Last toss in bit 0
+    uint32_t address;        // IPv4, network byte order
+    uint16_t port;           // Network byte order
+    uint32_t srtt_us;        // 0 until measured
+} LivePlayer;
+
+typedef struct {
+    uint64_t pattern;
+    uint8_t pattern_length;
+    uint32_t wins;
+    uint32_t total_games;
+    uint64_t total_flips;
+} LivePatternStats;
+
+typedef struct {
+    uint64_t published_us;   // Wall clock of the last change
+    uint32_t completed_games;
+    uint32_t game_count;
+    uint32_t player_count;
+    uint32_t pattern_count;
+    uint32_t queued_players; // Waiting for a table
+    uint64_t history_games;  // Games in the history store, 0 when disabled
+    LiveGame games[LIVE_MAX_GAMES];
+    LivePlayer players[LIVE_MAX_PLAYERS];
+    LivePatternStats patterns[LIVE_MAX_PATTERNS];
+} LiveState;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t server_pid;
+    uint32_t port;
+    _Alignas(64) _Atomic uint64_t sequence; // Odd while the server writes the state
+    uint64_t publications;
+    LiveState state;
+} LiveRegion;
+
+// Server side
+LiveRegion *live_create(int port);
+void live_publish(LiveRegion *region, LiveState *state);
+void live_destroy(LiveRegion *region, int port);
+
+// Observer side
+const LiveRegion *live_open(int port);
+int live_read(const LiveRegion *region, LiveState *state, uint64_t *sequence);
+void live_close(const LiveRegion *region);
+
+#endif // LIVE_STATE_H
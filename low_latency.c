@@ -0,0 +1,63 @@
+// low_latency.c
+
+#define _GNU_SOURCE // For sched_setaffinity and CPU_SET
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "low_latency.h"
+
+// Function to touch the stack the loop will use, so its pages are mapped (and locked) up front
+static void prefault_stack() {
+    volatile char stack[LOW_LATENCY_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+// Function to prepare the process for a spinning loop on cpu. Returns 0, or -1 if it cannot be pinned.
+int low_latency_setup(int cpu, const int fds[], int fd_count) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        fprintf(stderr, "Invalid CPU %d\n", cpu);
+        return -1;
+    }
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        perror("Pinning to the CPU failed");
+        return -1;
+    }
+
+    // Refusals below cost latency, not correctness
+    int locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    if (!locked) {
+        perror("Locking memory failed (raise RLIMIT_MEMLOCK), continuing unlocked");
+    }
+    prefault_stack();
+
+    int busy_poll_us = LOW_LATENCY_BUSY_POLL_US;
+    int busy_polled = 0;
+    for (int i = 0; i < fd_count; i++) {
+        if (fds[i] >= 0 && setsockopt(fds[i], SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) == 0) {
+            busy_polled++;
+        }
+    }
+    if (busy_polled < fd_count) {
+        perror("Socket busy polling refused (needs CAP_NET_ADMIN), spinning on receives only");
+    }
+
+    printf("Low-latency mode: pinned to CPU %d, memory %s, busy polling %s\n", cpu, locked ? "locked" : "not locked",
+           busy_polled == fd_count ? "on" : "off");
+    return 0;
+}
+
+// Function to read a monotonic clock in microseconds (does not wrap)
+uint64_t low_latency_clock_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
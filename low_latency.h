@@ -0,0 +1,30 @@
+// low_latency.h
+//
+// Opt-in low-latency mode for the server loop (server -L cpu). Instead of
+// sleeping in select() the loop spins on non-blocking receives and runs its
+// timed work (tosses, housekeeping) against deadlines, on a CPU of its own:
+//   - the process is pinned to one CPU so it keeps a warm cache and is not
+//     migrated between wakeups,
+//   - memory is locked and the stack prefaulted, so no page fault lands on
+//     the hot path (game state is already static),
+//   - the sockets ask the kernel to busy-poll the device queue (SO_BUSY_POLL)
+//     before reporting them empty.
+// Pinning is required; the other steps need privileges and only warn when
+// they are refused. The CPU is busy all the time: give the server a core
+// that nothing else runs on (isolcpus, or at least not CPU 0).
+
+#ifndef LOW_LATENCY_H
+#define LOW_LATENCY_H
+
+#include <stdint.h>
+
+#define LOW_LATENCY_BUSY_POLL_US 50     // SO_BUSY_POLL budget per empty receive
+#define LOW_LATENCY_STACK_PREFAULT (256 * 1024)
+
+// Function to prepare the process for a spinning loop on cpu. Returns 0, or -1 if it cannot be pinned.
+int low_latency_setup(int cpu, const int fds[], int fd_count);
+
+// Function to read a monotonic clock in microseconds (does not wrap)
+uint64_t low_latency_clock_us();
+
+#endif // LOW_LATENCY_H
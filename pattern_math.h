@@ -0,0 +1,74 @@
+// pattern_math.h
+//
+// Pattern arithmetic shared by the table generator and the runtime fallback
+// for patterns too long to tabulate. A pattern of length L holds its tosses
+// oldest first, the last toss in bit 0 (1 = tails).
+
+#ifndef PATTERN_MATH_H
+#define PATTERN_MATH_H
+
+#include <stdint.h>
+
+#include "protocol.h"
+
+// Function to compute the self-overlap (autocorrelation) vector of a pattern:
+// bit k - 1 is set when the first k tosses equal the last k tosses.
+static inline uint64_t pattern_overlap_vector(uint64_t pattern, int length) {
+    uint64_t vector = 0;
+    for (int k = 1; k <= length; k++) {
+        uint64_t prefix = (pattern >> (length - k)) & PATTERN_MASK(k);
+        uint64_t suffix = pattern & PATTERN_MASK(k);
+        if (prefix == suffix) {
+            vector |= 1ULL << (k - 1);
+        }
+    }
+    return vector;
+}
+
+// Function to compute the correlation vector of two patterns: bit k - 1 is
+// set when the last k tosses of a equal the first k tosses of b
+static inline uint64_t pattern_correlation_vector(uint64_t a, int length_a, uint64_t b, int length_b) {
+    uint64_t vector = 0;
+    int limit = length_a < length_b ? length_a : length_b;
+    for (int k = 1; k <= limit; k++) {
+        uint64_t prefix = (b >> (length_b - k)) & PATTERN_MASK(k);
+        uint64_t suffix = a & PATTERN_MASK(k);
+        if (prefix == suffix) {
+            vector |= 1ULL << (k - 1);
+        }
+    }
+    return vector;
+}
+
+// Function to check whether inner occurs anywhere inside outer
+static inline int pattern_contains(uint64_t outer, int length_outer, uint64_t inner, int length_inner) {
+    for (int offset = 0; offset + length_inner <= length_outer; offset++) {
+        if (((outer >> offset) & PATTERN_MASK(length_inner)) == inner) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to compute the expected number of fair tosses until a pattern
+// first appears (Conway): the sum of 2^k over its self-overlaps of length k.
+static inline double pattern_waiting_time(uint64_t overlap_vector, int length) {
+    double expected = 0;
+    for (int k = 1; k <= length; k++) {
+        if (overlap_vector & (1ULL << (k - 1))) {
+            expected += (double)(1ULL << (k - 1)) * 2;
+        }
+    }
+    return expected;
+}
+
+// Function to convert a pattern to its 'H'/'T' form (display holds length + 1 chars)
+static inline void pattern_format(uint64_t pattern, int length, char *display) {
+    for (int i = 0; i < length; i++) {
+        uint8_t bit = (pattern >> (length - 1 - i)) & 0b1;
+        display[i] = (bit == 0) ? 'H' : 'T';
+    }
+    display[length] = '\0';
+}
+
+#endif // PATTERN_MATH_H
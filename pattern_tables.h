@@ -0,0 +1,69 @@
+// pattern_tables.h
+//
+// Lookup tables generated at build time by gen_pattern_tables.c into
+// pattern_tables.c. Every pattern of up to PATTERN_TABLE_MAX_LENGTH tosses
+// (the ones a 16-bit REGISTER word can carry) has an entry; longer patterns
+// fall back to pattern_math.h.
+
+#ifndef PATTERN_TABLES_H
+#define PATTERN_TABLES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "protocol.h"
+#include "pattern_math.h"
+
+#define PATTERN_TABLE_MAX_LENGTH SHORT_PATTERN_LENGTH
+#define PATTERN_TABLE_SIZE ((2 << PATTERN_TABLE_MAX_LENGTH) - 2)
+
+// Entries of length L start at 2^L - 2 and are indexed by the pattern bits
+#define PATTERN_TABLE_INDEX(pattern, length) ((1u << (length)) - 2 + (uint32_t)(pattern))
+
+typedef struct {
+    char display[PATTERN_TABLE_MAX_LENGTH + 1]; // 'H'/'T' form
+    uint8_t overlap_vector;                      // Bit k - 1: first k tosses equal last k tosses
+    double expected_wait;                        // Expected fair tosses until the pattern appears
+} PatternEntry;
+
+extern const PatternEntry pattern_table[PATTERN_TABLE_SIZE];
+extern const uint64_t pattern_length_masks[MAX_PATTERN_LENGTH + 1];
+
+// Function to look up the table entry of a pattern, NULL if it is too long to tabulate
+static inline const PatternEntry *pattern_entry(uint64_t pattern, int length) {
+    if (length < 1 || length > PATTERN_TABLE_MAX_LENGTH) {
+        return NULL;
+    }
+    return &pattern_table[PATTERN_TABLE_INDEX(pattern & pattern_length_masks[length], length)];
+}
+
+// Function to get the 'H'/'T' form of a pattern; scratch (MAX_PATTERN_LENGTH + 1
+// chars) is only written for patterns longer than the table covers
+static inline const char *pattern_display(uint64_t pattern, int length, char *scratch) {
+    const PatternEntry *entry = pattern_entry(pattern, length);
+    if (entry) {
+        return entry->display;
+    }
+    pattern_format(pattern, length, scratch);
+    return scratch;
+}
+
+// Function to get the expected fair tosses until a pattern appears
+static inline double pattern_expected_wait(uint64_t pattern, int length) {
+    const PatternEntry *entry = pattern_entry(pattern, length);
+    if (entry) {
+        return entry->expected_wait;
+    }
+    return pattern_waiting_time(pattern_overlap_vector(pattern, length), length);
+}
+
+// Function to get the self-overlap vector of a pattern
+static inline uint64_t pattern_overlap(uint64_t pattern, int length) {
+    const PatternEntry *entry = pattern_entry(pattern, length);
+    if (entry) {
+        return entry->overlap_vector;
+    }
+    return pattern_overlap_vector(pattern, length);
+}
+
+#endif // PATTERN_TABLES_H
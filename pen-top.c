@@ -0,0 +1,156 @@
+// pen-top.c
+//
+// Live viewer for a running server. Maps the server's live view (see
+// live_state.h) read-only and redraws games, players and pattern statistics
+// from consistent copies of it. The server does no work for the viewer: no
+// admin requests, no syscalls on its side, and any number of viewers can
+// watch at once.
+//
+// Usage: ./pen-top [-p server_port] [-i interval_ms] [-n iterations]
+// -n 1 prints one snapshot without clearing the screen (for scripts).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <stdint.h> // For uint8_t and uint16_t
+
+#include "protocol.h"
+#include "live_state.h"
+
+#define PEN_TOP_INTERVAL_MS 500
+#define PEN_TOP_TOSSES 32 // Recent tosses shown per game
+
+void format_tosses(uint64_t bits, int count, char *text);
+uint64_t wall_us();
+void print_live_state(const LiveRegion *region, const LiveState *state, uint64_t sequence);
+
+int main(int argc, char *argv[]) {
+    int port = PORT;
+    int interval_ms = PEN_TOP_INTERVAL_MS;
+    int iterations = 0; // 0 = until interrupted
+    int opt;
+    while ((opt = getopt(argc, argv, "p:i:n:")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'i':
+                interval_ms = atoi(optarg);
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-p server_port] [-i interval_ms] [-n iterations]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (interval_ms <= 0) {
+        fprintf(stderr, "Interval must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const LiveRegion *region = live_open(port);
+    if (!region) {
+        fprintf(stderr, "No live state for a server on port %d (" LIVE_NAME_FORMAT ")\n", port, port);
+        exit(EXIT_FAILURE);
+    }
+
+    static LiveState state;
+    for (int iteration = 0; iterations == 0 || iteration < iterations; iteration++) {
+        if (iteration > 0) {
+            usleep(interval_ms * 1000);
+        }
+        uint64_t sequence;
+        if (live_read(region, &state, &sequence) < 0) {
+            printf("Live state busy (server stopped while publishing?)\n");
+            continue;
+        }
+        if (iterations != 1) {
+            printf("\033[H\033[2J"); // Clear the screen
+        }
+        print_live_state(region, &state, sequence);
+        fflush(stdout);
+    }
+
+    live_close(region);
+    return 0;
+}
+
+// Function to write the last count tosses of bits (last toss in bit 0) as 'H's and 'T's
+void format_tosses(uint64_t bits, int count, char *text) {
+    for (int i = 0; i < count; i++) {
+        text[i] = (bits >> (count - 1 - i)) & 1 ? 'T' : 'H';
+    }
+    text[count] = '\0';
+}
+
+// Function to get the wall clock in microseconds
+uint64_t wall_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Function to print one snapshot of the live state
+void print_live_state(const LiveRegion *region, const LiveState *state, uint64_t sequence) {
+    uint64_t now = wall_us();
+    // The view is only published on change, so an old stamp means idle unless the server is gone
+    int running = kill(region->server_pid, 0) == 0 || errno == EPERM;
+    double age_s = state->published_us && now > state->published_us ? (now - state->published_us) / 1e6 : 0;
+    printf("pen-top  port %u  pid %u (%s)  updates %llu  last change %.1fs ago\n", region->port,
+           region->server_pid, running ? "running" : "gone", (unsigned long long)(sequence / 2), age_s);
+    printf("Completed games %u  players %u  queued %u", state->completed_games, state->player_count,
+           state->queued_players);
+    if (state->history_games) {
+        printf("  history %llu", (unsigned long long)state->history_games);
+    }
+    printf("\n\n");
+
+    char text[65];
+    printf("GAME  PLAYERS  TOSSES  ELAPSED  RECENT\n");
+    for (uint32_t g = 0; g < state->game_count && g < LIVE_MAX_GAMES; g++) {
+        const LiveGame *game = &state->games[g];
+        if (!game->in_progress) {
+            printf("%4u  %7s\n", g, "-");
+            continue;
+        }
+        int shown = game->toss_index < PEN_TOP_TOSSES ? (int)game->toss_index : PEN_TOP_TOSSES;
+        format_tosses(game->recent_tosses, shown, text);
+        double elapsed_s = now > game->started_us ? (now - game->started_us) / 1e6 : 0;
+        printf("%4u  %7u  %6u  %6.1fs  %s\n", g, game->players, game->toss_index, elapsed_s, text);
+    }
+
+    printf("\nID  ADDRESS                GAME  PATTERN          RTT(us)  FLAGS\n");
+    for (uint32_t i = 0; i < state->player_count && i < LIVE_MAX_PLAYERS; i++) {
+        const LivePlayer *player = &state->players[i];
+        char address[32];
+        struct in_addr in = {player->address};
+        snprintf(address, sizeof(address), "%s:%u", inet_ntoa(in), ntohs(player->port));
+        format_tosses(player->pattern, player->pattern_length <= 64 ? player->pattern_length : 64, text);
+        char game[8];
+        if (player->game >= 0) {
+            snprintf(game, sizeof(game), "%d", player->game);
+        } else {
+            snprintf(game, sizeof(game), "%s", player->flags & LIVE_PLAYER_PLAYING ? "queue" : "-");
+        }
+        printf("%2u  %-21s  %5s  %-15s  %7u  %s%s%s%s%s\n", player->client_id, address, game, text,
+               player->srtt_us, player->flags & LIVE_PLAYER_PLAYING ? "playing " : "",
+               player->flags & LIVE_PLAYER_WON ? "won " : "", player->flags & LIVE_PLAYER_RELIABLE ? "reliable " : "",
+               player->flags & LIVE_PLAYER_MULTICAST ? "multicast " : "", player->flags & LIVE_PLAYER_SHM ? "shm" : "");
+    }
+
+    printf("\nPATTERN          GAMES   WINS   WIN%%  AVG FLIPS\n");
+    for (uint32_t j = 0; j < state->pattern_count && j < LIVE_MAX_PATTERNS; j++) {
+        const LivePatternStats *stats = &state->patterns[j];
+        format_tosses(stats->pattern, stats->pattern_length <= 64 ? stats->pattern_length : 64, text);
+        double win_rate = stats->total_games ? 100.0 * stats->wins / stats->total_games : 0;
+        double avg_flips = stats->total_games ? (double)stats->total_flips / stats->total_games : 0;
+        printf("%-15s  %5u  %5u  %5.1f  %9.2f\n", text, stats->total_games, stats->wins, win_rate, avg_flips);
+    }
+}
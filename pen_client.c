@@ -0,0 +1,705 @@
+// pen_client.c
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <time.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "pen_client.h"
+
+static long long pen_now_ms();
+static uint32_t pen_now_us();
+static void pen_send(PenClient *client, const void *frame, size_t length);
+static void pen_send_reliable(PenClient *client, PenSession *session, uint16_t message, uint8_t flags,
+                              const void *payload, size_t payload_len);
+static void pen_transmit_pending(PenClient *client, const ReliableSlot *slot);
+static int pen_service_retransmission(PenClient *client, PenSession *session);
+static int pen_accept_reliable(PenClient *client, PenSession *session, const ControlFrame *frame);
+static void pen_start_registration(PenClient *client);
+static void pen_handle_frame(PenClient *client, const uint8_t *buffer, size_t length, PenEvent events[], int *count,
+                             int max_events);
+static void pen_handle_registration(PenClient *client, const ControlFrame *frame, const uint8_t *payload,
+                                    size_t payload_len, PenEvent events[], int *count);
+static void pen_apply_tosses(PenClient *client, int index, PenEvent events[], int *count, int max_events);
+static void pen_request_repair(PenClient *client, PenSession *session);
+static void pen_answer_probe(PenClient *client, PenSession *session, const uint8_t *payload, size_t payload_len);
+static void pen_reset_game(PenSession *session);
+static void pen_event(PenEvent events[], int *count, int type, int index, const PenSession *session);
+
+// Function to set up a client for the server at host (IPv4 address) and port
+int pen_client_init(PenClient *client, const char *host, int port) {
+    memset(client, 0, sizeof(*client));
+    memset(client->by_client_id, -1, sizeof(client->by_client_id));
+    client->registering = -1;
+
+    client->server.sin_family = AF_INET;
+    client->server.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &client->server.sin_addr) <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    client->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (client->sock < 0) {
+        return -1;
+    }
+    int flags = fcntl(client->sock, F_GETFL, 0);
+    if (flags < 0 || fcntl(client->sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+        close(client->sock);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to add a player session. Sessions added before the next poll register in one batch.
+// Returns the session index, or -1 if every session is taken or the pattern is invalid.
+int pen_client_add(PenClient *client, uint64_t pattern, int pattern_length, int auto_claim) {
+    if (client->session_count >= PEN_CLIENT_MAX_SESSIONS || pattern_length < 1 ||
+        pattern_length > MAX_PATTERN_LENGTH) {
+        return -1;
+    }
+    int index = client->session_count++;
+    PenSession *session = &client->sessions[index];
+    memset(session, 0, sizeof(*session));
+    session->state = PEN_SESSION_QUEUED;
+    session->pattern = pattern & PATTERN_MASK(pattern_length);
+    session->pattern_length = pattern_length;
+    session->auto_claim = auto_claim;
+    return index;
+}
+
+// Function to close the client's socket
+void pen_client_close(PenClient *client) {
+    if (client->sock >= 0) {
+        close(client->sock);
+    }
+    client->sock = -1;
+}
+
+// Function to get the socket to wait on
+int pen_client_fd(const PenClient *client) {
+    return client->sock;
+}
+
+// Function to compute how long the caller may wait before pen_client_poll() has timers to service
+int pen_client_timeout_ms(const PenClient *client) {
+    long long now = pen_now_ms();
+    long long timeout = PEN_CLIENT_IDLE_MS;
+    for (int i = 0; i < client->session_count; i++) {
+        const PenSession *session = &client->sessions[i];
+        long long deadline = reliable_deadline_ms(&session->rel);
+        if (deadline >= 0 && deadline - now < timeout) {
+            timeout = deadline - now;
+        }
+        if (session->window.repair_pending && session->window.repair_deadline_ms - now < timeout) {
+            timeout = session->window.repair_deadline_ms - now;
+        }
+    }
+    return timeout > 0 ? (int)timeout : 0;
+}
+
+// Function to read every waiting datagram and service the timers, without blocking.
+// Fills events (room for max_events, at least PEN_CLIENT_EVENT_RESERVE) and returns their count.
+int pen_client_poll(PenClient *client, PenEvent events[], int max_events) {
+    int count = 0;
+    uint8_t buffer[PEN_CLIENT_FRAME_MAX];
+
+    pen_start_registration(client);
+
+    // Tosses and datagrams left over when events run short are taken by the next call, in order
+    for (int i = 0; i < client->session_count; i++) {
+        pen_apply_tosses(client, i, events, &count, max_events);
+    }
+    while (max_events - count >= PEN_CLIENT_EVENT_RESERVE) {
+        ssize_t length = recv(client->sock, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (length < 0) {
+            break;
+        }
+        client->frames_received++;
+        pen_handle_frame(client, buffer, length, events, &count, max_events);
+    }
+
+    for (int i = 0; i < client->session_count && max_events - count >= PEN_CLIENT_EVENT_RESERVE; i++) {
+        PenSession *session = &client->sessions[i];
+        if (pen_service_retransmission(client, session) < 0) {
+            // The server did not acknowledge the REGISTER, WIN or READY
+            if (session->state == PEN_SESSION_REGISTERING) {
+                for (int k = 1; k < client->batch_count; k++) {
+                    client->sessions[client->batch[k]].state = PEN_SESSION_FAILED;
+                    pen_event(events, &count, PEN_EVENT_FAILED, client->batch[k], &client->sessions[client->batch[k]]);
+                }
+                session->state = PEN_SESSION_FAILED;
+                client->registering = -1;
+                pen_start_registration(client);
+            } else if (session->state == PEN_SESSION_CLAIMED) {
+                session->state = PEN_SESSION_FINISHED;
+            } else {
+                session->state = PEN_SESSION_FAILED;
+            }
+            pen_event(events, &count, PEN_EVENT_FAILED, i, session);
+        }
+        // Ask once for the whole missing range in front of the buffered tosses
+        TossWindow *window = &session->window;
+        if (window->received && !(window->received & 1) &&
+            (!window->repair_pending || pen_now_ms() >= window->repair_deadline_ms)) {
+            pen_request_repair(client, session);
+        }
+    }
+    return count;
+}
+
+// Function to claim the win for the last toss applied to a session (sessions without auto_claim).
+// Returns 0, or -1 if the session is not playing.
+int pen_client_claim(PenClient *client, int index) {
+    if (index < 0 || index >= client->session_count || client->sessions[index].state != PEN_SESSION_PLAYING) {
+        return -1;
+    }
+    PenSession *session = &client->sessions[index];
+    uint16_t win_message = create_client_message(MSG_WIN, session->client_id, (session->window.next_toss - 1) & 0xFF,
+                                                 session->pattern_length);
+    TimingPayload timing = {0, htonl(pen_now_us() - session->received_us)};
+    pen_send_reliable(client, session, win_message, FRAME_FLAG_TIMING, &timing, sizeof(timing));
+    session->state = PEN_SESSION_CLAIMED;
+    return 0;
+}
+
+// Function to tell the server a finished session wants another game.
+// Returns 0, or -1 if the session has not finished its game.
+int pen_client_ready(PenClient *client, int index) {
+    if (index < 0 || index >= client->session_count || client->sessions[index].state != PEN_SESSION_FINISHED) {
+        return -1;
+    }
+    PenSession *session = &client->sessions[index];
+    pen_reset_game(session);
+    uint16_t ready_message = create_client_message(MSG_READY, session->client_id, 0, session->pattern_length);
+    pen_send_reliable(client, session, ready_message, 0, NULL, 0);
+    session->state = PEN_SESSION_WAITING;
+    return 0;
+}
+
+// Function to convert a pattern of 'H's and 'T's (any case) to bits
+int pen_parse_pattern(const char *text, uint64_t *pattern, int *pattern_length) {
+    int length = strlen(text);
+    if (length < 1 || length > MAX_PATTERN_LENGTH) {
+        return -1;
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < length; i++) {
+        char toss = toupper((unsigned char)text[i]);
+        if (toss != 'H' && toss != 'T') {
+            return -1;
+        }
+        bits = (bits << 1) | (toss == 'T');
+    }
+    *pattern = bits;
+    *pattern_length = length;
+    return 0;
+}
+
+// Function to create a client message according to the ALP protocol
+uint16_t create_client_message(uint8_t message_code, uint8_t client_id, uint8_t sequence, uint8_t pattern_length) {
+    uint16_t message = 0;
+    // Transmitter flag is 0 (client)
+    // Toss bit is 0
+    // Set message code in bits 13-12
+    message |= (message_code & 0b11) << BITS_MESSAGE;
+
+    if (message_code == MSG_REGISTER) {
+        // In registration, encode pattern length in bits 11-9
+        message |= ((pattern_length - 1) & 0b111) << 9;
+        // Bit 8 is unused and set to 0
+    } else {
+        // Set client ID in bits 11-8
+        message |= (client_id & 0b1111) << BITS_CLIENT_ID;
+    }
+
+    // Set sequence/pattern in bits 7-0
+    message |= (sequence & 0xFF);
+
+    return htons(message); // Convert to network byte order
+}
+
+// Function to parse a server message according to the ALP protocol
+void parse_server_message(uint16_t message, uint8_t *toss, uint8_t *message_code, uint8_t *client_id) {
+    // Convert message from network byte order to host byte order
+    message = ntohs(message);
+    // Extract bits according to the protocol; bits 7-0 (sequence) are read by the caller when needed
+    *toss = (message >> BIT_TOSS) & 0b1;
+    *message_code = (message >> BITS_MESSAGE) & 0b11;
+    *client_id = (message >> BITS_CLIENT_ID) & 0b1111;
+}
+
+// Function to buffer a toss at the given distance from the next expected one
+void store_toss(TossWindow *window, int offset, uint8_t toss) {
+    if (offset < 0 || offset >= TOSS_WINDOW) {
+        return; // Already applied, or too far ahead to buffer
+    }
+    window->received |= 1ULL << offset;
+    if (toss) {
+        window->values |= 1ULL << offset;
+    } else {
+        window->values &= ~(1ULL << offset);
+    }
+}
+
+// Function to buffer a toss received from the stream, identified by the low byte of its index
+void accept_toss(TossWindow *window, uint8_t sequence, uint8_t toss) {
+    int offset = (int8_t)(sequence - (uint8_t)window->next_toss);
+    store_toss(window, offset, toss);
+}
+
+// Function to buffer the tosses carried by a repair response
+void accept_repair(TossWindow *window, const uint8_t *payload, size_t payload_len) {
+    RepairPayload repair;
+    if (payload_len < REPAIR_REQUEST_SIZE) {
+        return;
+    }
+    memset(&repair, 0, sizeof(repair));
+    memcpy(&repair, payload, payload_len < sizeof(repair) ? payload_len : sizeof(repair));
+    if (payload_len < REPAIR_REQUEST_SIZE + (repair.count + 7) / 8 || repair.count > REPAIR_MAX_TOSSES) {
+        return;
+    }
+
+    int offset = (int16_t)(ntohs(repair.first_toss) - (uint16_t)window->next_toss);
+    for (int i = 0; i < repair.count; i++) {
+        store_toss(window, offset + i, (repair.bits[i / 8] >> (7 - i % 8)) & 0b1);
+    }
+    window->repair_pending = 0;
+}
+
+// Function to take the next toss in order, returns 0 while it has not arrived
+int pop_toss(TossWindow *window, uint8_t *toss) {
+    if (!(window->received & 1)) {
+        return 0;
+    }
+    *toss = window->values & 1;
+    window->received >>= 1;
+    window->values >>= 1;
+    window->next_toss++;
+    return 1;
+}
+
+// Function to number a control message and put it in a free window slot. Returns the slot to
+// transmit; if the window is full that is rel->overflow, sent once without a sequence number.
+ReliableSlot *reliable_queue(ReliableState *rel, uint16_t message, uint8_t flags, const void *payload,
+                             size_t payload_len, long long now) {
+    uint8_t seq = rel->tx_seq + 1;
+    ReliableSlot *slot = NULL;
+    int fits = 1;
+    for (int i = 0; i < RELIABLE_WINDOW; i++) {
+        if (!rel->pending[i].active) {
+            slot = slot ? slot : &rel->pending[i];
+        } else if (!reliable_seq_fits(rel->pending[i].frame.seq, seq)) {
+            fits = 0;
+        }
+    }
+    if (payload_len > sizeof(rel->overflow.payload)) {
+        payload_len = sizeof(rel->overflow.payload);
+    }
+    if (!slot || !fits) {
+        slot = &rel->overflow;
+        slot->frame = (ControlFrame){message, flags, 0};
+    } else {
+        slot->frame = (ControlFrame){message, FRAME_FLAG_RELIABLE | flags, seq};
+        slot->active = 1;
+        slot->attempts = 1;
+        slot->backoff_ms = RETRANSMIT_INITIAL_MS;
+        slot->deadline_ms = now + slot->backoff_ms;
+        rel->tx_seq = seq;
+    }
+    if (payload_len > 0) {
+        memcpy(slot->payload, payload, payload_len);
+    }
+    slot->payload_len = payload_len;
+    return slot;
+}
+
+// Function to schedule the next attempt of a slot whose timer expired.
+// Returns 0 if it should be retransmitted now, -1 if it was dropped after too many attempts.
+int reliable_backoff(ReliableSlot *slot, long long now) {
+    if (slot->attempts >= RETRANSMIT_MAX_ATTEMPTS) {
+        slot->active = 0;
+        return -1;
+    }
+    slot->attempts++;
+    slot->backoff_ms *= 2;
+    if (slot->backoff_ms > RETRANSMIT_MAX_MS) {
+        slot->backoff_ms = RETRANSMIT_MAX_MS;
+    }
+    slot->deadline_ms = now + slot->backoff_ms;
+    return 0;
+}
+
+// Function to release the slot acknowledged by an ACK carrying seq
+void reliable_ack(ReliableState *rel, uint8_t seq) {
+    for (int i = 0; i < RELIABLE_WINDOW; i++) {
+        if (rel->pending[i].active && rel->pending[i].frame.seq == seq) {
+            rel->pending[i].active = 0;
+        }
+    }
+}
+
+// Function to release every slot holding a message of the given code, answered by the server
+// even if its ACK was lost (the REGISTER reply, the verdict on a WIN)
+void reliable_settle(ReliableState *rel, uint8_t message_code) {
+    for (int i = 0; i < RELIABLE_WINDOW; i++) {
+        if (rel->pending[i].active && ((ntohs(rel->pending[i].frame.message) >> BITS_MESSAGE) & 0b11) == message_code) {
+            rel->pending[i].active = 0;
+        }
+    }
+}
+
+// Function to find the earliest retransmission deadline, -1 if nothing is in flight
+long long reliable_deadline_ms(const ReliableState *rel) {
+    long long deadline = -1;
+    for (int i = 0; i < RELIABLE_WINDOW; i++) {
+        if (rel->pending[i].active && (deadline < 0 || rel->pending[i].deadline_ms < deadline)) {
+            deadline = rel->pending[i].deadline_ms;
+        }
+    }
+    return deadline;
+}
+
+// Function to send one REGISTER for every queued session, unless a registration is in flight
+static void pen_start_registration(PenClient *client) {
+    if (client->registering >= 0) {
+        return;
+    }
+    client->batch_count = 0;
+    for (int i = 0; i < client->session_count && client->batch_count < BATCH_MAX_PATTERNS; i++) {
+        if (client->sessions[i].state == PEN_SESSION_QUEUED) {
+            client->batch[client->batch_count++] = i;
+        }
+    }
+    if (client->batch_count == 0) {
+        return;
+    }
+    int lead = client->batch[0];
+    PenSession *session = &client->sessions[lead];
+
+    // The server takes a REGISTER whose sequence matches the last frame of a player at the
+    // same address for a retransmission, so skip the sequences our sessions last used
+    uint8_t seq;
+    int taken;
+    do {
+        seq = ++client->register_seq;
+        taken = 0;
+        for (int k = 0; k < client->session_count; k++) {
+            taken |= client->sessions[k].client_id && client->sessions[k].rel.tx_seq == seq;
+        }
+    } while (taken);
+    session->rel.tx_seq = seq - 1;
+
+    // The ALP word holds patterns of up to 8 tosses, the payload always carries the full one.
+    // The other queued sessions ride along in a BatchPayload.
+    uint8_t payload[sizeof(PatternPayload) + sizeof(BatchPayload)];
+    PatternPayload full = {session->pattern_length, htobe64(session->pattern)};
+    memcpy(payload, &full, sizeof(full));
+    size_t payload_len = sizeof(full);
+    uint8_t flags = FRAME_FLAG_PATTERN | FRAME_FLAG_TIMING;
+    if (client->batch_count > 1) {
+        BatchPayload batch;
+        batch.count = client->batch_count - 1;
+        for (int k = 1; k < client->batch_count; k++) {
+            PenSession *member = &client->sessions[client->batch[k]];
+            batch.patterns[k - 1] = (PatternPayload){member->pattern_length, htobe64(member->pattern)};
+        }
+        memcpy(payload + payload_len, &batch, BATCH_PAYLOAD_SIZE(batch.count));
+        payload_len += BATCH_PAYLOAD_SIZE(batch.count);
+        flags |= FRAME_FLAG_BATCH;
+    }
+    int short_length = session->pattern_length < SHORT_PATTERN_LENGTH ? session->pattern_length : SHORT_PATTERN_LENGTH;
+    uint16_t message = create_client_message(MSG_REGISTER, 0, session->pattern & 0xFF, short_length);
+    pen_send_reliable(client, session, message, flags, payload, payload_len);
+    // The server files the REGISTER's sequence as the last frame of every player in it
+    for (int k = 0; k < client->batch_count; k++) {
+        client->sessions[client->batch[k]].state = PEN_SESSION_REGISTERING;
+        client->sessions[client->batch[k]].rel.tx_seq = seq;
+    }
+    client->registering = lead;
+}
+
+// Function to take the reply to the REGISTER in flight: one ID for its first session, or
+// (batch reply) the IDs of all its sessions
+static void pen_handle_registration(PenClient *client, const ControlFrame *frame, const uint8_t *payload,
+                                    size_t payload_len, PenEvent events[], int *count) {
+    uint8_t toss, message_code, client_id;
+    parse_server_message(frame->message, &toss, &message_code, &client_id);
+
+    BatchReplyPayload reply = {1, {client_id}};
+    if ((frame->flags & FRAME_FLAG_BATCH) && payload_len >= 1) {
+        memcpy(&reply, payload, payload_len < sizeof(reply) ? payload_len : sizeof(reply));
+        if (reply.count < 1 || reply.count > client->batch_count || payload_len < 1 + (size_t)reply.count ||
+            reply.client_ids[0] != client_id) {
+            return;
+        }
+    }
+    reliable_settle(&client->sessions[client->registering].rel, MSG_REGISTER);
+    client->registering = -1;
+
+    for (int k = 0; k < client->batch_count; k++) {
+        int index = client->batch[k];
+        PenSession *session = &client->sessions[index];
+        uint8_t id = k < reply.count ? reply.client_ids[k] & 0x0F : 0;
+        if (k >= reply.count) {
+            session->state = PEN_SESSION_QUEUED; // Server without batches: next REGISTER
+        } else if (id == 0 || client->by_client_id[id] >= 0) {
+            session->state = PEN_SESSION_FAILED; // Server full
+            pen_event(events, count, PEN_EVENT_FAILED, index, session);
+        } else {
+            session->client_id = id;
+            session->state = PEN_SESSION_WAITING;
+            session->received_us = pen_now_us();
+            client->by_client_id[id] = index;
+            pen_event(events, count, PEN_EVENT_REGISTERED, index, session);
+        }
+    }
+    // Multicast and shared-memory offers are declined
+    pen_accept_reliable(client, &client->sessions[client->by_client_id[client_id]], frame);
+    pen_start_registration(client);
+}
+
+// Function to handle one datagram from the server
+static void pen_handle_frame(PenClient *client, const uint8_t *buffer, size_t length, PenEvent events[], int *count,
+                             int max_events) {
+    if (length < sizeof(uint16_t)) {
+        return;
+    }
+    // Plain 2-byte messages are best-effort and carry no flags
+    ControlFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    memcpy(&frame, buffer, length < sizeof(frame) ? length : sizeof(frame));
+    const uint8_t *payload = buffer + sizeof(ControlFrame);
+    size_t payload_len = length > sizeof(ControlFrame) ? length - sizeof(ControlFrame) : 0;
+
+    uint8_t toss, message_code, client_id;
+    parse_server_message(frame.message, &toss, &message_code, &client_id);
+
+    if (message_code == MSG_REGISTER && !(frame.flags & FRAME_FLAG_ACK) && client_id != 0 &&
+        client->by_client_id[client_id] < 0) {
+        // A new ID answers the registration in flight
+        if (client->registering >= 0) {
+            pen_handle_registration(client, &frame, payload, payload_len, events, count);
+        }
+        return;
+    }
+
+    int index = client->by_client_id[client_id];
+    if (client_id == 0 || index < 0) {
+        return; // Not one of ours (group traffic carries ID 0)
+    }
+    PenSession *session = &client->sessions[index];
+    session->received_us = pen_now_us();
+
+    if (frame.flags & FRAME_FLAG_ACK) {
+        // Server acknowledges our pending WIN or READY
+        reliable_ack(&session->rel, frame.seq);
+        return;
+    }
+    if ((frame.flags & FRAME_FLAG_TIMING) && message_code == MSG_ACK) {
+        pen_answer_probe(client, session, payload, payload_len);
+        return;
+    }
+    if (frame.flags & FRAME_FLAG_REPAIR) {
+        accept_repair(&session->window, payload, payload_len);
+        pen_apply_tosses(client, index, events, count, max_events);
+        return;
+    }
+    if ((frame.flags & FRAME_FLAG_RELIABLE) && !pen_accept_reliable(client, session, &frame)) {
+        return; // Duplicate of a control message we already handled
+    }
+    if (message_code == MSG_REGISTER) {
+        return; // Retransmitted registration reply, acknowledged above
+    }
+    if (message_code == MSG_LOSE || message_code == MSG_WIN) {
+        if (session->state == PEN_SESSION_FINISHED) {
+            return;
+        }
+        if (message_code == MSG_WIN) {
+            session->wins++;
+        } else {
+            session->losses++;
+        }
+        session->state = PEN_SESSION_FINISHED;
+        reliable_settle(&session->rel, MSG_WIN); // A verdict settles the claim even if its ACK was lost
+        session->window.repair_pending = 0;
+        session->window.received = 0;
+        pen_event(events, count, message_code == MSG_WIN ? PEN_EVENT_WON : PEN_EVENT_LOST, index, session);
+        return;
+    }
+    // Toss: bits 7-0 carry its index, buffer it until every earlier toss is in.
+    // A batch toss counts for every session it names.
+    uint16_t players = 1 << client_id;
+    if ((frame.flags & FRAME_FLAG_BATCH) && payload_len >= sizeof(BatchTossPayload)) {
+        BatchTossPayload shared;
+        memcpy(&shared, payload, sizeof(shared));
+        players = ntohs(shared.players);
+        client->shared_tosses++;
+    }
+    for (int id = 1; id < 16; id++) {
+        int member = client->by_client_id[id];
+        if (!(players & (1 << id)) || member < 0) {
+            continue;
+        }
+        PenSession *player = &client->sessions[member];
+        if (player->state != PEN_SESSION_WAITING && player->state != PEN_SESSION_PLAYING) {
+            continue;
+        }
+        player->state = PEN_SESSION_PLAYING;
+        player->received_us = session->received_us;
+        accept_toss(&player->window, ntohs(frame.message) & MASK_SEQUENCE, toss);
+        pen_apply_tosses(client, member, events, count, max_events);
+    }
+}
+
+// Function to apply a session's tosses in order, claiming when its pattern completes
+static void pen_apply_tosses(PenClient *client, int index, PenEvent events[], int *count, int max_events) {
+    PenSession *session = &client->sessions[index];
+    uint8_t toss;
+    // Room for the toss and a completion; what does not fit waits in the window
+    while (session->state == PEN_SESSION_PLAYING && max_events - *count >= 2 && pop_toss(&session->window, &toss)) {
+        session->flips++;
+        session->toss_buffer = ((session->toss_buffer << 1) | toss) & PATTERN_MASK(session->pattern_length);
+        PenEvent *event = &events[*count];
+        pen_event(events, count, PEN_EVENT_TOSS, index, session);
+        event->toss = toss;
+
+        if (session->flips >= session->pattern_length && session->toss_buffer == session->pattern) {
+            if (session->auto_claim) {
+                pen_client_claim(client, index);
+            }
+            pen_event(events, count, PEN_EVENT_COMPLETED, index, session);
+            if (!session->auto_claim) {
+                break; // The caller decides; later tosses wait in the window
+            }
+        }
+    }
+}
+
+// Function to request the missing tosses in front of the first buffered one
+static void pen_request_repair(PenClient *client, PenSession *session) {
+    struct __attribute__((packed)) {
+        ControlFrame header;
+        uint16_t first_toss;
+        uint8_t count;
+    } request;
+
+    request.header.message = create_client_message(MSG_ACK, session->client_id, 0, 0);
+    request.header.flags = FRAME_FLAG_REPAIR;
+    request.header.seq = 0;
+    request.first_toss = htons(session->window.next_toss & 0xFFFF);
+    request.count = __builtin_ctzll(session->window.received);
+
+    pen_send(client, &request, sizeof(request));
+    session->window.repair_pending = 1;
+    session->window.repair_deadline_ms = pen_now_ms() + REPAIR_TIMEOUT_MS;
+}
+
+// Function to echo an RTT probe with the time it waited in the client
+static void pen_answer_probe(PenClient *client, PenSession *session, const uint8_t *payload, size_t payload_len) {
+    TimingPayload timing;
+    if (payload_len < sizeof(timing)) {
+        return;
+    }
+    memcpy(&timing, payload, sizeof(timing));
+    timing.hold_us = htonl(pen_now_us() - session->received_us);
+    uint8_t echo[sizeof(ControlFrame) + sizeof(TimingPayload)];
+    ControlFrame frame = {create_client_message(MSG_ACK, session->client_id, 0, 0), FRAME_FLAG_TIMING, 0};
+    memcpy(echo, &frame, sizeof(frame));
+    memcpy(echo + sizeof(frame), &timing, sizeof(timing));
+    pen_send(client, echo, sizeof(echo));
+}
+
+// Function to clear a session's toss stream for the next game
+static void pen_reset_game(PenSession *session) {
+    memset(&session->window, 0, sizeof(session->window));
+    session->toss_buffer = 0;
+    session->flips = 0;
+}
+
+// Function to append an event describing a session
+static void pen_event(PenEvent events[], int *count, int type, int index, const PenSession *session) {
+    PenEvent *event = &events[(*count)++];
+    event->type = type;
+    event->session = index;
+    event->client_id = session->client_id;
+    event->toss = 0;
+    event->toss_index = session->window.next_toss - 1;
+    event->flips = session->flips;
+}
+
+// Function to send a datagram; a full socket buffer drops it like the network would
+static void pen_send(PenClient *client, const void *frame, size_t length) {
+    if (sendto(client->sock, frame, length, 0, (const struct sockaddr *)&client->server, sizeof(client->server)) >= 0) {
+        client->frames_sent++;
+    }
+}
+
+// Function to send a control message that is retransmitted until acknowledged
+static void pen_send_reliable(PenClient *client, PenSession *session, uint16_t message, uint8_t flags,
+                              const void *payload, size_t payload_len) {
+    ReliableSlot *slot = reliable_queue(&session->rel, message, flags, payload, payload_len, pen_now_ms());
+    pen_transmit_pending(client, slot);
+}
+
+// Function to (re)send a reliable control message with its payload
+static void pen_transmit_pending(PenClient *client, const ReliableSlot *slot) {
+    uint8_t buffer[sizeof(ControlFrame) + sizeof(slot->payload)];
+    memcpy(buffer, &slot->frame, sizeof(slot->frame));
+    memcpy(buffer + sizeof(slot->frame), slot->payload, slot->payload_len);
+    pen_send(client, buffer, sizeof(slot->frame) + slot->payload_len);
+}
+
+// Function to retransmit the control messages whose timer expired.
+// Returns -1 when a message was dropped after too many attempts, 0 otherwise.
+static int pen_service_retransmission(PenClient *client, PenSession *session) {
+    int result = 0;
+    long long now = pen_now_ms();
+    for (int i = 0; i < RELIABLE_WINDOW; i++) {
+        ReliableSlot *slot = &session->rel.pending[i];
+        if (!slot->active || now < slot->deadline_ms) {
+            continue;
+        }
+        if (reliable_backoff(slot, now) < 0) {
+            result = -1;
+            continue;
+        }
+        pen_transmit_pending(client, slot);
+    }
+    return result;
+}
+
+// Function to acknowledge a reliable frame from the server.
+// Returns 1 if the frame is new, 0 if it is a retransmission we already handled.
+static int pen_accept_reliable(PenClient *client, PenSession *session, const ControlFrame *frame) {
+    if (!(frame->flags & FRAME_FLAG_RELIABLE)) {
+        return 1;
+    }
+    // Always acknowledge, our previous ACK may have been lost
+    ControlFrame ack = {create_client_message(MSG_ACK, session->client_id, 0, 0), FRAME_FLAG_ACK, frame->seq};
+    pen_send(client, &ack, sizeof(ack));
+
+    // Up to RELIABLE_WINDOW frames are in flight and may arrive in any order; a retransmission
+    // may be a verdict from an earlier game whose ACK was lost
+    return reliable_seq_accept(&session->rel.rx_seq, &session->rel.rx_seen, frame->seq);
+}
+
+// Function to read a monotonic clock in milliseconds
+static long long pen_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Function to get the time in microseconds for latency stamps (wraps every ~71 minutes)
+static uint32_t pen_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
@@ -0,0 +1,162 @@
+// pen_client.h
+//
+// Embeddable, non-blocking client for the ALP game protocol, for bots and
+// test harnesses that want to play without driving interactive clients.
+//
+// A PenClient owns one UDP socket to a server and up to
+// PEN_CLIENT_MAX_SESSIONS player sessions over it (4-bit client IDs). Each
+// session registers a pattern, follows the toss stream of its game in index
+// order (repairing gaps), claims the win when its pattern completes and can
+// be made ready for the next game. Nothing is allocated: the PenClient holds
+// every session.
+//
+// The caller owns the loop: wait until pen_client_fd() is readable, for at
+// most pen_client_timeout_ms(), then call pen_client_poll(). It reads every
+// waiting datagram, services retransmissions and repairs and returns what
+// happened as events. No call blocks, prints or exits.
+//
+// Sessions waiting to register go out together in one batched REGISTER
+// (FRAME_FLAG_BATCH, see protocol.h) and get their IDs back in one reply;
+// a server without batches registers the first one and the others follow
+// in the next REGISTERs. Batched sessions in the same game share one toss
+// frame. Only the unicast transport is used; multicast and shared-memory
+// offers are declined (client.c takes them).
+
+#ifndef PEN_CLIENT_H
+#define PEN_CLIENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+#include "protocol.h"
+
+#define PEN_CLIENT_MAX_SESSIONS 15 // Client IDs 1 to 15
+#define PEN_CLIENT_FRAME_MAX    64
+#define PEN_CLIENT_IDLE_MS      1000 // Longest wait pen_client_timeout_ms() asks for
+#define PEN_CLIENT_EVENT_RESERVE (BATCH_MAX_PATTERNS + 1) // Smallest event array pen_client_poll() takes
+
+// Reliable control message waiting for its ACK
+typedef struct {
+    int active;
+    ControlFrame frame;
+    uint8_t payload[sizeof(PatternPayload) + sizeof(BatchPayload)]; // Sent after frame
+    size_t payload_len;
+    int attempts;
+    int backoff_ms;
+    long long deadline_ms;
+} ReliableSlot;
+
+// Reliable delivery state for control messages, windowed like the server's
+// (RELIABLE_WINDOW in protocol.h): a READY can go out while a WIN is unacknowledged
+typedef struct {
+    uint8_t tx_seq;       // Sequence number of our last reliable frame
+    uint8_t rx_seq;       // Newest sequence number received from the server
+    uint8_t rx_seen;      // Bit i set: rx_seq - i was received, 0 until the first frame
+    ReliableSlot pending[RELIABLE_WINDOW];
+    ReliableSlot overflow; // Frame that found the window full: sent once, not retransmitted
+} ReliableState;
+
+// Reorder window for the toss stream. Tosses are applied strictly in index
+// order; early arrivals wait here while the gap before them is repaired.
+typedef struct {
+    int next_toss;        // Index of the next toss to apply
+    uint64_t received;    // Bit i set: toss next_toss + i is buffered
+    uint64_t values;      // Bit i: value of buffered toss next_toss + i
+    int repair_pending;   // A repair request is outstanding
+    long long repair_deadline_ms;
+} TossWindow;
+
+#define TOSS_WINDOW 64
+
+// Session states
+#define PEN_SESSION_FREE        0
+#define PEN_SESSION_QUEUED      1 // Waiting for its turn to register
+#define PEN_SESSION_REGISTERING 2
+#define PEN_SESSION_WAITING     3 // Registered or ready, no toss yet
+#define PEN_SESSION_PLAYING     4
+#define PEN_SESSION_CLAIMED     5 // WIN sent, waiting for the verdict
+#define PEN_SESSION_FINISHED    6 // Won or lost, pen_client_ready() starts the next game
+#define PEN_SESSION_FAILED      7 // The server stopped answering
+
+typedef struct {
+    int state;
+    uint8_t client_id;    // 0 until registered
+    uint64_t pattern;     // Last toss in bit 0 (1 = tails)
+    int pattern_length;
+    int auto_claim;       // Claim as soon as the pattern completes
+    ReliableState rel;
+    TossWindow window;
+    uint64_t toss_buffer; // Rolling window of the last pattern_length tosses
+    int flips;            // Tosses applied in the current game
+    uint32_t received_us; // When the last frame for the session arrived
+    int wins;
+    int losses;
+} PenSession;
+
+// Event types
+#define PEN_EVENT_REGISTERED 1 // client_id is set
+#define PEN_EVENT_TOSS       2 // toss, toss_index
+#define PEN_EVENT_COMPLETED  3 // The pattern completed on toss_index (claimed already with auto_claim)
+#define PEN_EVENT_WON        4 // flips
+#define PEN_EVENT_LOST       5 // flips
+#define PEN_EVENT_FAILED     6 // Registration, a claim or READY went unacknowledged, or the server is full
+
+typedef struct {
+    int type;
+    int session;          // Index returned by pen_client_add()
+    uint8_t client_id;
+    uint8_t toss;         // 0 = heads, 1 = tails
+    int toss_index;       // 0-based index of the toss in the game
+    int flips;
+} PenEvent;
+
+typedef struct {
+    int sock;             // Non-blocking UDP socket
+    struct sockaddr_in server;
+    PenSession sessions[PEN_CLIENT_MAX_SESSIONS];
+    int session_count;
+    int8_t by_client_id[16]; // Session index by client ID, -1 if none
+    int registering;      // Session whose REGISTER is in flight (the first of its batch), -1 if none
+    int8_t batch[BATCH_MAX_PATTERNS]; // Sessions of that REGISTER, in request order
+    int batch_count;
+    uint8_t register_seq; // REGISTERs from one address need distinct sequence numbers
+    unsigned long long frames_sent;
+    unsigned long long frames_received;
+    unsigned long long shared_tosses; // Toss frames that counted for several sessions
+} PenClient;
+
+// Setup
+int pen_client_init(PenClient *client, const char *host, int port);
+int pen_client_add(PenClient *client, uint64_t pattern, int pattern_length, int auto_claim);
+void pen_client_close(PenClient *client);
+
+// Event loop
+int pen_client_fd(const PenClient *client);
+int pen_client_timeout_ms(const PenClient *client);
+int pen_client_poll(PenClient *client, PenEvent events[], int max_events);
+
+// Game actions
+int pen_client_claim(PenClient *client, int session);
+int pen_client_ready(PenClient *client, int session);
+
+// Pattern text ('H'/'T') to bits, last toss in bit 0. Returns 0, or -1 if the text is invalid.
+int pen_parse_pattern(const char *text, uint64_t *pattern, int *pattern_length);
+
+// ALP codec and toss stream, shared with client.c
+uint16_t create_client_message(uint8_t message_code, uint8_t client_id, uint8_t sequence, uint8_t pattern_length);
+void parse_server_message(uint16_t message, uint8_t *toss, uint8_t *message_code, uint8_t *client_id);
+void store_toss(TossWindow *window, int offset, uint8_t toss);
+void accept_toss(TossWindow *window, uint8_t sequence, uint8_t toss);
+void accept_repair(TossWindow *window, const uint8_t *payload, size_t payload_len);
+int pop_toss(TossWindow *window, uint8_t *toss);
+
+// Reliable window, shared with client.c
+ReliableSlot *reliable_queue(ReliableState *rel, uint16_t message, uint8_t flags, const void *payload,
+                             size_t payload_len, long long now);
+int reliable_backoff(ReliableSlot *slot, long long now);
+void reliable_ack(ReliableState *rel, uint8_t seq);
+void reliable_settle(ReliableState *rel, uint8_t message_code);
+long long reliable_deadline_ms(const ReliableState *rel);
+
+#endif // PEN_CLIENT_H
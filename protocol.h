@@ -0,0 +1,169 @@
+// protocol.h
+//
+// ALP wire format shared by the server and the client.
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h> // For uint8_t and uint16_t
+
+#define PORT 8080
+#define MAX_PATTERN_LENGTH 64  // Patterns are kept in uint64_t windows
+#define SHORT_PATTERN_LENGTH 8 // Longest pattern the 16-bit REGISTER word can carry
+
+// Mask selecting the last length tosses of a rolling window
+#define PATTERN_MASK(length) ((length) >= 64 ? ~0ULL : (1ULL << (length)) - 1)
+
+// Message Codes
+#define MSG_LOSE     0b00
+#define MSG_WIN      0b01
+#define MSG_REGISTER 0b10
+#define MSG_READY    0b11
+#define MSG_TOSSING  0b11
+#define MSG_ACK      0b00 // Carried by client ACK frames; clients never send LOSE
+
+// Bit Positions and Masks
+#define BIT_TRANSMITTER 15
+#define BIT_TOSS        14
+#define BITS_MESSAGE    12
+#define BITS_CLIENT_ID  8
+#define BITS_SEQUENCE   0
+
+#define MASK_TRANSMITTER (1 << BIT_TRANSMITTER)
+#define MASK_TOSS        (1 << BIT_TOSS)
+#define MASK_MESSAGE     (0b11 << BITS_MESSAGE)
+#define MASK_CLIENT_ID   (0b1111 << BITS_CLIENT_ID)
+#define MASK_SEQUENCE    (0xFF << BITS_SEQUENCE)
+
+// Extended frame: the 16-bit ALP word followed by a flags byte and a
+// reliability sequence number. A bare 2-byte ALP word is still a valid,
+// best-effort message, so older peers keep working.
+typedef struct __attribute__((packed)) {
+    uint16_t message; // ALP word in network byte order
+    uint8_t flags;
+    uint8_t seq;
+} ControlFrame;
+
+// Frame flags
+#define FRAME_FLAG_RELIABLE 0x01 // Sender retransmits until the frame is acknowledged
+#define FRAME_FLAG_ACK      0x02 // Acknowledges the reliable frame carrying the same seq
+#define FRAME_FLAG_REPAIR   0x04 // Toss repair request (client) or response (server)
+#define FRAME_FLAG_MULTICAST 0x08 // REGISTER reply names the toss group; client ACK confirms it joined
+#define FRAME_FLAG_SHM       0x10 // Shared-memory transport: asked for in REGISTER, offered in the reply, confirmed by the ACK
+#define FRAME_FLAG_PATTERN   0x20 // REGISTER carries the full pattern in a PatternPayload
+#define FRAME_FLAG_TIMING    0x40 // RTT probe, probe echo or timed WIN, carries a TimingPayload (asked for in REGISTER, no payload there)
+#define FRAME_FLAG_BATCH     0x80 // Batched REGISTER, its reply, or a toss shared by batched players (see BatchPayload)
+
+// Retransmission of reliable frames (exponential backoff)
+#define RETRANSMIT_INITIAL_MS   50
+#define RETRANSMIT_MAX_MS       1600
+#define RETRANSMIT_MAX_ATTEMPTS 8
+
+// Both sides keep up to RELIABLE_WINDOW reliable frames in flight, all within
+// RELIABLE_WINDOW sequence numbers of the oldest unacknowledged one. A receiver
+// that remembers the last RELIABLE_WINDOW sequence numbers it took therefore
+// recognizes every retransmission, whatever order frames arrive in.
+#define RELIABLE_WINDOW 4
+
+// Function to tell whether a frame numbered seq may go out while oldest is unacknowledged
+static inline int reliable_seq_fits(uint8_t oldest, uint8_t seq) {
+    return (uint8_t)(seq - oldest) < RELIABLE_WINDOW;
+}
+
+// Function to record the sequence number of a received reliable frame. *last is the
+// newest one taken, bit i of *seen is set if *last - i was taken (0: nothing yet).
+// Returns 1 if the frame is new, 0 if it is a retransmission to acknowledge and ignore.
+static inline int reliable_seq_accept(uint8_t *last, uint8_t *seen, uint8_t seq) {
+    uint8_t behind = *last - seq;
+    if (*seen && behind < 0x80) {
+        // Not newer than the last one: new only if inside the window and not taken yet
+        if (behind >= RELIABLE_WINDOW || (*seen & (1 << behind))) {
+            return 0;
+        }
+        *seen |= 1 << behind;
+        return 1;
+    }
+    uint8_t ahead = seq - *last;
+    *seen = (*seen && ahead < RELIABLE_WINDOW) ? ((*seen << ahead) | 1) & ((1 << RELIABLE_WINDOW) - 1) : 1;
+    *last = seq;
+    return 1;
+}
+
+// Toss sequencing: the server stamps every toss with the low byte of its
+// index in the game (bits 7-0). Clients ask for a missing range with a
+// REPAIR frame and the server answers with the tosses packed MSB first.
+#define REPAIR_MAX_TOSSES 64
+#define REPAIR_TIMEOUT_MS 20
+
+typedef struct __attribute__((packed)) {
+    uint16_t first_toss; // Index of the first toss, network byte order (wraps)
+    uint8_t count;       // Number of tosses requested or carried
+    uint8_t bits[REPAIR_MAX_TOSSES / 8]; // Response only
+} RepairPayload;
+
+#define REPAIR_REQUEST_SIZE (sizeof(uint16_t) + sizeof(uint8_t))
+
+// Multicast toss distribution: in multicast mode each game streams its tosses
+// once to its own group (base address + 1 + game index) instead of unicasting a
+// copy to every player. Toss messages sent to a group carry client ID 0.
+#define MULTICAST_GROUP_BASE "239.255.80.0"
+#define MULTICAST_PORT 8081
+
+typedef struct __attribute__((packed)) {
+    uint32_t group; // Group address, network byte order
+    uint16_t port;  // Group port, network byte order
+} MulticastPayload;
+
+// Full pattern of an extended REGISTER. The ALP word still carries the
+// pattern when it fits in 8 bits; longer patterns need this payload.
+typedef struct __attribute__((packed)) {
+    uint8_t length;   // 1 to MAX_PATTERN_LENGTH
+    uint64_t pattern; // Tosses oldest first, last toss in bit 0 (1 = tails), network byte order
+} PatternPayload;
+
+// Batched registration: one REGISTER (FRAME_FLAG_PATTERN | FRAME_FLAG_BATCH)
+// for several players behind one address. Its PatternPayload carries the
+// first pattern and is followed by a BatchPayload with the others, so a
+// server without batches registers the first player alone. The reply names
+// the client IDs in request order (0: not registered, the server is full).
+// Tosses for batched players sharing an address and a game go out once,
+// addressed to one of them and flagged FRAME_FLAG_BATCH, with a
+// BatchTossPayload naming every player they count for.
+#define BATCH_MAX_PATTERNS 15 // Players of one REGISTER, the first one included
+
+typedef struct __attribute__((packed)) {
+    uint8_t count;    // Patterns that follow, up to BATCH_MAX_PATTERNS - 1
+    PatternPayload patterns[BATCH_MAX_PATTERNS - 1];
+} BatchPayload;
+
+#define BATCH_PAYLOAD_SIZE(count) (sizeof(uint8_t) + (count) * sizeof(PatternPayload))
+
+typedef struct __attribute__((packed)) {
+    uint8_t count;
+    uint8_t client_ids[BATCH_MAX_PATTERNS];
+} BatchReplyPayload;
+
+typedef struct __attribute__((packed)) {
+    uint16_t players; // Bit i set: the toss counts for client ID i; network byte order
+} BatchTossPayload;
+
+// Shared-memory transport offer for players on the server's host (see
+// shm_transport.h); names the region by server port and game index.
+typedef struct __attribute__((packed)) {
+    uint16_t port;       // Network byte order
+    uint16_t game_index; // Network byte order
+} ShmOfferPayload;
+
+// Latency measurement. Clients that set FRAME_FLAG_TIMING in REGISTER get an
+// unreliable probe (code ACK, no ACK flag) about once a second while they
+// play and echo its stamp with the time they held it, which gives the
+// server an RTT sample. A WIN flagged the same way tells the server how long
+// the client took between receiving the completing toss and claiming.
+#define RTT_PROBE_INTERVAL_MS 1000
+
+typedef struct __attribute__((packed)) {
+    uint32_t stamp_us; // Server clock (probe, echo), 0 in a WIN; network byte order
+    uint32_t hold_us;  // Time the client held the probe or the completing toss; network byte order
+} TimingPayload;
+
+#endif // PROTOCOL_H
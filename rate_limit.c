@@ -0,0 +1,64 @@
+// rate_limit.c
+
+#include <string.h>
+
+#include "rate_limit.h"
+
+// Function to reset the limiter, every source starts with a full bucket
+void rate_limit_init(RateLimiter *limiter, float rate, float burst) {
+    memset(limiter, 0, sizeof(*limiter));
+    limiter->rate = rate;
+    limiter->burst = burst;
+}
+
+// Function to spread IPv4 addresses over the table (Fibonacci hashing)
+static uint32_t rate_limit_hash(uint32_t address) {
+    return (address * 2654435769u) >> 20; // Top 12 bits, RATE_LIMIT_BUCKETS == 4096
+}
+
+// Function to charge one packet to its source.
+// Returns 1 if the packet may be processed, 0 if it must be dropped.
+int rate_limit_allow(RateLimiter *limiter, uint32_t address, long long now_ms) {
+    uint32_t now = (uint32_t)now_ms;
+    uint32_t index = rate_limit_hash(address);
+    RateBucket *bucket = NULL;
+    RateBucket *stalest = NULL;
+
+    for (int probe = 0; probe < RATE_LIMIT_PROBES; probe++) {
+        RateBucket *candidate = &limiter->buckets[(index + probe) & (RATE_LIMIT_BUCKETS - 1)];
+        if (candidate->address == address) {
+            bucket = candidate;
+            break;
+        }
+        if (candidate->address == 0) {
+            stalest = candidate;
+            break;
+        }
+        if (!stalest || (uint32_t)(now - candidate->last_ms) > (uint32_t)(now - stalest->last_ms)) {
+            stalest = candidate;
+        }
+    }
+
+    if (bucket) {
+        // Lazy refill for the time since this source was last seen
+        float elapsed = (uint32_t)(now - bucket->last_ms) / 1000.0f;
+        bucket->tokens += elapsed * limiter->rate;
+        if (bucket->tokens > limiter->burst) {
+            bucket->tokens = limiter->burst;
+        }
+    } else {
+        // New source: take an empty slot or evict the one idle for longest
+        bucket = stalest;
+        bucket->address = address;
+        bucket->tokens = limiter->burst;
+    }
+    bucket->last_ms = now;
+
+    if (bucket->tokens < 1.0f) {
+        limiter->dropped++;
+        return 0;
+    }
+    bucket->tokens -= 1.0f;
+    limiter->allowed++;
+    return 1;
+}
@@ -0,0 +1,34 @@
+// rate_limit.h
+//
+// Per-source token buckets guarding the server socket against floods.
+// Buckets live in a fixed open-addressing table keyed by IPv4 source
+// address and are refilled lazily when their source sends again.
+
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stdint.h>
+
+#define RATE_LIMIT_BUCKETS 4096 // Power of two
+#define RATE_LIMIT_PROBES  8    // Slots searched before evicting the stalest bucket
+#define RATE_LIMIT_DEFAULT_RATE  50.0  // Packets per second per source
+#define RATE_LIMIT_DEFAULT_BURST 100.0 // Bucket capacity
+
+typedef struct {
+    uint32_t address;   // IPv4 source in network byte order, 0 for an empty slot
+    uint32_t last_ms;   // Time of the last refill (wraps, only differences matter)
+    float tokens;
+} RateBucket;
+
+typedef struct {
+    RateBucket buckets[RATE_LIMIT_BUCKETS];
+    float rate;         // Tokens added per second
+    float burst;        // Maximum tokens in a bucket
+    unsigned long long allowed;
+    unsigned long long dropped;
+} RateLimiter;
+
+void rate_limit_init(RateLimiter *limiter, float rate, float burst);
+int rate_limit_allow(RateLimiter *limiter, uint32_t address, long long now_ms);
+
+#endif // RATE_LIMIT_H
@@ -0,0 +1,104 @@
+// rng_health.c
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "rng_health.h"
+
+#define EVEN_BITS 0x5555555555555555ULL
+
+// Function to reset the monitors
+void rng_health_init(RngHealth *health) {
+    memset(health, 0, sizeof(*health));
+}
+
+// Function to add (sign 1) or remove (sign -1) the counts of one word
+static void count_word(RngHealth *health, uint64_t word, int sign) {
+    health->ones += sign * __builtin_popcountll(word);
+    health->changes += sign * __builtin_popcountll((word ^ (word >> 1)) & (~0ULL >> 1));
+
+    // Pairs (bit 2i + 1, bit 2i): both set, high only, low only
+    uint64_t high = (word >> 1) & EVEN_BITS;
+    uint64_t low = word & EVEN_BITS;
+    long both = __builtin_popcountll(high & low);
+    long high_only = __builtin_popcountll(high & ~low);
+    long low_only = __builtin_popcountll(low & ~high);
+    health->pairs[3] += sign * both;
+    health->pairs[2] += sign * high_only;
+    health->pairs[1] += sign * low_only;
+    health->pairs[0] += sign * (32 - both - high_only - low_only);
+
+    for (int shift = 0; shift < 64; shift += 4) {
+        health->blocks[(word >> shift) & 0xF] += sign;
+    }
+}
+
+// Function to take a full word of tosses and re-evaluate the tests.
+// Returns the tests that started failing with this word.
+int rng_health_update(RngHealth *health, uint64_t word) {
+    if (health->count == RNG_HEALTH_WINDOW_WORDS) {
+        count_word(health, health->window[health->head], -1);
+    } else {
+        health->count++;
+    }
+    health->window[health->head] = word;
+    health->head = (health->head + 1) & (RNG_HEALTH_WINDOW_WORDS - 1);
+    count_word(health, word, 1);
+    health->tosses += 64;
+
+    if (health->count < RNG_HEALTH_MIN_WORDS) {
+        return 0;
+    }
+
+    double n = health->count * 64.0;
+    double change_slots = health->count * 63.0; // For fair tosses every change is a fair coin too
+    double pair_count = health->count * 32.0;
+    double block_count = health->count * 16.0;
+    health->frequency_z = (2.0 * health->ones - n) / sqrt(n);
+    health->runs_z = (2.0 * health->changes - change_slots) / sqrt(change_slots);
+    health->serial_chi2 = 0;
+    for (int i = 0; i < 4; i++) {
+        double diff = health->pairs[i] - pair_count / 4;
+        health->serial_chi2 += diff * diff / (pair_count / 4);
+    }
+    health->block_chi2 = 0;
+    for (int i = 0; i < 16; i++) {
+        double diff = health->blocks[i] - block_count / 16;
+        health->block_chi2 += diff * diff / (block_count / 16);
+    }
+
+    int failing = 0;
+    if (fabs(health->frequency_z) > RNG_HEALTH_Z_LIMIT) {
+        failing |= RNG_TEST_FREQUENCY;
+    }
+    if (fabs(health->runs_z) > RNG_HEALTH_Z_LIMIT) {
+        failing |= RNG_TEST_RUNS;
+    }
+    if (health->serial_chi2 > RNG_HEALTH_CHI2_3_LIMIT) {
+        failing |= RNG_TEST_SERIAL;
+    }
+    if (health->block_chi2 > RNG_HEALTH_CHI2_15_LIMIT) {
+        failing |= RNG_TEST_CHI_SQUARE;
+    }
+    int raised = failing & ~health->failing;
+    if (raised) {
+        health->alerts++;
+    }
+    health->failing = failing;
+    return raised;
+}
+
+// Function to write a one-line summary of the monitors
+size_t rng_health_describe(const RngHealth *health, char *buffer, size_t size) {
+    int written = snprintf(buffer, size,
+                           "%s tosses %llu window %d frequency_z %.2f runs_z %.2f serial_chi2 %.2f block_chi2 %.2f alerts %llu%s%s%s%s",
+                           health->failing ? "FAILING" : "ok", health->tosses, health->count * 64,
+                           health->frequency_z, health->runs_z, health->serial_chi2, health->block_chi2,
+                           health->alerts,
+                           health->failing & RNG_TEST_FREQUENCY ? " [frequency]" : "",
+                           health->failing & RNG_TEST_RUNS ? " [runs]" : "",
+                           health->failing & RNG_TEST_SERIAL ? " [serial]" : "",
+                           health->failing & RNG_TEST_CHI_SQUARE ? " [chi-square]" : "");
+    return written < 0 ? 0 : ((size_t)written < size ? (size_t)written : size - 1);
+}
@@ -0,0 +1,64 @@
+// rng_health.h
+//
+// Online health tests for the toss stream. Tosses are packed into 64-bit
+// words; every full word updates four sliding-window statistics with
+// popcounts over the last RNG_HEALTH_WINDOW_WORDS words:
+//   frequency    z-score of the number of tails
+//   runs         z-score of the number of toss-to-toss changes
+//   serial       chi-square of the non-overlapping toss pairs (3 df)
+//   chi-square   chi-square of the non-overlapping 4-toss blocks (15 df)
+// A test that crosses its threshold raises an alert; memory is constant.
+
+#ifndef RNG_HEALTH_H
+#define RNG_HEALTH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RNG_HEALTH_WINDOW_WORDS 1024 // 65536 tosses, power of two
+#define RNG_HEALTH_MIN_WORDS    16   // Tosses needed before judging: 1024
+#define RNG_HEALTH_Z_LIMIT      5.0  // Two-sided, p < 1e-6
+#define RNG_HEALTH_CHI2_3_LIMIT  30.7 // p < 1e-6 with 3 degrees of freedom
+#define RNG_HEALTH_CHI2_15_LIMIT 58.9 // p < 1e-6 with 15 degrees of freedom
+
+// Tests, as bits of RngHealth.failing
+#define RNG_TEST_FREQUENCY  0x1
+#define RNG_TEST_RUNS       0x2
+#define RNG_TEST_SERIAL     0x4
+#define RNG_TEST_CHI_SQUARE 0x8
+
+typedef struct {
+    uint64_t window[RNG_HEALTH_WINDOW_WORDS]; // Last full words, ring buffer
+    int head;            // Next slot to write
+    int count;           // Words in the window
+    uint64_t pending;    // Tosses of the word being filled, last toss in bit 0
+    int pending_bits;
+    long ones;           // Tails in the window
+    long changes;        // Adjacent tosses that differ, within words
+    long pairs[4];       // Non-overlapping pairs 00, 01, 10, 11
+    long blocks[16];     // Non-overlapping 4-toss blocks
+    double frequency_z;
+    double runs_z;
+    double serial_chi2;
+    double block_chi2;
+    int failing;         // RNG_TEST_* bits currently over threshold
+    unsigned long long alerts;  // Times a test started failing
+    unsigned long long tosses;
+} RngHealth;
+
+void rng_health_init(RngHealth *health);
+int rng_health_update(RngHealth *health, uint64_t word);
+size_t rng_health_describe(const RngHealth *health, char *buffer, size_t size);
+
+// Function to feed one toss. Returns the tests that started failing with it
+// (usually 0); the statistics only move once per 64 tosses.
+static inline int rng_health_add(RngHealth *health, uint8_t toss) {
+    health->pending = (health->pending << 1) | (toss & 1);
+    if (++health->pending_bits < 64) {
+        return 0;
+    }
+    health->pending_bits = 0;
+    return rng_health_update(health, health->pending);
+}
+
+#endif // RNG_HEALTH_H
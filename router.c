@@ -0,0 +1,640 @@
+// router.c
+//
+// Front-door UDP router for running several server processes behind one
+// address. Players talk to the router on PORT exactly as they would to a
+// server. Each player (session key: source address and port) is pinned to a
+// backend picked on a consistent-hash ring and gets its own connected socket
+// towards it, so the backend sees one address per player and its replies
+// find their way back. Forwarding is one table lookup and one send.
+//
+// Backends that join only receive new sessions. A backend that is removed
+// is drained: it keeps its sessions until they go idle. A backend that goes
+// down (ICMP port unreachable) hands its sessions to the next backend on
+// the ring; the router replays the player's REGISTER there and translates
+// client IDs between what the player knows and what the new backend
+// assigned. The game in flight on the lost backend is not recovered.
+//
+// Usage: ./router -b host:port [-b host:port ...]
+// Control (loopback, port 8091): "add host:port", "remove host:port", "list"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <stdint.h> // For uint8_t and uint16_t
+
+#include "protocol.h"
+
+#define ROUTER_CONTROL_PORT 8091
+#define MAX_BACKENDS 32
+#define VIRTUAL_NODES 64        // Ring points per backend, evens out the split
+#define MAX_SESSIONS 4096
+#define SESSION_TABLE_SLOTS 8192 // Power of two, twice MAX_SESSIONS
+#define SESSION_IDLE_MS 300000  // Sessions silent this long are closed (players idle between games)
+#define BACKEND_CHECK_MS 1000   // Liveness probe period, idle players send nothing that would notice
+#define ROUTER_FRAME_MAX 64
+#define ROUTER_BATCH 64         // Datagrams drained per socket per wakeup
+#define ROUTER_EVENTS 64
+
+#define BACKEND_UNUSED   0
+#define BACKEND_ACTIVE   1 // On the ring
+#define BACKEND_DRAINING 2 // Off the ring, keeps its sessions
+#define BACKEND_DOWN     3 // Unreachable, its sessions moved away
+
+typedef struct {
+    struct sockaddr_in address;
+    int state;
+    int sessions;
+    int probe_fd;                 // Connected socket for empty liveness datagrams
+    unsigned long long forwarded; // Datagrams in both directions
+} Backend;
+
+typedef struct {
+    uint32_t point;
+    int backend;
+} RingPoint;
+
+typedef struct {
+    int in_use;
+    struct sockaddr_in client;  // Session key
+    int fd;                     // Connected to the backend
+    int backend;
+    long long last_ms;
+    uint8_t register_frame[ROUTER_FRAME_MAX]; // Replayed when the session moves
+    size_t register_len;
+    uint8_t client_id;          // ID the player knows, 0 until its REGISTER reply
+    uint8_t backend_id;         // ID the current backend knows it by
+    int rehomed;                // The current backend's REGISTER replies are ours to absorb
+} Session;
+
+typedef struct {
+    int listen_fd;
+    int control_fd;
+    int epoll_fd;
+    Backend backends[MAX_BACKENDS];
+    RingPoint ring[MAX_BACKENDS * VIRTUAL_NODES];
+    int ring_size;
+    Session sessions[MAX_SESSIONS];
+    int free_sessions[MAX_SESSIONS]; // Stack of unused pool entries
+    int free_count;
+    int table[SESSION_TABLE_SLOTS];  // Open addressing on the client address, -1 when empty
+    int session_count;
+    unsigned long long rehomed;
+    unsigned long long dropped;
+} Router;
+
+// Function prototypes
+long long now_ms();
+uint32_t mix_hash(uint64_t key);
+uint64_t address_key(const struct sockaddr_in *address);
+int parse_address(const char *text, struct sockaddr_in *address);
+void rebuild_ring(Router *router);
+int ring_lookup(Router *router, const struct sockaddr_in *client);
+int add_backend(Router *router, const struct sockaddr_in *address);
+int find_backend(Router *router, const struct sockaddr_in *address);
+int find_session(Router *router, const struct sockaddr_in *client);
+int open_session(Router *router, const struct sockaddr_in *client);
+void close_session(Router *router, int index);
+int connect_session(Router *router, Session *session, int backend);
+void backend_down(Router *router, int backend);
+void rewrite_client_id(uint8_t *frame, uint8_t from, uint8_t to);
+void forward_to_backend(Router *router, const struct sockaddr_in *client, uint8_t *frame, size_t length);
+void forward_to_client(Router *router, int index);
+void expire_sessions(Router *router);
+void check_backends(Router *router);
+void release_backend(Router *router, int backend);
+void handle_control(Router *router);
+int create_bound_socket(uint32_t address, int port);
+
+int main(int argc, char *argv[]) {
+    static Router router; // Session pool and table, keep them off the stack
+    memset(&router, 0, sizeof(router));
+    memset(router.table, -1, sizeof(router.table));
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        router.free_sessions[i] = MAX_SESSIONS - 1 - i;
+    }
+    router.free_count = MAX_SESSIONS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:")) != -1) {
+        struct sockaddr_in address;
+        if (opt != 'b' || parse_address(optarg, &address) < 0 || add_backend(&router, &address) < 0) {
+            fprintf(stderr, "Usage: %s -b host:port [-b host:port ...]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    rebuild_ring(&router);
+    if (router.ring_size == 0) {
+        fprintf(stderr, "Usage: %s -b host:port [-b host:port ...]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    router.listen_fd = create_bound_socket(INADDR_ANY, PORT);
+    router.control_fd = create_bound_socket(INADDR_LOOPBACK, ROUTER_CONTROL_PORT);
+    router.epoll_fd = epoll_create1(0);
+    if (router.listen_fd < 0 || router.control_fd < 0 || router.epoll_fd < 0) {
+        perror("Router setup failed");
+        exit(EXIT_FAILURE);
+    }
+    // Listener and control socket are tagged -1 and -2, sessions by their pool index
+    struct epoll_event event = {EPOLLIN, {.u32 = (uint32_t)-1}};
+    epoll_ctl(router.epoll_fd, EPOLL_CTL_ADD, router.listen_fd, &event);
+    event.data.u32 = (uint32_t)-2;
+    epoll_ctl(router.epoll_fd, EPOLL_CTL_ADD, router.control_fd, &event);
+    printf("Router listening on port %d, control on 127.0.0.1:%d, %d backends\n",
+           PORT, ROUTER_CONTROL_PORT, router.ring_size / VIRTUAL_NODES);
+
+    struct epoll_event events[ROUTER_EVENTS];
+    long long next_check_ms = now_ms() + BACKEND_CHECK_MS;
+    while (1) {
+        int ready = epoll_wait(router.epoll_fd, events, ROUTER_EVENTS, 1000);
+        if (ready < 0 && errno != EINTR) {
+            perror("epoll_wait failed");
+            exit(EXIT_FAILURE);
+        }
+        for (int e = 0; e < ready; e++) {
+            uint32_t tag = events[e].data.u32;
+            if (tag == (uint32_t)-1) {
+                // Players to backends
+                uint8_t frame[ROUTER_FRAME_MAX];
+                struct sockaddr_in client;
+                for (int received = 0; received < ROUTER_BATCH; received++) {
+                    socklen_t client_len = sizeof(client);
+                    ssize_t length = recvfrom(router.listen_fd, frame, sizeof(frame), MSG_DONTWAIT,
+                                              (struct sockaddr *)&client, &client_len);
+                    if (length < 0) {
+                        break;
+                    }
+                    if (length >= (ssize_t)sizeof(uint16_t)) {
+                        forward_to_backend(&router, &client, frame, length);
+                    }
+                }
+            } else if (tag == (uint32_t)-2) {
+                handle_control(&router);
+            } else if (tag < MAX_SESSIONS && router.sessions[tag].in_use) {
+                forward_to_client(&router, tag);
+            }
+        }
+        if (now_ms() >= next_check_ms) {
+            expire_sessions(&router);
+            check_backends(&router);
+            next_check_ms = now_ms() + BACKEND_CHECK_MS;
+        }
+    }
+    return 0;
+}
+
+// Function to get the time in milliseconds for session expiry
+long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Function to scramble a 64-bit key into a 32-bit ring position (splitmix64 finalizer)
+uint32_t mix_hash(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBULL;
+    key ^= key >> 31;
+    return (uint32_t)key;
+}
+
+// Function to pack an IPv4 address and port into a key
+uint64_t address_key(const struct sockaddr_in *address) {
+    return ((uint64_t)address->sin_addr.s_addr << 16) | address->sin_port;
+}
+
+// Function to parse "host:port", returns -1 if it is invalid
+int parse_address(const char *text, struct sockaddr_in *address) {
+    char host[64];
+    int port;
+    if (sscanf(text, "%63[^:]:%d", host, &port) != 2 || port <= 0 || port > 65535) {
+        return -1;
+    }
+    memset(address, 0, sizeof(*address));
+    address->sin_family = AF_INET;
+    address->sin_port = htons(port);
+    return inet_pton(AF_INET, host, &address->sin_addr) == 1 ? 0 : -1;
+}
+
+// Function to place the active backends on the ring, sorted by position
+void rebuild_ring(Router *router) {
+    router->ring_size = 0;
+    for (int b = 0; b < MAX_BACKENDS; b++) {
+        if (router->backends[b].state != BACKEND_ACTIVE) {
+            continue;
+        }
+        for (int v = 0; v < VIRTUAL_NODES; v++) {
+            RingPoint point = {mix_hash(address_key(&router->backends[b].address) * VIRTUAL_NODES + v), b};
+            int k = router->ring_size++;
+            while (k > 0 && router->ring[k - 1].point > point.point) {
+                router->ring[k] = router->ring[k - 1];
+                k--;
+            }
+            router->ring[k] = point;
+        }
+    }
+}
+
+// Function to find the backend owning a client: first ring point at or after its hash.
+// Returns -1 when no backend is active.
+int ring_lookup(Router *router, const struct sockaddr_in *client) {
+    if (router->ring_size == 0) {
+        return -1;
+    }
+    uint32_t hash = mix_hash(address_key(client));
+    int low = 0, high = router->ring_size;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (router->ring[middle].point < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return router->ring[low == router->ring_size ? 0 : low].backend;
+}
+
+// Function to find a backend by address, -1 if unknown
+int find_backend(Router *router, const struct sockaddr_in *address) {
+    for (int b = 0; b < MAX_BACKENDS; b++) {
+        if (router->backends[b].state != BACKEND_UNUSED &&
+            router->backends[b].address.sin_addr.s_addr == address->sin_addr.s_addr &&
+            router->backends[b].address.sin_port == address->sin_port) {
+            return b;
+        }
+    }
+    return -1;
+}
+
+// Function to add (or bring back) a backend, the ring is rebuilt by the caller.
+// Returns its index, -1 when the table is full.
+int add_backend(Router *router, const struct sockaddr_in *address) {
+    int b = find_backend(router, address);
+    if (b < 0) {
+        for (b = 0; b < MAX_BACKENDS && router->backends[b].state != BACKEND_UNUSED; b++) {
+        }
+        if (b == MAX_BACKENDS) {
+            return -1;
+        }
+        memset(&router->backends[b], 0, sizeof(Backend));
+        router->backends[b].address = *address;
+        router->backends[b].probe_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (router->backends[b].probe_fd >= 0 &&
+            connect(router->backends[b].probe_fd, (const struct sockaddr *)address, sizeof(*address)) < 0) {
+            close(router->backends[b].probe_fd);
+            router->backends[b].probe_fd = -1;
+        }
+    }
+    router->backends[b].state = BACKEND_ACTIVE;
+    return b;
+}
+
+// Function to forget a backend that has no sessions left
+void release_backend(Router *router, int backend) {
+    if (router->backends[backend].probe_fd >= 0) {
+        close(router->backends[backend].probe_fd);
+    }
+    router->backends[backend].state = BACKEND_UNUSED;
+}
+
+// Function to find the session of a client, -1 if it has none
+int find_session(Router *router, const struct sockaddr_in *client) {
+    uint32_t slot = mix_hash(address_key(client)) & (SESSION_TABLE_SLOTS - 1);
+    while (router->table[slot] >= 0) {
+        Session *session = &router->sessions[router->table[slot]];
+        if (session->client.sin_addr.s_addr == client->sin_addr.s_addr &&
+            session->client.sin_port == client->sin_port) {
+            return router->table[slot];
+        }
+        slot = (slot + 1) & (SESSION_TABLE_SLOTS - 1);
+    }
+    return -1;
+}
+
+// Function to open a session for a new client on the backend the ring names.
+// Returns its index, -1 when no session can be opened.
+int open_session(Router *router, const struct sockaddr_in *client) {
+    int backend = ring_lookup(router, client);
+    if (backend < 0 || router->free_count == 0) {
+        return -1;
+    }
+    int index = router->free_sessions[router->free_count - 1];
+    Session *session = &router->sessions[index];
+    memset(session, 0, sizeof(*session));
+    session->client = *client;
+    session->fd = -1;
+    if (connect_session(router, session, backend) < 0) {
+        return -1;
+    }
+    router->free_count--;
+    session->in_use = 1;
+    session->last_ms = now_ms();
+
+    uint32_t slot = mix_hash(address_key(client)) & (SESSION_TABLE_SLOTS - 1);
+    while (router->table[slot] >= 0) {
+        slot = (slot + 1) & (SESSION_TABLE_SLOTS - 1);
+    }
+    router->table[slot] = index;
+    router->session_count++;
+    return index;
+}
+
+// Function to (re)connect a session's socket to a backend
+int connect_session(Router *router, Session *session, int backend) {
+    int index = session - router->sessions;
+    if (session->fd >= 0) {
+        close(session->fd); // Also leaves the epoll set
+        router->backends[session->backend].sessions--;
+    }
+    session->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (session->fd < 0) {
+        perror("Session socket creation failed");
+        return -1;
+    }
+    fcntl(session->fd, F_SETFL, fcntl(session->fd, F_GETFL, 0) | O_NONBLOCK);
+    struct epoll_event event = {EPOLLIN, {.u32 = (uint32_t)index}};
+    if (connect(session->fd, (const struct sockaddr *)&router->backends[backend].address, sizeof(struct sockaddr_in)) < 0 ||
+        epoll_ctl(router->epoll_fd, EPOLL_CTL_ADD, session->fd, &event) < 0) {
+        perror("Session connect failed");
+        close(session->fd);
+        session->fd = -1;
+        return -1;
+    }
+    session->backend = backend;
+    router->backends[backend].sessions++;
+    return 0;
+}
+
+// Function to close a session and take it out of the table (backward-shift deletion)
+void close_session(Router *router, int index) {
+    Session *session = &router->sessions[index];
+    uint32_t slot = mix_hash(address_key(&session->client)) & (SESSION_TABLE_SLOTS - 1);
+    while (router->table[slot] != index) {
+        slot = (slot + 1) & (SESSION_TABLE_SLOTS - 1);
+    }
+    uint32_t hole = slot;
+    while (1) {
+        slot = (slot + 1) & (SESSION_TABLE_SLOTS - 1);
+        if (router->table[slot] < 0) {
+            break;
+        }
+        uint32_t home = mix_hash(address_key(&router->sessions[router->table[slot]].client)) & (SESSION_TABLE_SLOTS - 1);
+        // Move the entry back if the hole lies between its home slot and where it sits
+        if (((slot - home) & (SESSION_TABLE_SLOTS - 1)) >= ((slot - hole) & (SESSION_TABLE_SLOTS - 1))) {
+            router->table[hole] = router->table[slot];
+            hole = slot;
+        }
+    }
+    router->table[hole] = -1;
+
+    if (session->fd >= 0) {
+        close(session->fd);
+    }
+    Backend *backend = &router->backends[session->backend];
+    backend->sessions--;
+    if (backend->state == BACKEND_DRAINING && backend->sessions == 0) {
+        printf("Backend %s:%d drained\n", inet_ntoa(backend->address.sin_addr), ntohs(backend->address.sin_port));
+        release_backend(router, session->backend);
+    }
+    session->in_use = 0;
+    router->free_sessions[router->free_count++] = index;
+    router->session_count--;
+}
+
+// Function to take an unreachable backend off the ring and move its sessions.
+// Players that registered through us are registered again on their new backend.
+void backend_down(Router *router, int backend) {
+    Backend *down = &router->backends[backend];
+    if (down->state == BACKEND_DOWN) {
+        return;
+    }
+    printf("Backend %s:%d is down, moving %d sessions\n",
+           inet_ntoa(down->address.sin_addr), ntohs(down->address.sin_port), down->sessions);
+    down->state = BACKEND_DOWN;
+    rebuild_ring(router);
+
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        Session *session = &router->sessions[i];
+        if (!session->in_use || session->backend != backend) {
+            continue;
+        }
+        int target = ring_lookup(router, &session->client);
+        if (target < 0 || connect_session(router, session, target) < 0) {
+            close_session(router, i);
+            continue;
+        }
+        router->rehomed++;
+        if (session->register_len > 0) {
+            // The new backend assigns its own ID. A player that already has one keeps it and
+            // we absorb the reply; one still waiting for its first reply gets it forwarded.
+            session->rehomed = session->client_id != 0;
+            send(session->fd, session->register_frame, session->register_len, MSG_DONTWAIT);
+        }
+    }
+}
+
+// Function to replace the client ID (bits 11-8) of the ALP word at the start of a frame
+void rewrite_client_id(uint8_t *frame, uint8_t from, uint8_t to) {
+    uint16_t word;
+    memcpy(&word, frame, sizeof(word));
+    word = ntohs(word);
+    if (((word & MASK_CLIENT_ID) >> BITS_CLIENT_ID) != from) {
+        return; // Group tosses (ID 0) and frames for someone else stay as they are
+    }
+    word = (word & ~MASK_CLIENT_ID) | ((to & 0b1111) << BITS_CLIENT_ID);
+    word = htons(word);
+    memcpy(frame, &word, sizeof(word));
+}
+
+// Function to forward a datagram from a player to its backend, opening its session if needed
+void forward_to_backend(Router *router, const struct sockaddr_in *client, uint8_t *frame, size_t length) {
+    int index = find_session(router, client);
+    if (index < 0) {
+        index = open_session(router, client);
+        if (index < 0) {
+            router->dropped++;
+            return;
+        }
+    }
+    Session *session = &router->sessions[index];
+    session->last_ms = now_ms();
+
+    uint16_t word;
+    memcpy(&word, frame, sizeof(word));
+    word = ntohs(word);
+    int is_register = !(word & MASK_TRANSMITTER) && ((word & MASK_MESSAGE) >> BITS_MESSAGE) == MSG_REGISTER;
+    if (is_register) {
+        // Bits 11-9 hold the pattern length here, keep a copy for a later move
+        if (length <= sizeof(session->register_frame)) {
+            memcpy(session->register_frame, frame, length);
+            session->register_len = length;
+        }
+    } else if (session->client_id != session->backend_id) {
+        rewrite_client_id(frame, session->client_id, session->backend_id);
+    }
+
+    if (send(session->fd, frame, length, MSG_DONTWAIT) < 0) {
+        if (errno == ECONNREFUSED) {
+            backend_down(router, session->backend);
+        }
+        router->dropped++;
+        return;
+    }
+    router->backends[session->backend].forwarded++;
+}
+
+// Function to forward what a backend sent for one session to its player
+void forward_to_client(Router *router, int index) {
+    Session *session = &router->sessions[index];
+    uint8_t frame[ROUTER_FRAME_MAX];
+    for (int received = 0; received < ROUTER_BATCH && session->in_use; received++) {
+        ssize_t length = recv(session->fd, frame, sizeof(frame), MSG_DONTWAIT);
+        if (length < 0) {
+            if (errno == ECONNREFUSED) {
+                backend_down(router, session->backend);
+            }
+            return;
+        }
+        if (length < (ssize_t)sizeof(uint16_t)) {
+            continue;
+        }
+        router->backends[session->backend].forwarded++;
+
+        uint16_t word;
+        memcpy(&word, frame, sizeof(word));
+        word = ntohs(word);
+        uint8_t flags = length >= (ssize_t)sizeof(ControlFrame) ? ((ControlFrame *)frame)->flags : 0;
+        int is_register_reply = ((word & MASK_MESSAGE) >> BITS_MESSAGE) == MSG_REGISTER && !(flags & FRAME_FLAG_ACK);
+        if (is_register_reply) {
+            session->backend_id = (word & MASK_CLIENT_ID) >> BITS_CLIENT_ID;
+            if (session->rehomed) {
+                // Our replayed registration: acknowledge it ourselves, the player already has an ID
+                if (flags & FRAME_FLAG_RELIABLE) {
+                    uint16_t ack_word = htons((MSG_ACK << BITS_MESSAGE) | (session->backend_id << BITS_CLIENT_ID));
+                    ControlFrame ack = {ack_word, FRAME_FLAG_ACK, ((ControlFrame *)frame)->seq};
+                    send(session->fd, &ack, sizeof(ack), MSG_DONTWAIT);
+                }
+                continue;
+            }
+            session->client_id = session->backend_id;
+        } else if (session->client_id != session->backend_id) {
+            rewrite_client_id(frame, session->backend_id, session->client_id);
+        }
+        sendto(router->listen_fd, frame, length, MSG_DONTWAIT,
+               (const struct sockaddr *)&session->client, sizeof(session->client));
+    }
+}
+
+// Function to close sessions that have been silent for too long
+void expire_sessions(Router *router) {
+    long long now = now_ms();
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        if (router->sessions[i].in_use && now - router->sessions[i].last_ms > SESSION_IDLE_MS) {
+            close_session(router, i);
+        }
+    }
+}
+
+// Function to probe the backends with empty datagrams (the server drops them unparsed).
+// A refused probe, reported on the next check, takes its backend down.
+void check_backends(Router *router) {
+    for (int b = 0; b < MAX_BACKENDS; b++) {
+        Backend *backend = &router->backends[b];
+        if ((backend->state != BACKEND_ACTIVE && backend->state != BACKEND_DRAINING) || backend->probe_fd < 0) {
+            continue;
+        }
+        uint8_t scratch;
+        if ((recv(backend->probe_fd, &scratch, sizeof(scratch), MSG_DONTWAIT) < 0 && errno == ECONNREFUSED) ||
+            (send(backend->probe_fd, NULL, 0, MSG_DONTWAIT) < 0 && errno == ECONNREFUSED)) {
+            backend_down(router, b);
+        }
+    }
+}
+
+// Function to answer a control request. Text commands, one per datagram:
+//   add host:port      put a backend (back) on the ring, it takes new sessions
+//   remove host:port   take a backend off the ring, its sessions stay until idle
+//   list               backends and sessions
+void handle_control(Router *router) {
+    char request[128];
+    char reply[4096];
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    ssize_t length = recvfrom(router->control_fd, request, sizeof(request) - 1, MSG_DONTWAIT,
+                              (struct sockaddr *)&peer, &peer_len);
+    if (length <= 0) {
+        return;
+    }
+    request[length] = '\0';
+
+    char target[64];
+    struct sockaddr_in address;
+    size_t used = 0;
+    if (sscanf(request, "add %63s", target) == 1 && parse_address(target, &address) == 0) {
+        used = snprintf(reply, sizeof(reply), add_backend(router, &address) < 0 ? "error too many backends\n" : "ok\n");
+        rebuild_ring(router);
+    } else if (sscanf(request, "remove %63s", target) == 1 && parse_address(target, &address) == 0) {
+        int b = find_backend(router, &address);
+        if (b < 0) {
+            used = snprintf(reply, sizeof(reply), "error unknown backend\n");
+        } else {
+            used = snprintf(reply, sizeof(reply), "ok draining %d sessions\n", router->backends[b].sessions);
+            if (router->backends[b].sessions > 0) {
+                router->backends[b].state = BACKEND_DRAINING;
+            } else {
+                release_backend(router, b);
+            }
+            rebuild_ring(router);
+        }
+    } else if (strncmp(request, "list", 4) == 0) {
+        static const char *states[] = {"unused", "active", "draining", "down"};
+        for (int b = 0; b < MAX_BACKENDS && used < sizeof(reply); b++) {
+            Backend *backend = &router->backends[b];
+            if (backend->state == BACKEND_UNUSED) {
+                continue;
+            }
+            used += snprintf(reply + used, sizeof(reply) - used, "backend %s:%d %s sessions %d forwarded %llu\n",
+                             inet_ntoa(backend->address.sin_addr), ntohs(backend->address.sin_port),
+                             states[backend->state], backend->sessions, backend->forwarded);
+        }
+        if (used < sizeof(reply)) {
+            used += snprintf(reply + used, sizeof(reply) - used, "sessions %d moved %llu dropped %llu\n",
+                             router->session_count, router->rehomed, router->dropped);
+        }
+    } else {
+        used = snprintf(reply, sizeof(reply), "error unknown command (add host:port | remove host:port | list)\n");
+    }
+    if (used > sizeof(reply)) {
+        used = sizeof(reply);
+    }
+    sendto(router->control_fd, reply, used, MSG_DONTWAIT, (struct sockaddr *)&peer, peer_len);
+}
+
+// Function to create a non-blocking UDP socket bound to the given address and port
+int create_bound_socket(uint32_t address, int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in bind_addr;
+    memset(&bind_addr, 0, sizeof(bind_addr));
+    bind_addr.sin_family = AF_INET;
+    bind_addr.sin_addr.s_addr = htonl(address);
+    bind_addr.sin_port = htons(port);
+    if (bind(fd, (const struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
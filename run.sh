@@ -1,6 +1,7 @@
 #!/bin/bash
 
-gcc server.c -o server
+gcc gen_pattern_tables.c -o gen_pattern_tables && ./gen_pattern_tables > pattern_tables.c &&
+gcc server.c shm_transport.c rate_limit.c advisor.c rng_health.c checkpoint.c history.c live_state.c low_latency.c pattern_tables.c -o server -lm
 
 
 if [ $? -eq 0 ]; then
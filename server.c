@@ -1,5 +1,6 @@
 // server.c
 
+#define _GNU_SOURCE // For sendmmsg
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,87 +12,389 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <sys/select.h>
+#include <fcntl.h>
+#include <endian.h>
 #include <stdint.h> // For uint8_t and uint16_t
 
-#define PORT 8080
+#include "protocol.h"
+#include "shm_transport.h"
+#include "rate_limit.h"
+#include "pattern_tables.h"
+#include "advisor.h"
+#include "rng_health.h"
+#include "checkpoint.h"
+#include "history.h"
+#include "live_state.h"
+#include "latency.h"
+#include "low_latency.h"
+
 #define MAX_CLIENTS 15 // Due to 4-bit client IDs
-#define MAX_PATTERN_LENGTH 8
 #define MIN_PLAYERS 2
-
-// Message Codes
-#define MSG_LOSE     0b00
-#define MSG_WIN      0b01
-#define MSG_REGISTER 0b10
-#define MSG_READY    0b11
-#define MSG_TOSSING  0b11
-
-// Bit Positions and Masks
-#define BIT_TRANSMITTER 15
-#define BIT_TOSS        14
-#define BITS_MESSAGE    12
-#define BITS_CLIENT_ID  8
-#define BITS_SEQUENCE   0
-
-#define MASK_TRANSMITTER (1 << BIT_TRANSMITTER)
-#define MASK_TOSS        (1 << BIT_TOSS)
-#define MASK_MESSAGE     (0b11 << BITS_MESSAGE)
-#define MASK_CLIENT_ID   (0b1111 << BITS_CLIENT_ID)
-#define MASK_SEQUENCE    (0xFF << BITS_SEQUENCE)
+#define MAX_PATTERN_STATS 30 // Distinct patterns tracked; when full the least-played one is replaced
+#define BUFFER_SIZE 256
+#define CONTROL_BACKLOG 8 // Reliable messages per client waiting for a window slot
+#define COIN_HISTORY 1024  // Tosses kept for validation and repair (ring buffer)
+#define CONTROL_PAYLOAD_MAX 16
+#define RATE_LIMIT_REPORT_MS 5000 // Interval between rate limiter reports
+#define RECEIVE_BATCH 256 // Datagrams read per loop iteration
+#define ADMIN_PORT_OFFSET 10 // Admin requests on the server port + 10 (8090), loopback only
+#define OUTBOUND_QUEUE_FRAMES 32 // Frames held per client while the socket is full
+#define OUTBOUND_FRAME_MAX 32
+#define SLOW_PEER_STALL_MS 2000  // A client whose queue has not drained for this long is evicted
+#define SLOW_PEER_MAX_DROPS 64   // Queue overflows tolerated before a client is evicted
+#define CHECKPOINT_PATH_FORMAT "pen-server-%d.ckpt" // Default snapshot file, by server port
+#define CHECKPOINT_INTERVAL_MS 1000      // Interval between snapshots
+#define HISTORY_PATH_FORMAT "pen-history-%d" // Default game history directory, by server port
+#define HISTORY_QUERY_GAMES 1000   // Games a pattern query looks at by default
+#define HISTORY_QUERY_MAX 10000
+#define HISTORY_QUERY_DAYS 7       // Window of a client query by default
+#define LIVE_PUBLISH_INTERVAL_MS 10 // Interval between updates of the live view for local observers
+#define MAX_GAMES 4          // Game instances played side by side
+#define MATCH_TABLE_SIZE 4   // Default players dealt into one game
+#define MATCH_WAIT_MS 200    // A short table starts once its oldest player has waited this long
+#define MATCH_MIX_MS 1000    // After this long a player may be seated with other pattern lengths
+#define LOOP_TICK_US 1000    // Toss and housekeeping period: the select() timeout, or the deadline of the spinning loop
+#define TICK_INPUT_MAX 1024  // Frames the tick engine holds for one tick; the rest wait in the socket
+#define SEND_BATCH 64        // Queued datagrams handed to one sendmmsg()
+
+// Reliable control message awaiting an ACK
+typedef struct {
+    int active;
+    uint8_t seq;
+    uint16_t message;   // ALP word in network byte order
+    uint8_t flags;      // Extra frame flags besides FRAME_FLAG_RELIABLE
+    uint8_t payload[CONTROL_PAYLOAD_MAX];
+    size_t payload_len;
+    int attempts;
+    int backoff_ms;
+    long long deadline_ms;
+} PendingControl;
+
+// Frames waiting for room in the socket send buffer (ring buffer)
+typedef struct {
+    uint8_t frames[OUTBOUND_QUEUE_FRAMES][OUTBOUND_FRAME_MAX];
+    uint8_t lengths[OUTBOUND_QUEUE_FRAMES];
+    int head;
+    int count;
+    long long stalled_since_ms; // When the queue last went from empty to non-empty
+    int drops;                  // Frames lost to a full queue since it was last empty
+} OutboundQueue;
+
+// Structure to hold the ways the server reaches its clients
+typedef struct {
+    int server_fd;                  // Non-blocking
+    socklen_t addr_len;
+    int port;                       // UDP port the server listens on
+    struct sockaddr_in *group_addrs; // Multicast toss group of each game, NULL when disabled
+    ShmGameRegion *shm[MAX_GAMES];  // Shared-memory region of each game, NULL when disabled
+    unsigned long long queued;      // Sends deferred because the socket was full
+    unsigned long long dropped;     // Frames lost to full queues or failed sends
+    unsigned long long evicted;     // Clients evicted for not keeping up
+    int flush_start;                // Client the next flush starts with (round robin)
+    // In-process delivery (turbo simulator): when set, unicast frames go here instead of the socket
+    void (*sink)(void *context, const struct sockaddr_in *address, const void *frame, size_t length);
+    void *sink_context;
+    int fair;                       // Fairness mode: wins settle on toss index, not on claim arrival
+    int table_size;                 // Players per game, how many clients a home game's audience takes first
+    int tick_engine;                // Tick engine: claims for the same toss in one tick share the win
+    int hold_output;                // Queue every unicast frame until the end of the tick
+    HistoryStore *history;          // Completed games are appended here, NULL when disabled
+} Transport;
 
 // Structure to hold client information
 typedef struct {
     uint8_t client_id;  // Unique client ID (4 bits)
     struct sockaddr_in address;
-    uint8_t pattern;    // 8-bit pattern
+    uint64_t pattern;   // Up to 64 tosses, last toss in bit 0
     int pattern_length;
     int registered;
     int has_won;
     int currently_playing; // Variable to track if the client is playing in the current game
+    int game;           // Game instance the client is dealt into, -1 while queued or idle
+    long long queued_ms; // When the client joined the matchmaking queue
+    int reliable;       // Client registered with extended control frames
+    uint8_t tx_seq;     // Sequence number of the last reliable frame sent
+    uint8_t rx_seq;     // Sequence number of the newest reliable frame received
+    uint8_t rx_seen;    // Bit i set: rx_seq - i was received (see reliable_seq_accept)
+    int multicast;      // Client joined its home game's toss group
+    int shared_memory;  // Client is local and exchanges every frame through its home game's region
+    int home_game;      // Game whose toss group and shared-memory region the client was offered
+    int wants_shared_memory; // Client asked for the shared-memory transport at registration
+    PendingControl pending[RELIABLE_WINDOW];
+    PendingControl backlog[CONTROL_BACKLOG]; // Waiting behind a full window, oldest first
+    int backlog_count;
+    OutboundQueue outbound;
+    int timing;              // Client answers RTT probes (FRAME_FLAG_TIMING in REGISTER)
+    uint32_t probe_stamp_us; // Stamp of the outstanding probe, older echoes are ignored
+    long long next_probe_ms;
+    uint32_t srtt_us;        // Smoothed RTT, 0 until the first sample
+    uint32_t rttvar_us;      // Smoothed RTT deviation
+    LatencyHistogram rtt;
+    LatencyHistogram claim_latency; // Completing toss sent -> WIN received
+    LatencyHistogram claim_hold;    // Part of it spent in the client, from timed WINs
+    uint64_t toss_window;    // Server-side copy of the client's rolling window in the current game
+    int window_tosses;       // Tosses in toss_window since the client joined the game
+    int completed_at;        // Toss count at which the pattern first completed, 0 if not yet
+    int batched;             // Registered in a batch: shares toss frames with its address's other players
+    BatchReplyPayload batch_reply; // IDs given to the batch this client led (count 0 otherwise), for retransmissions
+    int tick_claim;          // Toss count of a claim validated in the current tick, 0 if none
 } ClientInfo;
 
 // Structure to hold statistics for patterns
 typedef struct {
-    uint8_t pattern; // 8-bit pattern
+    uint64_t pattern; // Up to 64 tosses, last toss in bit 0
     int pattern_length;
     int wins;
     int total_games;
     int total_flips;
 } PatternStats;
 
+// Structure to hold one game instance
+typedef struct {
+    int in_progress;
+    uint8_t coin_sequence[COIN_HISTORY]; // Recent tosses for validation and repair (ring buffer)
+    int coin_sequence_length;
+    uint32_t toss_sent_us[COIN_HISTORY]; // When each recent toss went out (now_us), for claim latency
+    int players;        // Players dealt into the game
+    uint64_t started_us; // Wall clock, for the game history
+} Game;
+
+// Matchmaking: players waiting for a game are queued, then dealt into free
+// game instances in tables of players with the same pattern length and
+// similar RTTs.
+typedef struct {
+    int table_size;     // Players per game when enough are waiting
+    int wait_ms;        // Shorter tables start once their oldest player waited this long
+    int mix_ms;         // Players waiting this long may sit with other pattern lengths
+    unsigned long long games_started;
+    unsigned long long players_seated;
+    unsigned long long total_wait_ms; // Summed over seated players, queue to first toss
+} Matchmaker;
+
+// Frame held by the tick engine until the end of its tick
+typedef struct {
+    uint16_t message;   // ALP word in network byte order
+    uint8_t flags;
+    uint8_t seq;
+    uint8_t payload[BUFFER_SIZE - sizeof(ControlFrame)];
+    size_t payload_len;
+    struct sockaddr_in address;
+    int kind;           // TICK_* class, applied in this order
+    int game;           // Claims: the game and the toss count they name
+    int claim_length;
+    uint8_t client_id;
+    int arrival;        // Last tie breaker: copies of one frame keep their order
+} TickFrame;
+
+// Tick engine: frames drained during a tick are applied together at its end,
+// in an order that depends on their content only, never on arrival timing
+typedef struct {
+    TickFrame frames[TICK_INPUT_MAX];
+    int count;
+    unsigned long long ticks;
+    unsigned long long applied;
+} TickInput;
+
+#define TICK_TRANSPORT 0 // ACKs, probe echoes, repair requests: no effect on games
+#define TICK_REGISTER  1 // By source address
+#define TICK_CLAIM     2 // By game, then the toss the claim names, then client ID
+#define TICK_OTHER     3 // READY and the rest, by client ID
+
+// Everything a restarted server needs to pick up where it stopped
+typedef struct {
+    ClientInfo clients[MAX_CLIENTS];
+    PatternStats pattern_stats[MAX_PATTERN_STATS];
+    int pattern_stats_count;
+    Game games[MAX_GAMES];
+    int completed_games;
+} ServerSnapshot;
+
 // Function prototypes
 void initialize_clients(ClientInfo clients[]);
 int find_client_index(ClientInfo clients[], uint8_t client_id);
-void register_client(int server_fd, ClientInfo clients[], struct sockaddr_in client_addr, uint16_t message,
-                     socklen_t addr_len, uint8_t *next_client_id);
-void handle_client_message(int server_fd, ClientInfo clients[], PatternStats pattern_stats[],
-                           int *pattern_stats_count, uint16_t message,
-                           struct sockaddr_in client_addr, int *game_in_progress, uint8_t coin_sequence[],
-                           int *coin_sequence_length, int *completed_games,
-                           socklen_t addr_len, uint8_t *next_client_id);
-void process_win_claim(int server_fd, ClientInfo clients[], int client_index,
+uint8_t free_client_id(ClientInfo clients[]);
+int pick_home_game(Transport *transport, ClientInfo clients[], int client_index);
+void register_client(Transport *transport, ClientInfo clients[], struct sockaddr_in client_addr, uint16_t message,
+                     uint8_t frame_flags, uint8_t frame_seq, const uint8_t *payload, size_t payload_len);
+int add_client(ClientInfo clients[], struct sockaddr_in client_addr, uint64_t pattern, int length, uint8_t frame_flags,
+               uint8_t frame_seq);
+void handle_client_message(Transport *transport, ClientInfo clients[], PatternStats pattern_stats[],
+                           int *pattern_stats_count, uint16_t message, uint8_t frame_flags, uint8_t frame_seq,
+                           const uint8_t *payload, size_t payload_len,
+                           struct sockaddr_in client_addr, Game games[], int *completed_games);
+void process_win_claim(Transport *transport, ClientInfo clients[], int client_index, int claim_length,
                        uint8_t coin_sequence[], int coin_sequence_length, PatternStats pattern_stats[],
-                       int *pattern_stats_count, int *game_in_progress, int *completed_games, socklen_t addr_len);
+                       int *pattern_stats_count, int *game_in_progress, int *completed_games, uint64_t started_us);
+int claim_toss_count(const Game *game, uint8_t frame_flags, uint8_t sequence);
+uint64_t sequence_window(const uint8_t coin_sequence[], int claim_length, int pattern_length);
+int claim_matches(const ClientInfo *client, int claim_length, const uint8_t coin_sequence[], int coin_sequence_length);
+int tick_enqueue(TickInput *input, const uint8_t *buffer, size_t length, struct sockaddr_in address);
+int compare_tick_frames(const void *a, const void *b);
+void apply_tick(Transport *transport, ClientInfo clients[], PatternStats pattern_stats[], int *pattern_stats_count,
+                Game games[], int *completed_games, TickInput *input);
+void record_game(HistoryStore *history, ClientInfo clients[], int game_index, uint64_t started_us, int flips);
+void publish_live_state(LiveRegion *live, LiveState *staging, ClientInfo clients[], Game games[],
+                        PatternStats pattern_stats[], int pattern_stats_count, int completed_games,
+                        HistoryStore *history);
 void update_pattern_stats(PatternStats pattern_stats[], int *pattern_stats_count,
                           ClientInfo client, int coin_sequence_length, int win);
-void send_coin_flip(int server_fd, ClientInfo clients[], uint8_t coin_sequence[],
-                    int *coin_sequence_length, socklen_t addr_len);
-uint16_t create_server_message(uint8_t toss, uint8_t message_code, uint8_t client_id);
+void send_coin_flip(Transport *transport, ClientInfo clients[], Game games[], int game_index, RngHealth *health);
+int earliest_completion(ClientInfo clients[], int game_index, int claim_length);
+void reset_completion(ClientInfo *client);
+void queue_client(ClientInfo *client);
+void initialize_matchmaker(Matchmaker *matchmaker, int table_size);
+int run_matchmaker(Matchmaker *matchmaker, ClientInfo clients[], Game games[]);
+int form_table(Matchmaker *matchmaker, ClientInfo clients[], int queued[], int queued_count, int game_index,
+               long long now, int table[]);
+void start_game(Matchmaker *matchmaker, ClientInfo clients[], Game games[], int game_index, int table[],
+                int table_size, long long now);
+uint16_t create_server_message(uint8_t toss, uint8_t message_code, uint8_t client_id, uint8_t sequence);
+int resolve_toss_index(uint16_t wire_index, uint16_t wire_mask, int coin_sequence_length);
+void send_repair(Transport *transport, ClientInfo *client, const uint8_t *payload, size_t payload_len,
+                 uint8_t coin_sequence[], int coin_sequence_length);
+int send_control_message(Transport *transport, ClientInfo *client, uint16_t message, uint8_t flags,
+                         const void *payload, size_t payload_len);
+void admit_backlog(Transport *transport, ClientInfo *client);
+void transmit_pending(Transport *transport, ClientInfo *client, PendingControl *pending);
+void send_registration_reply(Transport *transport, ClientInfo *client);
+void send_batch_reply(Transport *transport, ClientInfo *lead);
+void setup_multicast(Transport *transport, struct sockaddr_in *group_addr, const char *interface, int game_index);
+void send_ack(Transport *transport, ClientInfo *client, uint16_t message, uint8_t seq);
+void deliver_frame(Transport *transport, ClientInfo *client, const void *frame, size_t length);
+int send_datagram(Transport *transport, const struct sockaddr_in *address, const void *frame, size_t length);
+int outbound_pending(ClientInfo clients[]);
+void flush_outbound(Transport *transport, ClientInfo clients[]);
+void evict_slow_clients(Transport *transport, ClientInfo clients[]);
+int parse_frame(const uint8_t *buffer, size_t length, uint16_t *message, uint8_t *flags, uint8_t *seq, size_t *payload_len);
+void handle_ack(Transport *transport, ClientInfo *client, uint8_t seq);
+void service_retransmissions(Transport *transport, ClientInfo clients[]);
+void send_rtt_probes(Transport *transport, ClientInfo clients[]);
+void handle_probe_echo(ClientInfo *client, const uint8_t *payload, size_t payload_len);
+void record_claim_latency(Game *game, ClientInfo *client, uint8_t frame_flags, const uint8_t *payload,
+                          size_t payload_len, int claim_length);
+long long now_ms();
+uint32_t now_us();
+uint64_t wall_us();
 void parse_client_message(uint16_t message, uint8_t *message_code, uint8_t *client_id, uint8_t *sequence, uint8_t *pattern_lenght);
 void print_diagnostics(int completed_games);
+void report_rate_limiter(RateLimiter *limiter, unsigned long long *reported_drops);
+void report_outbound(Transport *transport, unsigned long long *reported_losses);
 void print_statistics(PatternStats pattern_stats[], int pattern_stats_count);
-
-int main() {
+int create_admin_socket(int admin_port);
+void handle_admin_request(int admin_fd, PatternAdvisor *advisor, ClientInfo clients[], const RngHealth *health,
+                          Game games[], const Matchmaker *matchmaker, HistoryStore *history,
+                          const LatencyHistogram *wakeup_jitter, int low_latency_cpu);
+size_t describe_history(HistoryStore *history, const char *request, char *reply, size_t size);
+void save_snapshot(Checkpoint *checkpoint, ServerSnapshot *snapshot, ClientInfo clients[], PatternStats pattern_stats[],
+                   int pattern_stats_count, Game games[], int completed_games);
+int restore_snapshot(Checkpoint *checkpoint, ServerSnapshot *snapshot, Transport *transport, ClientInfo clients[],
+                     PatternStats pattern_stats[], int *pattern_stats_count, Game games[], int *completed_games);
+
+#ifndef SERVER_EMBEDDED // turbo.c includes this file and brings its own main
+int main(int argc, char *argv[]) {
     int server_fd;
     struct sockaddr_in server_addr, client_addr;
     socklen_t addr_len = sizeof(struct sockaddr_in);
+    uint8_t buffer[BUFFER_SIZE];
     uint16_t message;
 
     // For diagnostics
     int completed_games = 0;
 
+    // Command line options
+    int multicast_enabled = 0;
+    int shm_enabled = 0;
+    const char *multicast_interface = "127.0.0.1";
+    float rate_limit = RATE_LIMIT_DEFAULT_RATE;
+    float rate_burst = RATE_LIMIT_DEFAULT_BURST;
+    int port = PORT;
+    char default_checkpoint_path[64];
+    const char *checkpoint_path = NULL;
+    char default_history_path[64];
+    const char *history_path = NULL;
+    int fresh_start = 0;
+    int fair_mode = 0;
+    int tick_engine = 0;
+    int table_size = MATCH_TABLE_SIZE;
+    int low_latency_cpu = -1; // Spin pinned to this CPU instead of sleeping in select()
+    int opt;
+    while ((opt = getopt(argc, argv, "mi:sr:b:c:FfTt:p:H:L:")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'H':
+                history_path = optarg;
+                break;
+            case 'm':
+                multicast_enabled = 1;
+                break;
+            case 'i':
+                multicast_interface = optarg;
+                break;
+            case 's':
+                shm_enabled = 1;
+                break;
+            case 'r':
+                rate_limit = atof(optarg);
+                break;
+            case 'b':
+                rate_burst = atof(optarg);
+                break;
+            case 'c':
+                checkpoint_path = optarg;
+                break;
+            case 'F':
+                fresh_start = 1;
+                break;
+            case 'f':
+                fair_mode = 1;
+                break;
+            case 'T':
+                tick_engine = 1;
+                break;
+            case 't':
+                table_size = atoi(optarg);
+                break;
+            case 'L':
+                low_latency_cpu = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-m] [-i multicast_interface] [-s] [-r packets_per_second] [-b burst] [-c checkpoint_file] [-F] [-f] [-T] [-t players_per_game] [-p port] [-H history_dir] [-L cpu]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (rate_limit <= 0 || rate_burst < 1) {
+        fprintf(stderr, "Rate limit must be positive and burst at least 1\n");
+        exit(EXIT_FAILURE);
+    }
+    if (port <= 0 || port + ADMIN_PORT_OFFSET > 65535) {
+        fprintf(stderr, "Invalid port %d\n", port);
+        exit(EXIT_FAILURE);
+    }
+    if (!checkpoint_path) {
+        snprintf(default_checkpoint_path, sizeof(default_checkpoint_path), CHECKPOINT_PATH_FORMAT, port);
+        checkpoint_path = default_checkpoint_path;
+    }
+    if (!history_path) {
+        snprintf(default_history_path, sizeof(default_history_path), HISTORY_PATH_FORMAT, port);
+        history_path = default_history_path;
+    }
+    if (table_size < MIN_PLAYERS || table_size > MAX_CLIENTS) {
+        fprintf(stderr, "Players per game must be between %d and %d\n", MIN_PLAYERS, MAX_CLIENTS);
+        exit(EXIT_FAILURE);
+    }
+
+    // Per-source token buckets, checked before a datagram is parsed
+    static RateLimiter rate_limiter; // Too large for the stack
+    rate_limit_init(&rate_limiter, rate_limit, rate_burst);
+    unsigned long long reported_drops = 0;
+    unsigned long long reported_losses = 0;
+    long long next_rate_report_ms = now_ms() + RATE_LIMIT_REPORT_MS;
+
     // Initialize clients
     ClientInfo clients[MAX_CLIENTS];
-    PatternStats pattern_stats[MAX_CLIENTS * 2]; // Assuming possible different patterns
+    PatternStats pattern_stats[MAX_PATTERN_STATS];
     int pattern_stats_count = 0;
 
     initialize_clients(clients);
@@ -99,6 +402,10 @@ int main() {
     // Seed the random number generator once
     srand(time(NULL));
 
+    // Statistical tests on every toss we send
+    static RngHealth rng_health; // Keeps a window of tosses, off the stack
+    rng_health_init(&rng_health);
+
     // Create UDP socket
     if ((server_fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
         perror("Socket creation failed");
@@ -111,7 +418,7 @@ int main() {
     // Fill server information
     server_addr.sin_family = AF_INET;      // IPv4
     server_addr.sin_addr.s_addr = INADDR_ANY; // Bind to all interfaces
-    server_addr.sin_port = htons(PORT);
+    server_addr.sin_port = htons(port);
 
     // Bind the socket with the server address
     if (bind(server_fd, (const struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
@@ -119,58 +426,305 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    printf("UDP server listening on port %d\n", PORT);
+    // Sends never block the loop: a full send buffer defers frames to per-client queues
+    int socket_flags = fcntl(server_fd, F_GETFL, 0);
+    if (socket_flags < 0 || fcntl(server_fd, F_SETFL, socket_flags | O_NONBLOCK) < 0) {
+        perror("Setting non-blocking mode failed");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("UDP server listening on port %d\n", port);
+
+    // Admin interface (pattern advisor) for tools on this host
+    int admin_fd = create_admin_socket(port + ADMIN_PORT_OFFSET);
+    static PatternAdvisor advisor; // Holds the reduced table, keep it off the stack
+    advisor_init(&advisor);
+
+    Transport transport = {.server_fd = server_fd, .addr_len = addr_len, .port = port, .fair = fair_mode,
+                           .table_size = table_size};
+    if (fair_mode) {
+        printf("Fairness mode: wins are settled on the toss index\n");
+    }
+
+    // Tick engine: input is applied in batches per tick, output leaves in one batch
+    static TickInput tick_input; // Holds full frames, keep it off the stack
+    transport.tick_engine = tick_engine;
+    if (tick_engine) {
+        printf("Tick engine: frames are applied once per tick, claims for the same toss share the win\n");
+    }
+
+    // Tosses of each game go to its own multicast group when enabled
+    struct sockaddr_in group_addrs[MAX_GAMES];
+    if (multicast_enabled) {
+        for (int g = 0; g < MAX_GAMES; g++) {
+            setup_multicast(&transport, &group_addrs[g], multicast_interface, g);
+        }
+        transport.group_addrs = group_addrs;
+    }
 
-    // Main loop
-    int game_in_progress = 0;
+    // Local players may exchange frames with their game through shared memory
+    if (shm_enabled) {
+        for (int g = 0; g < MAX_GAMES; g++) {
+            transport.shm[g] = shm_create_region(port, g);
+            if (!transport.shm[g]) {
+                exit(EXIT_FAILURE);
+            }
+        }
+        printf("Shared-memory transport enabled for local players (%d game regions)\n", MAX_GAMES);
+    }
 
-    // Sequence buffer to store coin flips
-    uint8_t coin_sequence[1024]; // Store entire sequence for validation
-    int coin_sequence_length = 0;
+    // Game instances, filled by the matchmaker from the queue of ready players
+    static Game games[MAX_GAMES]; // Toss histories, keep them off the stack
+    Matchmaker matchmaker;
+    initialize_matchmaker(&matchmaker, table_size);
 
-    fd_set readfds;
+    fd_set readfds, writefds;
     struct timeval timeout;
 
-    uint8_t next_client_id = 1; // Counter for assigning unique client IDs
+    // Pick up the registry, statistics and game of the previous run, then keep snapshotting them
+    static Checkpoint checkpoint;
+    static ServerSnapshot snapshot; // Staging copy of the state, too large for the stack
+    int checkpoint_enabled = checkpoint_open(&checkpoint, checkpoint_path, sizeof(ServerSnapshot)) == 0;
+    if (checkpoint_enabled && !fresh_start &&
+        restore_snapshot(&checkpoint, &snapshot, &transport, clients, pattern_stats, &pattern_stats_count,
+                         games, &completed_games)) {
+        int running = 0;
+        for (int g = 0; g < MAX_GAMES; g++) {
+            running += games[g].in_progress;
+        }
+        printf("Restored state from %s (%d games completed, %d in progress)\n", checkpoint_path, completed_games,
+               running);
+    }
+    long long next_checkpoint_ms = now_ms() + CHECKPOINT_INTERVAL_MS;
+
+    // Completed games are kept for queries; the server plays on without them if the store fails
+    static HistoryStore history;
+    if (history_open(&history, history_path) == 0) {
+        transport.history = &history;
+        printf("Game history in %s (%llu games)\n", history_path, (unsigned long long)history_games(&history));
+    }
+
+    // Read-only view of the games for local observers (pen-top); optional like the history
+    static LiveState live_staging;
+    LiveRegion *live = live_create(port);
+    if (live) {
+        printf("Live state published as " LIVE_NAME_FORMAT "\n", port);
+    }
+    long long next_live_ms = 0;
+
+    // Low-latency mode: everything is allocated by now, so pin, lock and start spinning
+    if (low_latency_cpu >= 0) {
+        int fds[] = {server_fd, admin_fd};
+        if (low_latency_setup(low_latency_cpu, fds, admin_fd >= 0 ? 2 : 1) < 0) {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // How late the loop gets back to its timed work, in microseconds (admin "jitter")
+    static LatencyHistogram wakeup_jitter;
+    uint64_t next_tick_us = low_latency_clock_us() + LOOP_TICK_US;
 
     while (1) {
-        // Set timeout for select
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 1000; // 100 milliseconds
+        int server_readable, server_writable, admin_readable;
+        int tick_due = 1;
+        if (low_latency_cpu >= 0) {
+            // Spin: try every receive without blocking, run the timed work when its deadline has passed
+            uint64_t spin_us = low_latency_clock_us();
+            tick_due = spin_us >= next_tick_us;
+            if (tick_due) {
+                latency_record(&wakeup_jitter, spin_us - next_tick_us);
+                next_tick_us += LOOP_TICK_US;
+                if (next_tick_us <= spin_us) {
+                    next_tick_us = spin_us + LOOP_TICK_US; // Fell behind: skip the missed ticks rather than burst
+                }
+            }
+            server_readable = 1;
+            server_writable = outbound_pending(clients);
+            admin_readable = tick_due && admin_fd >= 0;
+        } else {
+            // Set timeout for select
+            timeout.tv_sec = 0;
+            timeout.tv_usec = LOOP_TICK_US;
+
+            // Set up the file descriptor set
+            FD_ZERO(&readfds);
+            FD_SET(server_fd, &readfds);
+            int max_sd = server_fd;
+            if (admin_fd >= 0) {
+                FD_SET(admin_fd, &readfds);
+                if (admin_fd > max_sd) {
+                    max_sd = admin_fd;
+                }
+            }
+
+            // Watch for writability only while some client has deferred frames
+            int flush_wanted = outbound_pending(clients);
+            FD_ZERO(&writefds);
+            if (flush_wanted) {
+                FD_SET(server_fd, &writefds);
+            }
+
+            // Wait for activity or timeout
+            uint64_t sleep_us = low_latency_clock_us();
+            int activity = select(max_sd + 1, &readfds, flush_wanted ? &writefds : NULL, NULL, &timeout);
+            if (activity < 0) {
+                FD_ZERO(&readfds);
+                FD_ZERO(&writefds);
+            }
+            if (activity == 0) {
+                // A timeout is the only wakeup with a known deadline
+                uint64_t slept_us = low_latency_clock_us() - sleep_us;
+                latency_record(&wakeup_jitter, slept_us > LOOP_TICK_US ? slept_us - LOOP_TICK_US : 0);
+            }
+
+            if ((activity < 0) && (errno != EINTR)) {
+                printf("Select error");
+            }
+            server_readable = FD_ISSET(server_fd, &readfds);
+            server_writable = FD_ISSET(server_fd, &writefds);
+            admin_readable = admin_fd >= 0 && FD_ISSET(admin_fd, &readfds);
+        }
 
-        // Set up the file descriptor set
-        FD_ZERO(&readfds);
-        FD_SET(server_fd, &readfds);
-        int max_sd = server_fd;
+        if (admin_readable) {
+            handle_admin_request(admin_fd, &advisor, clients, &rng_health, games, &matchmaker, transport.history,
+                                 &wakeup_jitter, low_latency_cpu);
+        }
+
+        // Deferred frames go out first so they keep their order
+        if (server_writable) {
+            flush_outbound(&transport, clients);
+        }
+
+        if (server_readable) {
+            // Drain a batch of datagrams so a flood cannot crowd players out of the socket buffer
+            long long receive_ms = now_ms();
+            for (int received = 0; received < RECEIVE_BATCH; received++) {
+                if (tick_engine && tick_input.count == TICK_INPUT_MAX) {
+                    break; // The rest waits in the socket for the next tick
+                }
+                ssize_t valread = recvfrom(server_fd, buffer, sizeof(buffer), MSG_DONTWAIT,
+                                           (struct sockaddr *)&client_addr, &addr_len);
+                if (valread < 0) {
+                    break;
+                }
+                // Over-limit sources are dropped before any parsing or logging
+                if (!rate_limit_allow(&rate_limiter, client_addr.sin_addr.s_addr, receive_ms)) {
+                    continue;
+                }
+                if (tick_engine) {
+                    tick_enqueue(&tick_input, buffer, valread, client_addr);
+                    continue;
+                }
+                uint8_t frame_flags, frame_seq;
+                size_t payload_len;
+                if (parse_frame(buffer, valread, &message, &frame_flags, &frame_seq, &payload_len) == 0) {
+                    handle_client_message(&transport, clients, pattern_stats, &pattern_stats_count,
+                                          message, frame_flags, frame_seq, buffer + sizeof(ControlFrame), payload_len,
+                                          client_addr, games, &completed_games);
+                }
+            }
+        }
+
+        // Frames posted by local players go through the same message handling
+        size_t command_len;
+        for (int g = 0; g < MAX_GAMES && transport.shm[g]; g++) {
+            while (!(tick_engine && tick_input.count == TICK_INPUT_MAX) &&
+                   shm_command_pop(transport.shm[g], buffer, &command_len)) {
+                uint8_t frame_flags, frame_seq, message_code, client_id, sequence, pattern_length;
+                size_t payload_len;
+                if (parse_frame(buffer, command_len, &message, &frame_flags, &frame_seq, &payload_len) < 0) {
+                    continue;
+                }
+                parse_client_message(message, &message_code, &client_id, &sequence, &pattern_length);
+                int client_index = find_client_index(clients, client_id);
+                if (message_code == MSG_REGISTER || client_index == -1) {
+                    continue; // Registration always goes over UDP
+                }
+                if (tick_engine) {
+                    tick_enqueue(&tick_input, buffer, command_len, clients[client_index].address);
+                    continue;
+                }
+                handle_client_message(&transport, clients, pattern_stats, &pattern_stats_count,
+                                      message, frame_flags, frame_seq, buffer + sizeof(ControlFrame), payload_len,
+                                      clients[client_index].address, games, &completed_games);
+            }
+        }
+
+        // Between ticks the spinning loop only receives and answers
+        if (!tick_due) {
+            continue;
+        }
+
+        // The tick's input is applied as one batch against the current toss index; everything
+        // the tick sends (answers, verdicts, tosses) is held and leaves together at its end
+        if (tick_engine) {
+            transport.hold_output = 1;
+            apply_tick(&transport, clients, pattern_stats, &pattern_stats_count, games, &completed_games,
+                       &tick_input);
+        }
+
+        // Resend control messages that have not been acknowledged in time
+        service_retransmissions(&transport, clients);
+
+        // Keep the RTT estimates of timing clients fresh
+        send_rtt_probes(&transport, clients);
+
+        // Drop clients that cannot keep up before their backlog grows stale
+        evict_slow_clients(&transport, clients);
 
-        // Wait for activity or timeout
-        int activity = select(max_sd + 1, &readfds, NULL, NULL, &timeout);
+        // Report flood drops and send losses periodically rather than per packet
+        if (now_ms() >= next_rate_report_ms) {
+            report_rate_limiter(&rate_limiter, &reported_drops);
+            report_outbound(&transport, &reported_losses);
+            next_rate_report_ms = now_ms() + RATE_LIMIT_REPORT_MS;
+        }
 
-        if ((activity < 0) && (errno != EINTR)) {
-            printf("Select error");
+        // Snapshot between events, so the file always holds a consistent state
+        if (checkpoint_enabled && now_ms() >= next_checkpoint_ms) {
+            save_snapshot(&checkpoint, &snapshot, clients, pattern_stats, pattern_stats_count, games,
+                          completed_games);
+            next_checkpoint_ms = now_ms() + CHECKPOINT_INTERVAL_MS;
         }
 
-        if (FD_ISSET(server_fd, &readfds)) {
-            // Receive message from client
-            ssize_t valread = recvfrom(server_fd, &message, sizeof(message), 0,
-                                       (struct sockaddr *)&client_addr, &addr_len);
-            if (valread > 0) {
-                handle_client_message(server_fd, clients, pattern_stats, &pattern_stats_count,
-                                      message, client_addr, &game_in_progress,
-                                      coin_sequence, &coin_sequence_length, &completed_games,
-                                      addr_len, &next_client_id);
+        // Deal queued players into free game instances
+        run_matchmaker(&matchmaker, clients, games);
+
+        // Every game in progress gets its next coin flip
+        for (int g = 0; g < MAX_GAMES; g++) {
+            if (games[g].in_progress) {
+                send_coin_flip(&transport, clients, games, g, &rng_health);
             }
         }
+        if (tick_engine) {
+            transport.hold_output = 0;
+            flush_outbound(&transport, clients);
+        }
 
-        // If game is in progress, send coin flips
-        if (game_in_progress) {
-            send_coin_flip(server_fd, clients, coin_sequence, &coin_sequence_length, addr_len);
+        // Observers see the state as of the end of an iteration
+        if (live && now_ms() >= next_live_ms) {
+            publish_live_state(live, &live_staging, clients, games, pattern_stats, pattern_stats_count,
+                               completed_games, transport.history);
+            next_live_ms = now_ms() + LIVE_PUBLISH_INTERVAL_MS;
         }
     }
 
+    for (int g = 0; g < MAX_GAMES && transport.shm[g]; g++) {
+        shm_destroy_region(transport.shm[g], port, g);
+    }
+    if (transport.history) {
+        history_close(transport.history);
+    }
+    if (live) {
+        live_destroy(live, port);
+    }
+    if (admin_fd >= 0) {
+        close(admin_fd);
+    }
+    advisor_free(&advisor);
     close(server_fd);
     return 0;
 }
+#endif // SERVER_EMBEDDED
 
 // Function to initialize client array
 void initialize_clients(ClientInfo clients[]) {
@@ -178,6 +732,15 @@ void initialize_clients(ClientInfo clients[]) {
         clients[i].registered = 0;
         clients[i].has_won = 0;
         clients[i].currently_playing = 0;
+        clients[i].game = -1;
+        clients[i].reliable = 0;
+        clients[i].multicast = 0;
+        clients[i].shared_memory = 0;
+        clients[i].home_game = 0;
+        clients[i].timing = 0;
+        memset(clients[i].pending, 0, sizeof(clients[i].pending));
+        clients[i].backlog_count = 0;
+        memset(&clients[i].outbound, 0, sizeof(clients[i].outbound));
     }
 }
 
@@ -191,110 +754,289 @@ int find_client_index(ClientInfo clients[], uint8_t client_id) {
     return -1;
 }
 
-// Function to register a new client
-void register_client(int server_fd, ClientInfo clients[], struct sockaddr_in client_addr, uint16_t message,
-                     socklen_t addr_len, uint8_t *next_client_id) {
+// Function to pick the lowest client ID (1 to 15) no registered client holds.
+// Slots are freed at runtime (evictions, restore), so IDs are reused rather than counted up:
+// only 4 bits travel on the wire. Returns 0 if every ID is taken.
+uint8_t free_client_id(ClientInfo clients[]) {
+    for (uint8_t id = 1; id <= MAX_CLIENTS; id++) {
+        if (find_client_index(clients, id) == -1) {
+            return id;
+        }
+    }
+    return 0;
+}
+
+// Function to pick the game whose toss group and shared-memory region a new client is
+// offered. Audiences fill one game at a time, so a full table can always meet in one of
+// them; once every game has a table's worth, the smallest audience takes the client.
+int pick_home_game(Transport *transport, ClientInfo clients[], int client_index) {
+    int offered[MAX_GAMES] = {0};
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (i != client_index && clients[i].registered && clients[i].reliable && !clients[i].batched) {
+            offered[clients[i].home_game]++;
+        }
+    }
+    int smallest = 0;
+    for (int g = 0; g < MAX_GAMES; g++) {
+        if (offered[g] < transport->table_size) {
+            return g;
+        }
+        if (offered[g] < offered[smallest]) {
+            smallest = g;
+        }
+    }
+    return smallest;
+}
+
+// Function to register a new client, or every client of a batched REGISTER
+void register_client(Transport *transport, ClientInfo clients[], struct sockaddr_in client_addr, uint16_t message,
+                     uint8_t frame_flags, uint8_t frame_seq, const uint8_t *payload, size_t payload_len) {
     uint8_t message_code, client_id, sequence, pattern_length;
     parse_client_message(message, &message_code, &client_id, &sequence, &pattern_length);
-    
+
+    // Patterns longer than 8 tosses only travel in the payload of an extended REGISTER
+    uint64_t pattern = sequence;
+    int length = pattern_length;
+    if (frame_flags & FRAME_FLAG_PATTERN) {
+        PatternPayload full;
+        if (payload_len < sizeof(full)) {
+            printf("Registration from %s:%d dropped: truncated pattern\n",
+                   inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+            return;
+        }
+        memcpy(&full, payload, sizeof(full));
+        length = full.length;
+        pattern = be64toh(full.pattern);
+        if (length < 1 || length > MAX_PATTERN_LENGTH) {
+            printf("Registration from %s:%d dropped: invalid pattern length %d\n",
+                   inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port), length);
+            return;
+        }
+        pattern &= pattern_length_masks[length];
+    }
+
+    // The other players of a batch follow the first pattern
+    BatchPayload batch;
+    batch.count = 0;
+    if ((frame_flags & FRAME_FLAG_BATCH) && !(frame_flags & FRAME_FLAG_PATTERN)) {
+        frame_flags &= ~FRAME_FLAG_BATCH;
+    }
+    if (frame_flags & FRAME_FLAG_BATCH) {
+        const uint8_t *rest = payload + sizeof(PatternPayload);
+        size_t rest_len = payload_len - sizeof(PatternPayload);
+        if (rest_len < 1 || rest[0] > BATCH_MAX_PATTERNS - 1 || rest_len < BATCH_PAYLOAD_SIZE(rest[0])) {
+            printf("Registration from %s:%d dropped: truncated batch\n",
+                   inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+            return;
+        }
+        memcpy(&batch, rest, BATCH_PAYLOAD_SIZE(rest[0]));
+    }
+
+    if (frame_flags & FRAME_FLAG_RELIABLE) {
+        // A retransmitted registration means our reply was lost: resend it instead of registering twice
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (clients[i].registered && clients[i].reliable && clients[i].rx_seq == frame_seq &&
+                clients[i].address.sin_addr.s_addr == client_addr.sin_addr.s_addr &&
+                clients[i].address.sin_port == client_addr.sin_port &&
+                (clients[i].batch_reply.count > 0) == ((frame_flags & FRAME_FLAG_BATCH) != 0)) {
+                if (clients[i].batch_reply.count > 0) {
+                    send_batch_reply(transport, &clients[i]);
+                } else {
+                    send_registration_reply(transport, &clients[i]);
+                }
+                return;
+            }
+        }
+    }
+
+    int lead = add_client(clients, client_addr, pattern, length, frame_flags, frame_seq);
+    if (lead < 0) {
+        return; // Server full
+    }
+    if (!(frame_flags & FRAME_FLAG_BATCH)) {
+        // Send the client ID to the client, with the toss group and region of its home game
+        clients[lead].home_game = pick_home_game(transport, clients, lead);
+        send_registration_reply(transport, &clients[lead]);
+        return;
+    }
+
+    // One reply names every ID of the batch in request order, 0 where the server ran out of slots
+    BatchReplyPayload *reply = &clients[lead].batch_reply;
+    reply->count = 1 + batch.count;
+    reply->client_ids[0] = clients[lead].client_id;
+    for (int k = 0; k < batch.count; k++) {
+        int member_length = batch.patterns[k].length;
+        int member = -1;
+        if (member_length >= 1 && member_length <= MAX_PATTERN_LENGTH) {
+            uint64_t member_pattern = be64toh(batch.patterns[k].pattern) & pattern_length_masks[member_length];
+            member = add_client(clients, client_addr, member_pattern, member_length, frame_flags, frame_seq);
+        }
+        reply->client_ids[k + 1] = member >= 0 ? clients[member].client_id : 0;
+    }
+    printf("Batch of %d players registered from %s:%d\n", reply->count, inet_ntoa(client_addr.sin_addr),
+           ntohs(client_addr.sin_port));
+    send_batch_reply(transport, &clients[lead]);
+}
+
+// Function to seat a newly registered player in a free slot and queue it for a game.
+// Returns its index, or -1 if the server is full.
+int add_client(ClientInfo clients[], struct sockaddr_in client_addr, uint64_t pattern, int length, uint8_t frame_flags,
+               uint8_t frame_seq) {
+    uint8_t client_id = free_client_id(clients);
+    if (client_id == 0) {
+        return -1;
+    }
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (!clients[i].registered) {
-            clients[i].client_id = (*next_client_id)++;
+            clients[i].client_id = client_id;
             clients[i].address = client_addr;
-            clients[i].pattern = sequence;
-            clients[i].pattern_length = pattern_length; // Use the pattern length from the client
+            clients[i].pattern = pattern;
+            clients[i].pattern_length = length; // Use the pattern length from the client
             clients[i].registered = 1;
             clients[i].has_won = 0;
             clients[i].currently_playing = 1;
+            clients[i].reliable = (frame_flags & FRAME_FLAG_RELIABLE) != 0;
+            clients[i].rx_seq = frame_seq;
+            clients[i].rx_seen = 1;
+            clients[i].tx_seq = 0;
+            clients[i].multicast = 0;
+            clients[i].shared_memory = 0;
+            clients[i].home_game = 0;
+            clients[i].wants_shared_memory = (frame_flags & FRAME_FLAG_SHM) != 0;
+            clients[i].timing = (frame_flags & FRAME_FLAG_TIMING) != 0;
+            clients[i].probe_stamp_us = 0;
+            clients[i].next_probe_ms = 0; // First probe right away
+            clients[i].srtt_us = 0;
+            clients[i].rttvar_us = 0;
+            memset(&clients[i].rtt, 0, sizeof(clients[i].rtt));
+            memset(&clients[i].claim_latency, 0, sizeof(clients[i].claim_latency));
+            memset(&clients[i].claim_hold, 0, sizeof(clients[i].claim_hold));
+            reset_completion(&clients[i]);
+            clients[i].batched = (frame_flags & FRAME_FLAG_BATCH) != 0;
+            memset(&clients[i].batch_reply, 0, sizeof(clients[i].batch_reply));
+            queue_client(&clients[i]);
+            memset(clients[i].pending, 0, sizeof(clients[i].pending));
+            clients[i].backlog_count = 0;
+            memset(&clients[i].outbound, 0, sizeof(clients[i].outbound));
 
             printf("New client registered: %s:%d, assigned ID %d\n",
                    inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port),
                    clients[i].client_id);
             printf("Client ID: %d\n", clients[i].client_id);
             printf("Address: %s:%d\n", inet_ntoa(clients[i].address.sin_addr), ntohs(clients[i].address.sin_port));
-            printf("Pattern: 0x%02X\n", clients[i].pattern);
-            printf("Pattern (exact bits): ");
-            for (int j = 7; j >= 0; j--) {
-                uint8_t bit = (clients[i].pattern >> j) & 0b1;
-                printf("%d", bit);
-            }
-            printf("\n");
+            char scratch[MAX_PATTERN_LENGTH + 1];
+            printf("Pattern: 0x%llX (%s)\n", (unsigned long long)clients[i].pattern,
+                   pattern_display(clients[i].pattern, clients[i].pattern_length, scratch));
 
             printf("Pattern Length: %d\n", clients[i].pattern_length);
             printf("Registered: %d\n", clients[i].registered);
             printf("Has Won: %d\n", clients[i].has_won);
             printf("Currently Playing: %d\n", clients[i].currently_playing);
-
-            // Send the client ID to the client
-            uint16_t id_message = create_server_message(0, MSG_REGISTER, clients[i].client_id);
-            sendto(server_fd, &id_message, sizeof(id_message), 0, (struct sockaddr *)&client_addr, addr_len);
-
-            break;
+            return i;
         }
     }
+    return -1;
 }
 
 // Function to handle messages received from clients
-void handle_client_message(int server_fd, ClientInfo clients[], PatternStats pattern_stats[],
-                           int *pattern_stats_count, uint16_t message,
-                           struct sockaddr_in client_addr, int *game_in_progress, uint8_t coin_sequence[],
-                           int *coin_sequence_length, int *completed_games,
-                           socklen_t addr_len, uint8_t *next_client_id) {
+void handle_client_message(Transport *transport, ClientInfo clients[], PatternStats pattern_stats[],
+                           int *pattern_stats_count, uint16_t message, uint8_t frame_flags, uint8_t frame_seq,
+                           const uint8_t *payload, size_t payload_len,
+                           struct sockaddr_in client_addr, Game games[], int *completed_games) {
     uint8_t message_code, client_id, sequence, pattern_lenght;
     parse_client_message(message, &message_code, &client_id, &sequence, &pattern_lenght);
-    printf("Received message from client ID %d with message code %d\n", client_id, message_code);
 
+    if (frame_flags & FRAME_FLAG_ACK) {
+        // Client acknowledges one of our control messages
+        int client_index = find_client_index(clients, client_id);
+        if (client_index != -1) {
+            handle_ack(transport, &clients[client_index], frame_seq);
+            ClientInfo *client = &clients[client_index];
+            if ((frame_flags & FRAME_FLAG_MULTICAST) && transport->group_addrs && !client->multicast) {
+                client->multicast = 1;
+                printf("Client ID %d joined the toss multicast group of game %d.\n", client_id, client->home_game);
+            }
+            if ((frame_flags & FRAME_FLAG_SHM) && transport->shm[client->home_game] && !client->shared_memory) {
+                client->shared_memory = 1;
+                printf("Client ID %d switched to the shared-memory transport of game %d.\n", client_id,
+                       client->home_game);
+            }
+        }
+        return;
+    }
+
+    if ((frame_flags & FRAME_FLAG_TIMING) && message_code == MSG_ACK) {
+        // Client echoes an RTT probe
+        int client_index = find_client_index(clients, client_id);
+        if (client_index != -1) {
+            handle_probe_echo(&clients[client_index], payload, payload_len);
+        }
+        return;
+    }
+
+    if (frame_flags & FRAME_FLAG_REPAIR) {
+        // Client lost or reordered tosses and asks for a range of them
+        int client_index = find_client_index(clients, client_id);
+        if (client_index != -1 && clients[client_index].game >= 0) {
+            Game *game = &games[clients[client_index].game];
+            send_repair(transport, &clients[client_index], payload, payload_len,
+                        game->coin_sequence, game->coin_sequence_length);
+        }
+        return;
+    }
+
+    printf("Received message from client ID %d with message code %d\n", client_id, message_code);
 
     if (message_code == MSG_REGISTER) {
         // New client registration
-        register_client(server_fd, clients, client_addr, message, addr_len, next_client_id);
+        register_client(transport, clients, client_addr, message, frame_flags, frame_seq,
+                        payload, payload_len);
     } else {
         int client_index = find_client_index(clients, client_id);
+        if (client_index != -1 && (frame_flags & FRAME_FLAG_RELIABLE)) {
+            // Always acknowledge, our previous ACK may have been lost; act only on new frames
+            send_ack(transport, &clients[client_index], message, frame_seq);
+            if (!reliable_seq_accept(&clients[client_index].rx_seq, &clients[client_index].rx_seen, frame_seq)) {
+                printf("Duplicate message from client ID %d ignored\n", client_id);
+                return;
+            }
+        }
         if (client_index != -1) {
             // Handle messages from registered clients
-            if (message_code == MSG_WIN) {
-                // Client claims to have won
-                process_win_claim(server_fd, clients, client_index, coin_sequence, *coin_sequence_length,
-                                  pattern_stats, pattern_stats_count, game_in_progress, completed_games, addr_len);
-            } else if (message_code == MSG_READY) {
-                // Client is ready to play again
+            if (message_code == MSG_WIN && clients[client_index].game >= 0) {
+                // Client claims to have won. Extended clients name the toss that completed
+                // their pattern, so a delayed or retransmitted claim is still judged correctly.
+                Game *game = &games[clients[client_index].game];
+                int claim_length = claim_toss_count(game, frame_flags, sequence);
+                if (frame_flags & FRAME_FLAG_RELIABLE) {
+                    if (game->in_progress) {
+                        record_claim_latency(game, &clients[client_index], frame_flags, payload, payload_len,
+                                             claim_length);
+                    }
+                }
+                process_win_claim(transport, clients, client_index, claim_length,
+                                  game->coin_sequence, game->coin_sequence_length,
+                                  pattern_stats, pattern_stats_count, &game->in_progress, completed_games,
+                                  game->started_us);
+            } else if (message_code == MSG_WIN) {
+                printf("Win claim from client ID %d, which is not in a game\n", client_id);
+            } else if (message_code == MSG_READY && clients[client_index].game < 0) {
+                // Client is ready to play again; the matchmaker deals it into the next free game
                 clients[client_index].currently_playing = 1;
+                clients[client_index].has_won = 0;
+                queue_client(&clients[client_index]);
                 printf("Client ID %d is ready to play again.\n", client_id);
             }
         } else {
             printf("Received message from unknown client ID %d\n", client_id);
         }
     }
-
-    // Check if enough clients are ready to start the game
-    if (!(*game_in_progress)) {
-        int ready_clients = 0;
-        for (int j = 0; j < MAX_CLIENTS; j++) {
-            if (clients[j].registered && clients[j].currently_playing) {
-                ready_clients++;
-            }
-        }
-        printf("Ready clients %d\n", ready_clients);
-        if (ready_clients >= MIN_PLAYERS) {
-            printf("Minimum number of clients ready (%d). Starting game...\n", ready_clients);
-            *game_in_progress = 1;
-            *coin_sequence_length = 0;
-            memset(coin_sequence, 0, sizeof(uint8_t) * 1024);
-
-            // Reset clients' has_won flags at the start of the new game
-            for (int j = 0; j < MAX_CLIENTS; j++) {
-                if (clients[j].registered && clients[j].currently_playing) {
-                    clients[j].has_won = 0;
-                }
-            }
-        }
-    }
 }
 
 // Function to process a win claim from a client
-void process_win_claim(int server_fd, ClientInfo clients[], int client_index,
+void process_win_claim(Transport *transport, ClientInfo clients[], int client_index, int claim_length,
                        uint8_t coin_sequence[], int coin_sequence_length, PatternStats pattern_stats[],
-                       int *pattern_stats_count, int *game_in_progress, int *completed_games, socklen_t addr_len) {
+                       int *pattern_stats_count, int *game_in_progress, int *completed_games, uint64_t started_us) {
     if (clients[client_index].has_won) {
         // Client has already won
         return;
@@ -305,51 +1047,73 @@ void process_win_claim(int server_fd, ClientInfo clients[], int client_index,
            ntohs(clients[client_index].address.sin_port),
            clients[client_index].client_id);
 
-    // Validate the client's claim
+    // Validate the client's claim; the outcome only concerns the players of its game
     int pattern_length = clients[client_index].pattern_length;
-
-    if (coin_sequence_length >= pattern_length) {
-        uint8_t sequence_pattern = 0;
-        for (int i = coin_sequence_length - pattern_length; i < coin_sequence_length; i++) {
-            sequence_pattern = (sequence_pattern << 1) | coin_sequence[i];
-        }
-        printf("Sequnece: 0x%02X    ", sequence_pattern);
-        printf("Sequnece (exact bits): ");
-        for (int i = 7; i >= 0; i--) {
-            uint8_t bit = (sequence_pattern >> (pattern_length -1 - i)) & 0b1;
-            printf("%d", bit);
-        }
-        printf("\n");
-        printf("Clients pattern: 0x%02X    ", clients[client_index].pattern);
-        printf("Clients pattern (exact bits): ");
-        for (int i = 7; i >= 0; i--) {
-            uint8_t bit = (sequence_pattern >> (pattern_length -1 - i)) & 0b1;
-            printf("%d", bit);
-        }
-        printf("\n");
+    int game_index = clients[client_index].game;
+
+    if (claim_length >= pattern_length && claim_length <= coin_sequence_length &&
+        coin_sequence_length - claim_length + pattern_length <= COIN_HISTORY) {
+        uint64_t sequence_pattern = sequence_window(coin_sequence, claim_length, pattern_length);
+        char sequence_scratch[MAX_PATTERN_LENGTH + 1];
+        char pattern_scratch[MAX_PATTERN_LENGTH + 1];
+        printf("Sequence: %s    Clients pattern: %s\n",
+               pattern_display(sequence_pattern, pattern_length, sequence_scratch),
+               pattern_display(clients[client_index].pattern, pattern_length, pattern_scratch));
         if (sequence_pattern == (clients[client_index].pattern)) {
-            // Client's pattern matches the coin sequence
-            printf("Client %s:%d (ID %d) is validated as winner.\n",
-                   inet_ntoa(clients[client_index].address.sin_addr),
-                   ntohs(clients[client_index].address.sin_port),
-                   clients[client_index].client_id);
+            // In fairness mode the game goes to the pattern that completed first, whichever
+            // claim arrived first; patterns completing on the same toss share the win. The
+            // tick engine shares it between the valid claims of one tick naming the same toss.
+            int settle_length = claim_length;
+            if (transport->fair) {
+                if (clients[client_index].completed_at == 0 || clients[client_index].completed_at > claim_length) {
+                    clients[client_index].completed_at = claim_length; // Joined mid-game, trust the validated claim
+                }
+                settle_length = earliest_completion(clients, game_index, claim_length);
+            }
+
+            for (int i = 0; i < MAX_CLIENTS; i++) {
+                int winner = transport->fair
+                                 ? clients[i].registered && clients[i].game == game_index && !clients[i].has_won &&
+                                       clients[i].completed_at == settle_length
+                                 : i == client_index ||
+                                       (transport->tick_engine && clients[i].registered &&
+                                        clients[i].game == game_index && !clients[i].has_won &&
+                                        clients[i].tick_claim == settle_length);
+                if (!winner) {
+                    continue;
+                }
+                // Client's pattern matches the coin sequence
+                printf("Client %s:%d (ID %d) is validated as winner.\n",
+                       inet_ntoa(clients[i].address.sin_addr),
+                       ntohs(clients[i].address.sin_port),
+                       clients[i].client_id);
 
-            clients[client_index].has_won = 1;
+                clients[i].has_won = 1;
 
-            // Update statistics
-            update_pattern_stats(pattern_stats, pattern_stats_count, clients[client_index], coin_sequence_length, 1);
+                // Update statistics
+                update_pattern_stats(pattern_stats, pattern_stats_count, clients[i], settle_length, 1);
+
+                // Send win message to the winner
+                uint16_t win_message = create_server_message(0, MSG_WIN, clients[i].client_id, 0);
+                if (send_control_message(transport, &clients[i], win_message, 0, NULL, 0) < 0) {
+                    printf("Client ID %d: control backlog full, WIN sent once without retransmissions\n",
+                           clients[i].client_id);
+                }
+            }
 
-            // Send win message to the winner
-            uint16_t win_message = create_server_message(0, MSG_WIN, clients[client_index].client_id);
-            sendto(server_fd, &win_message, sizeof(win_message), 0,
-                   (struct sockaddr *)&clients[client_index].address, addr_len);
+            // Winners are marked, the rest of the table has not been told yet: keep the game
+            if (transport->history) {
+                record_game(transport->history, clients, game_index, started_us, settle_length);
+            }
 
-            // Inform all other clients that they have lost
+            // Inform all other clients that they have lost, the claimant too if a rival completed first
             for (int i = 0; i < MAX_CLIENTS; i++) {
-                if (clients[i].registered && i != client_index && !clients[i].has_won && clients[i].currently_playing) {
-                    uint16_t lose_message = create_server_message(0, MSG_LOSE, clients[i].client_id);
-                    sendto(server_fd, &lose_message, sizeof(lose_message), 0,
-                           (struct sockaddr *)&clients[i].address, addr_len);
+                if (clients[i].registered && !clients[i].has_won && clients[i].game == game_index) {
+                    uint16_t lose_message = create_server_message(0, MSG_LOSE, clients[i].client_id, 0);
+                    if (send_control_message(transport, &clients[i], lose_message, 0, NULL, 0) < 0) {
+                        printf("Client ID %d: control backlog full, LOSE sent once without retransmissions\n",
+                               clients[i].client_id);
+                    }
 
                     // Print information about the client who lost
                     printf("Client %s:%d (ID %d) lost.\n",
@@ -360,7 +1124,7 @@ void process_win_claim(int server_fd, ClientInfo clients[], int client_index,
                     clients[i].has_won = 1; // Mark as having finished the game
 
                     // Update statistics for losing client
-                    update_pattern_stats(pattern_stats, pattern_stats_count, clients[i], coin_sequence_length, 0);
+                    update_pattern_stats(pattern_stats, pattern_stats_count, clients[i], settle_length, 0);
                 }
             }
 
@@ -368,10 +1132,11 @@ void process_win_claim(int server_fd, ClientInfo clients[], int client_index,
             *game_in_progress = 0;
             (*completed_games)++;
 
-            // Set currently_playing to 0 for all clients
+            // The players of this game are idle until they send READY again
             for (int i = 0; i < MAX_CLIENTS; i++) {
-                if (clients[i].registered) {
+                if (clients[i].registered && clients[i].game == game_index) {
                     clients[i].currently_playing = 0;
+                    clients[i].game = -1;
                 }
             }
 
@@ -379,9 +1144,8 @@ void process_win_claim(int server_fd, ClientInfo clients[], int client_index,
             print_diagnostics(*completed_games);
             print_statistics(pattern_stats, *pattern_stats_count);
 
-            // Reset the game state
-            memset(coin_sequence, 0, sizeof(uint8_t) * 1024);
-            coin_sequence_length = 0;
+            // Reset the game state (the toss count is reset when the instance starts its next game)
+            memset(coin_sequence, 0, sizeof(uint8_t) * COIN_HISTORY);
 
         } else {
             // Invalid win claim
@@ -399,6 +1163,215 @@ void process_win_claim(int server_fd, ClientInfo clients[], int client_index,
     }
 }
 
+// Function to work out the toss count a WIN names. Extended clients stamp the index of the
+// completing toss; plain ones claim on the tosses sent so far.
+int claim_toss_count(const Game *game, uint8_t frame_flags, uint8_t sequence) {
+    if (frame_flags & FRAME_FLAG_RELIABLE) {
+        return resolve_toss_index(sequence, 0xFF, game->coin_sequence_length) + 1;
+    }
+    return game->coin_sequence_length;
+}
+
+// Function to read the pattern_length tosses ending with toss count claim_length, last toss in bit 0
+uint64_t sequence_window(const uint8_t coin_sequence[], int claim_length, int pattern_length) {
+    uint64_t window = 0;
+    for (int i = claim_length - pattern_length; i < claim_length; i++) {
+        window = (window << 1) | coin_sequence[i % COIN_HISTORY];
+    }
+    return window;
+}
+
+// Function to check a claim the way process_win_claim does, without acting on it
+int claim_matches(const ClientInfo *client, int claim_length, const uint8_t coin_sequence[], int coin_sequence_length) {
+    int pattern_length = client->pattern_length;
+    if (claim_length < pattern_length || claim_length > coin_sequence_length ||
+        coin_sequence_length - claim_length + pattern_length > COIN_HISTORY) {
+        return 0;
+    }
+    return sequence_window(coin_sequence, claim_length, pattern_length) == client->pattern;
+}
+
+// Function to hold a received frame for the end of the tick, classified for apply_tick.
+// Returns 0, or -1 if the frame is too short or the tick is full.
+int tick_enqueue(TickInput *input, const uint8_t *buffer, size_t length, struct sockaddr_in address) {
+    if (input->count == TICK_INPUT_MAX) {
+        return -1;
+    }
+    TickFrame *frame = &input->frames[input->count];
+    if (parse_frame(buffer, length, &frame->message, &frame->flags, &frame->seq, &frame->payload_len) < 0 ||
+        frame->payload_len > sizeof(frame->payload)) {
+        return -1;
+    }
+    memcpy(frame->payload, buffer + (length - frame->payload_len), frame->payload_len);
+    frame->address = address;
+    frame->arrival = input->count;
+    frame->game = -1;
+    frame->claim_length = 0;
+
+    uint8_t message_code, client_id, sequence, pattern_length;
+    parse_client_message(frame->message, &message_code, &client_id, &sequence, &pattern_length);
+    frame->client_id = client_id;
+    if ((frame->flags & (FRAME_FLAG_ACK | FRAME_FLAG_REPAIR)) ||
+        ((frame->flags & FRAME_FLAG_TIMING) && message_code == MSG_ACK)) {
+        frame->kind = TICK_TRANSPORT;
+    } else if (message_code == MSG_REGISTER) {
+        frame->kind = TICK_REGISTER;
+    } else if (message_code == MSG_WIN) {
+        frame->kind = TICK_CLAIM; // Game and toss are filled in when the tick is applied
+    } else {
+        frame->kind = TICK_OTHER;
+    }
+    input->count++;
+    return 0;
+}
+
+// Function to order the frames of a tick by content: kind, then the key of the kind
+int compare_tick_frames(const void *a, const void *b) {
+    const TickFrame *x = a;
+    const TickFrame *y = b;
+    if (x->kind != y->kind) {
+        return x->kind - y->kind;
+    }
+    if (x->kind == TICK_REGISTER) {
+        uint32_t x_host = ntohl(x->address.sin_addr.s_addr), y_host = ntohl(y->address.sin_addr.s_addr);
+        if (x_host != y_host) {
+            return x_host < y_host ? -1 : 1;
+        }
+        if (x->address.sin_port != y->address.sin_port) {
+            return ntohs(x->address.sin_port) - ntohs(y->address.sin_port);
+        }
+        if (x->seq != y->seq) {
+            return x->seq - y->seq;
+        }
+    }
+    if (x->kind == TICK_CLAIM && (x->game != y->game || x->claim_length != y->claim_length)) {
+        return x->game != y->game ? x->game - y->game : x->claim_length - y->claim_length;
+    }
+    if (x->client_id != y->client_id) {
+        return x->client_id - y->client_id;
+    }
+    return x->arrival - y->arrival;
+}
+
+// Function to apply the frames of one tick as a batch. No toss is sent while they are
+// applied, so every claim is judged against the same toss index, and the result does not
+// depend on the order the frames arrived in: claims are taken earliest toss first, and the
+// valid claims naming the winning toss share the win instead of racing for it.
+void apply_tick(Transport *transport, ClientInfo clients[], PatternStats pattern_stats[], int *pattern_stats_count,
+                Game games[], int *completed_games, TickInput *input) {
+    if (input->count == 0) {
+        return;
+    }
+    // Judge every claim before acting on any: a game ended by the first must still see the others
+    for (int f = 0; f < input->count; f++) {
+        TickFrame *frame = &input->frames[f];
+        int client_index = find_client_index(clients, frame->client_id);
+        if (frame->kind != TICK_CLAIM || client_index == -1 || clients[client_index].game < 0) {
+            continue;
+        }
+        ClientInfo *client = &clients[client_index];
+        Game *game = &games[client->game];
+        uint8_t message_code, client_id, sequence, pattern_length;
+        parse_client_message(frame->message, &message_code, &client_id, &sequence, &pattern_length);
+        frame->game = client->game;
+        frame->claim_length = claim_toss_count(game, frame->flags, sequence);
+        if (game->in_progress && !client->has_won &&
+            claim_matches(client, frame->claim_length, game->coin_sequence, game->coin_sequence_length) &&
+            (client->tick_claim == 0 || frame->claim_length < client->tick_claim)) {
+            client->tick_claim = frame->claim_length;
+        }
+    }
+    qsort(input->frames, input->count, sizeof(TickFrame), compare_tick_frames);
+
+    for (int f = 0; f < input->count; f++) {
+        TickFrame *frame = &input->frames[f];
+        handle_client_message(transport, clients, pattern_stats, pattern_stats_count, frame->message, frame->flags,
+                              frame->seq, frame->payload, frame->payload_len, frame->address, games,
+                              completed_games);
+    }
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].tick_claim = 0;
+    }
+    input->applied += input->count;
+    input->ticks++;
+    input->count = 0;
+}
+
+// Function to append a finished game to the history store; its winners are the players marked has_won
+void record_game(HistoryStore *history, ClientInfo clients[], int game_index, uint64_t started_us, int flips) {
+    HistoryGame game;
+    game.started_us = started_us;
+    game.ended_us = wall_us();
+    game.flips = flips;
+    game.player_count = 0;
+    for (int i = 0; i < MAX_CLIENTS && game.player_count < HISTORY_MAX_PLAYERS; i++) {
+        if (clients[i].registered && clients[i].game == game_index) {
+            game.players[game.player_count++] = (HistoryPlayer){clients[i].pattern, clients[i].address.sin_addr.s_addr,
+                                                                clients[i].address.sin_port,
+                                                                (uint8_t)clients[i].pattern_length,
+                                                                (uint8_t)clients[i].has_won};
+        }
+    }
+    if (history_append(history, &game) < 0) {
+        printf("Game history append failed\n");
+    }
+}
+
+// Function to copy the registry, the games and the pattern statistics into the live view
+void publish_live_state(LiveRegion *live, LiveState *staging, ClientInfo clients[], Game games[],
+                        PatternStats pattern_stats[], int pattern_stats_count, int completed_games,
+                        HistoryStore *history) {
+    memset(staging, 0, sizeof(*staging)); // Padding too, unchanged states compare equal
+    staging->completed_games = completed_games;
+    staging->history_games = history ? history_games(history) : 0;
+
+    staging->game_count = MAX_GAMES < LIVE_MAX_GAMES ? MAX_GAMES : LIVE_MAX_GAMES;
+    for (int g = 0; g < (int)staging->game_count; g++) {
+        LiveGame *live_game = &staging->games[g];
+        live_game->in_progress = games[g].in_progress;
+        if (!games[g].in_progress) {
+            continue;
+        }
+        live_game->players = games[g].players;
+        live_game->toss_index = games[g].coin_sequence_length;
+        live_game->started_us = games[g].started_us;
+        int recent = games[g].coin_sequence_length < 64 ? games[g].coin_sequence_length : 64;
+        for (int k = games[g].coin_sequence_length - recent; k < games[g].coin_sequence_length; k++) {
+            live_game->recent_tosses = (live_game->recent_tosses << 1) | games[g].coin_sequence[k % COIN_HISTORY];
+        }
+    }
+
+    for (int i = 0; i < MAX_CLIENTS && staging->player_count < LIVE_MAX_PLAYERS; i++) {
+        if (!clients[i].registered) {
+            continue;
+        }
+        LivePlayer *player = &staging->players[staging->player_count++];
+        player->client_id = clients[i].client_id;
+        player->flags = (clients[i].currently_playing ? LIVE_PLAYER_PLAYING : 0) |
+                        (clients[i].has_won ? LIVE_PLAYER_WON : 0) |
+                        (clients[i].reliable ? LIVE_PLAYER_RELIABLE : 0) |
+                        (clients[i].multicast ? LIVE_PLAYER_MULTICAST : 0) |
+                        (clients[i].shared_memory ? LIVE_PLAYER_SHM : 0);
+        player->game = clients[i].game;
+        player->pattern = clients[i].pattern;
+        player->pattern_length = clients[i].pattern_length;
+        player->address = clients[i].address.sin_addr.s_addr;
+        player->port = clients[i].address.sin_port;
+        player->srtt_us = clients[i].srtt_us;
+        if (clients[i].currently_playing && clients[i].game < 0) {
+            staging->queued_players++;
+        }
+    }
+
+    for (int j = 0; j < pattern_stats_count && staging->pattern_count < LIVE_MAX_PATTERNS; j++) {
+        staging->patterns[staging->pattern_count++] = (LivePatternStats){
+            pattern_stats[j].pattern, (uint8_t)pattern_stats[j].pattern_length, pattern_stats[j].wins,
+            pattern_stats[j].total_games, pattern_stats[j].total_flips};
+    }
+
+    live_publish(live, staging);
+}
+
 // Function to update pattern statistics
 void update_pattern_stats(PatternStats pattern_stats[], int *pattern_stats_count,
                           ClientInfo client, int coin_sequence_length, int win) {
@@ -415,53 +1388,808 @@ void update_pattern_stats(PatternStats pattern_stats[], int *pattern_stats_count
         }
     }
     if (!found) {
-        // Add new pattern stats
-        pattern_stats[*pattern_stats_count].pattern = client.pattern;
-        pattern_stats[*pattern_stats_count].pattern_length = client.pattern_length;
-        pattern_stats[*pattern_stats_count].wins = win ? 1 : 0;
-        pattern_stats[*pattern_stats_count].total_flips = coin_sequence_length;
-        pattern_stats[*pattern_stats_count].total_games = 1;
-        (*pattern_stats_count)++;
+        // Add new pattern stats, replacing the least-played pattern once the table is full
+        int j = *pattern_stats_count;
+        if (j < MAX_PATTERN_STATS) {
+            (*pattern_stats_count)++;
+        } else {
+            j = 0;
+            for (int k = 1; k < MAX_PATTERN_STATS; k++) {
+                if (pattern_stats[k].total_games < pattern_stats[j].total_games) {
+                    j = k;
+                }
+            }
+        }
+        pattern_stats[j].pattern = client.pattern;
+        pattern_stats[j].pattern_length = client.pattern_length;
+        pattern_stats[j].wins = win ? 1 : 0;
+        pattern_stats[j].total_flips = coin_sequence_length;
+        pattern_stats[j].total_games = 1;
     }
 }
 
 // Function to send a coin flip to clients
-void send_coin_flip(int server_fd, ClientInfo clients[], uint8_t coin_sequence[],
-                    int *coin_sequence_length, socklen_t addr_len) {
+void send_coin_flip(Transport *transport, ClientInfo clients[], Game games[], int game_index, RngHealth *health) {
+    Game *game = &games[game_index];
     // Generate a random bit (0 or 1)
     uint8_t rand_bit = rand() % 2;
+    // The health tests run once every 64 tosses; an alert is logged when a test starts failing
+    if (rng_health_add(health, rand_bit)) {
+        char summary[BUFFER_SIZE];
+        rng_health_describe(health, summary, sizeof(summary));
+        printf("RNG health alert: %s\n", summary);
+    }
     char coin_flip_char = rand_bit ? '1' : '0'; // Use '0' and '1'
-    // Append the coin flip to the coin sequence
-    coin_sequence[(*coin_sequence_length)++] = rand_bit;
-
-    // Send the coin flip to all clients who are currently playing
+    // Append the coin flip to the coin sequence; its index is stamped on the message
+    uint8_t toss_index = game->coin_sequence_length & 0xFF;
+    game->coin_sequence[game->coin_sequence_length % COIN_HISTORY] = rand_bit;
+    game->toss_sent_us[game->coin_sequence_length % COIN_HISTORY] = now_us();
+    game->coin_sequence_length++;
+
+    // Tosses shared by a whole audience (the game's shared-memory ring or multicast group) go out
+    // once. A player seated outside its home game gets them like any unicast player.
+    uint16_t broadcast = create_server_message(rand_bit, MSG_TOSSING, 0, toss_index);
+    int shm_sent = 0, multicast_sent = 0;
+
+    // Send the coin flip to all clients who are playing this game
+    int order[MAX_CLIENTS];
+    int unicast_count = 0;
     for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].registered && clients[i].currently_playing) {
-            uint16_t message = create_server_message(rand_bit, MSG_TOSSING, clients[i].client_id);
-            sendto(server_fd, &message, sizeof(message), 0,
-                   (struct sockaddr *)&clients[i].address, addr_len);
+        if (!clients[i].registered || !clients[i].currently_playing || clients[i].game != game_index) {
+            continue;
+        }
+        // Follow every pattern on the server too, so wins can be settled on the toss index
+        ClientInfo *client = &clients[i];
+        client->toss_window = ((client->toss_window << 1) | rand_bit) & pattern_length_masks[client->pattern_length];
+        client->window_tosses++;
+        if (!client->completed_at && client->window_tosses >= client->pattern_length &&
+            client->toss_window == client->pattern) {
+            client->completed_at = game->coin_sequence_length;
         }
-    }
-    // Print the coin flip in 'H' or 'T'
-    //char coin_display = (coin_flip_char == '0') ? 'H' : 'T';
-    //printf("Coin flip: %c\n", coin_display);
-}
 
-// Function to create a server message according to the ALP protocol
-uint16_t create_server_message(uint8_t toss, uint8_t message_code, uint8_t client_id) {
-    uint16_t message = 0;
-    // Transmitter flag is 1 (server)
-    message |= 1 << BIT_TRANSMITTER;
-    // Set toss bit
+        int home = clients[i].home_game == game_index;
+        if (clients[i].shared_memory && home) {
+            if (!shm_sent) {
+                shm_publish(transport->shm[game_index], &broadcast, sizeof(broadcast));
+                shm_sent = 1;
+            }
+        } else if (clients[i].multicast && home) {
+            if (!multicast_sent) {
+                // A group toss that does not fit is dropped; players repair the gap
+                if (send_datagram(transport, &transport->group_addrs[game_index], &broadcast, sizeof(broadcast)) != 0) {
+                    transport->dropped++;
+                }
+                multicast_sent = 1;
+            }
+        } else {
+            order[unicast_count++] = i;
+        }
+    }
+    // Batched players behind one address share a frame, sent to the first of them in the order
+    uint16_t shared_players[MAX_CLIENTS];
+    for (int k = 0; k < unicast_count; k++) {
+        ClientInfo *client = &clients[order[k]];
+        shared_players[k] = 1 << (client->client_id & 0x0F);
+        if (!client->batched) {
+            continue;
+        }
+        for (int j = 0; j < k; j++) {
+            ClientInfo *first = &clients[order[j]];
+            if (first->batched && shared_players[j] && first->address.sin_addr.s_addr == client->address.sin_addr.s_addr &&
+                first->address.sin_port == client->address.sin_port) {
+                shared_players[j] |= shared_players[k];
+                shared_players[k] = 0;
+                break;
+            }
+        }
+    }
+    for (int k = 0; k < unicast_count; k++) {
+        ClientInfo *client = &clients[order[k]];
+        uint16_t message = create_server_message(rand_bit, MSG_TOSSING, client->client_id, toss_index);
+        if (shared_players[k] == 0) {
+            continue; // Rides in another player's frame
+        }
+        if (shared_players[k] == (1 << (client->client_id & 0x0F))) {
+            deliver_frame(transport, client, &message, sizeof(message));
+            continue;
+        }
+        struct __attribute__((packed)) {
+            ControlFrame header;
+            BatchTossPayload shared;
+        } frame = {{message, FRAME_FLAG_BATCH, 0}, {htons(shared_players[k])}};
+        deliver_frame(transport, client, &frame, sizeof(frame));
+    }
+    // Print the coin flip in 'H' or 'T'
+    //char coin_display = (coin_flip_char == '0') ? 'H' : 'T';
+    //printf("Coin flip: %c\n", coin_display);
+}
+
+// Function to find the earliest toss, up to claim_length, that completed a pattern in play
+int earliest_completion(ClientInfo clients[], int game_index, int claim_length) {
+    int earliest = claim_length;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].registered && clients[i].game == game_index && !clients[i].has_won &&
+            clients[i].completed_at > 0 && clients[i].completed_at < earliest) {
+            earliest = clients[i].completed_at;
+        }
+    }
+    return earliest;
+}
+
+// Function to restart the server-side pattern tracking of a client
+void reset_completion(ClientInfo *client) {
+    client->toss_window = 0;
+    client->window_tosses = 0;
+    client->completed_at = 0;
+}
+
+// Function to put a client in the matchmaking queue
+void queue_client(ClientInfo *client) {
+    client->game = -1;
+    client->queued_ms = now_ms();
+}
+
+// Function to set up the matchmaker with the server's seating policy
+void initialize_matchmaker(Matchmaker *matchmaker, int table_size) {
+    memset(matchmaker, 0, sizeof(*matchmaker));
+    matchmaker->table_size = table_size;
+    matchmaker->wait_ms = MATCH_WAIT_MS;
+    matchmaker->mix_ms = MATCH_MIX_MS;
+}
+
+// Function to deal queued players into free game instances, runs once per loop iteration.
+// Returns the number of games started.
+int run_matchmaker(Matchmaker *matchmaker, ClientInfo clients[], Game games[]) {
+    long long now = now_ms();
+
+    // A game whose players all left (evicted, dropped on restore) frees its instance
+    for (int g = 0; g < MAX_GAMES; g++) {
+        if (!games[g].in_progress) {
+            continue;
+        }
+        int members = 0;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            members += clients[i].registered && clients[i].game == g;
+        }
+        if (members == 0) {
+            printf("Game %d abandoned after %d flips\n", g, games[g].coin_sequence_length);
+            games[g].in_progress = 0;
+        }
+    }
+
+    // Queue, oldest first
+    int queued[MAX_CLIENTS];
+    int queued_count = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!clients[i].registered || !clients[i].currently_playing || clients[i].game >= 0) {
+            continue;
+        }
+        int k = queued_count++;
+        while (k > 0 && clients[queued[k - 1]].queued_ms > clients[i].queued_ms) {
+            queued[k] = queued[k - 1];
+            k--;
+        }
+        queued[k] = i;
+    }
+
+    int started = 0;
+    for (int g = 0; g < MAX_GAMES && queued_count >= MIN_PLAYERS; g++) {
+        if (games[g].in_progress) {
+            continue;
+        }
+        int table[MAX_CLIENTS];
+        int seats = form_table(matchmaker, clients, queued, queued_count, g, now, table);
+        if (seats == 0) {
+            continue;
+        }
+        start_game(matchmaker, clients, games, g, table, seats, now);
+        started++;
+
+        // Seated players leave the queue
+        int kept = 0;
+        for (int k = 0; k < queued_count; k++) {
+            if (clients[queued[k]].game < 0) {
+                queued[kept++] = queued[k];
+            }
+        }
+        queued_count = kept;
+    }
+    return started;
+}
+
+// Function to pick a table for a free game. The oldest player that can start a table
+// anchors it; it is joined by players with the same pattern length (any length once
+// someone waited mix_ms), closest in RTT first. A full table starts at once, a short
+// one when its anchor has waited wait_ms. Returns the number of seats, 0 to keep waiting.
+int form_table(Matchmaker *matchmaker, ClientInfo clients[], int queued[], int queued_count, int game_index,
+               long long now, int table[]) {
+    for (int a = 0; a < queued_count; a++) {
+        ClientInfo *anchor = &clients[queued[a]];
+        // Multicast and shared-memory players share their home game's toss stream
+        if ((anchor->multicast || anchor->shared_memory) && anchor->home_game != game_index) {
+            continue;
+        }
+        int anchor_mixes = now - anchor->queued_ms >= matchmaker->mix_ms;
+
+        int candidates[MAX_CLIENTS];
+        int candidate_count = 0;
+        for (int k = 0; k < queued_count; k++) {
+            ClientInfo *client = &clients[queued[k]];
+            if (k == a || ((client->multicast || client->shared_memory) && client->home_game != game_index)) {
+                continue;
+            }
+            int mixes = anchor_mixes || now - client->queued_ms >= matchmaker->mix_ms;
+            if (client->pattern_length != anchor->pattern_length && !mixes) {
+                continue;
+            }
+            // Insertion by RTT distance to the anchor (unmeasured RTTs count as 0)
+            uint32_t distance = client->srtt_us > anchor->srtt_us ? client->srtt_us - anchor->srtt_us
+                                                                  : anchor->srtt_us - client->srtt_us;
+            int c = candidate_count++;
+            while (c > 0) {
+                ClientInfo *other = &clients[candidates[c - 1]];
+                uint32_t other_distance = other->srtt_us > anchor->srtt_us ? other->srtt_us - anchor->srtt_us
+                                                                           : anchor->srtt_us - other->srtt_us;
+                if (other_distance <= distance) {
+                    break;
+                }
+                candidates[c] = candidates[c - 1];
+                c--;
+            }
+            candidates[c] = queued[k];
+        }
+
+        int seats = 1 + candidate_count;
+        if (seats > matchmaker->table_size) {
+            seats = matchmaker->table_size;
+        }
+        if (seats < MIN_PLAYERS) {
+            continue;
+        }
+        if (seats < matchmaker->table_size && now - anchor->queued_ms < matchmaker->wait_ms) {
+            continue;
+        }
+        table[0] = queued[a];
+        memcpy(table + 1, candidates, (seats - 1) * sizeof(int));
+        return seats;
+    }
+    return 0;
+}
+
+// Function to start a game instance with the given table
+void start_game(Matchmaker *matchmaker, ClientInfo clients[], Game games[], int game_index, int table[],
+                int table_size, long long now) {
+    Game *game = &games[game_index];
+    game->in_progress = 1;
+    game->coin_sequence_length = 0;
+    game->players = table_size;
+    game->started_us = wall_us();
+    memset(game->coin_sequence, 0, sizeof(game->coin_sequence));
+
+    printf("Starting game %d with %d players:", game_index, table_size);
+    for (int k = 0; k < table_size; k++) {
+        ClientInfo *client = &clients[table[k]];
+        client->game = game_index;
+        client->has_won = 0;
+        reset_completion(client);
+        matchmaker->total_wait_ms += now - client->queued_ms;
+        printf(" %d", client->client_id);
+    }
+    printf("\n");
+    matchmaker->players_seated += table_size;
+    matchmaker->games_started++;
+}
+
+// Function to create a server message according to the ALP protocol
+uint16_t create_server_message(uint8_t toss, uint8_t message_code, uint8_t client_id, uint8_t sequence) {
+    uint16_t message = 0;
+    // Transmitter flag is 1 (server)
+    message |= 1 << BIT_TRANSMITTER;
+    // Set toss bit
     message |= (toss & 0b1) << BIT_TOSS;
     // Set message code in bits 13-12
     message |= (message_code & 0b11) << BITS_MESSAGE;
     // Set client ID in bits 11-8
     message |= (client_id & 0b1111) << BITS_CLIENT_ID;
-    // Bits 7-0 are unused
+    // Set toss sequence in bits 7-0
+    message |= (sequence & 0xFF) << BITS_SEQUENCE;
     return htons(message); // Convert to network byte order
 }
 
+// Function to send a control message (REGISTER reply, WIN, LOSE) to a client.
+// Clients that speak extended frames get it reliably: it is kept in a pending
+// slot and retransmitted with backoff until acknowledged. While the window is
+// full it waits in the client's backlog. Returns -1 if the backlog is full too:
+// the message then goes out once, without retransmissions.
+int send_control_message(Transport *transport, ClientInfo *client, uint16_t message, uint8_t flags,
+                         const void *payload, size_t payload_len) {
+    if (!client->reliable) {
+        deliver_frame(transport, client, &message, sizeof(message));
+        return 0;
+    }
+
+    PendingControl control;
+    memset(&control, 0, sizeof(control));
+    if (payload_len > CONTROL_PAYLOAD_MAX) {
+        payload_len = CONTROL_PAYLOAD_MAX;
+    }
+    control.message = message;
+    control.flags = flags;
+    if (payload_len > 0) {
+        memcpy(control.payload, payload, payload_len);
+    }
+    control.payload_len = payload_len;
+
+    if (client->backlog_count == CONTROL_BACKLOG) {
+        // Sent once without a sequence number, so it cannot move the client's receive window
+        uint8_t buffer[sizeof(ControlFrame) + CONTROL_PAYLOAD_MAX];
+        ControlFrame frame = {message, flags, 0};
+        memcpy(buffer, &frame, sizeof(frame));
+        memcpy(buffer + sizeof(frame), control.payload, payload_len);
+        deliver_frame(transport, client, buffer, sizeof(frame) + payload_len);
+        return -1;
+    }
+    client->backlog[client->backlog_count++] = control;
+    admit_backlog(transport, client);
+    return 0;
+}
+
+// Function to move control messages waiting for the window into free slots, oldest first.
+// The window spans sequence numbers: nothing goes out RELIABLE_WINDOW or more past the oldest unacknowledged one.
+void admit_backlog(Transport *transport, ClientInfo *client) {
+    uint8_t oldest = client->tx_seq + 1; // With nothing in flight the next message opens the window
+    int oldest_age = -1;
+    for (int i = 0; i < RELIABLE_WINDOW; i++) {
+        int age = (uint8_t)(client->tx_seq - client->pending[i].seq);
+        if (client->pending[i].active && age > oldest_age) {
+            oldest = client->pending[i].seq;
+            oldest_age = age;
+        }
+    }
+    for (int i = 0; i < RELIABLE_WINDOW && client->backlog_count > 0; i++) {
+        PendingControl *slot = &client->pending[i];
+        if (slot->active) {
+            continue;
+        }
+        if (!reliable_seq_fits(oldest, client->tx_seq + 1)) {
+            break;
+        }
+        *slot = client->backlog[0];
+        client->backlog_count--;
+        memmove(client->backlog, client->backlog + 1, client->backlog_count * sizeof(PendingControl));
+        slot->active = 1;
+        slot->seq = ++client->tx_seq;
+        slot->attempts = 1;
+        slot->backoff_ms = RETRANSMIT_INITIAL_MS;
+        slot->deadline_ms = now_ms() + slot->backoff_ms;
+
+        transmit_pending(transport, client, slot);
+    }
+}
+
+// Function to put a pending control message on the wire
+void transmit_pending(Transport *transport, ClientInfo *client, PendingControl *pending) {
+    uint8_t buffer[sizeof(ControlFrame) + CONTROL_PAYLOAD_MAX];
+    ControlFrame frame = {pending->message, FRAME_FLAG_RELIABLE | pending->flags, pending->seq};
+    memcpy(buffer, &frame, sizeof(frame));
+    memcpy(buffer + sizeof(frame), pending->payload, pending->payload_len);
+    deliver_frame(transport, client, buffer, sizeof(frame) + pending->payload_len);
+}
+
+// Function to send a client its ID. Extended clients also learn their home game's toss
+// group in multicast mode and, if they asked for it, its shared-memory region.
+// Optional payloads follow the frame header in the order of their flag bits.
+void send_registration_reply(Transport *transport, ClientInfo *client) {
+    uint16_t id_message = create_server_message(0, MSG_REGISTER, client->client_id, 0);
+    uint8_t payload[CONTROL_PAYLOAD_MAX];
+    size_t payload_len = 0;
+    uint8_t flags = 0;
+
+    if (client->reliable && transport->group_addrs) {
+        struct sockaddr_in *group_addr = &transport->group_addrs[client->home_game];
+        MulticastPayload group = {group_addr->sin_addr.s_addr, group_addr->sin_port};
+        memcpy(payload + payload_len, &group, sizeof(group));
+        payload_len += sizeof(group);
+        flags |= FRAME_FLAG_MULTICAST;
+    }
+    if (client->reliable && client->wants_shared_memory && transport->shm[client->home_game]) {
+        ShmOfferPayload offer = {htons(transport->port), htons(client->home_game)};
+        memcpy(payload + payload_len, &offer, sizeof(offer));
+        payload_len += sizeof(offer);
+        flags |= FRAME_FLAG_SHM;
+    }
+    if (send_control_message(transport, client, id_message, flags, payload, payload_len) < 0) {
+        // The client retransmits REGISTER until it hears back, and each copy gets the reply again
+        printf("Client ID %d: control backlog full, registration reply sent once\n", client->client_id);
+    }
+}
+
+// Function to send the IDs of a batched registration through the client that led it.
+// Batched players stay on unicast: the reply carries no multicast or shared-memory offer.
+void send_batch_reply(Transport *transport, ClientInfo *lead) {
+    uint16_t id_message = create_server_message(0, MSG_REGISTER, lead->client_id, 0);
+    if (send_control_message(transport, lead, id_message, FRAME_FLAG_BATCH, &lead->batch_reply,
+                             1 + lead->batch_reply.count) < 0) {
+        printf("Client ID %d: control backlog full, batch reply sent once\n", lead->client_id);
+    }
+}
+
+// Function to prepare multicast toss distribution for the given game
+void setup_multicast(Transport *transport, struct sockaddr_in *group_addr, const char *interface, int game_index) {
+    struct in_addr interface_addr;
+    if (inet_pton(AF_INET, interface, &interface_addr) <= 0) {
+        printf("Invalid multicast interface address %s\n", interface);
+        exit(EXIT_FAILURE);
+    }
+    if (setsockopt(transport->server_fd, IPPROTO_IP, IP_MULTICAST_IF, &interface_addr, sizeof(interface_addr)) < 0) {
+        perror("Multicast interface setup failed");
+        exit(EXIT_FAILURE);
+    }
+    // Keep tosses visible to clients on this host
+    uint8_t loop = 1;
+    setsockopt(transport->server_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    memset(group_addr, 0, sizeof(*group_addr));
+    group_addr->sin_family = AF_INET;
+    group_addr->sin_port = htons(MULTICAST_PORT);
+    inet_pton(AF_INET, MULTICAST_GROUP_BASE, &group_addr->sin_addr);
+    group_addr->sin_addr.s_addr = htonl(ntohl(group_addr->sin_addr.s_addr) + 1 + game_index);
+
+    printf("Multicast tosses of game %d on %s:%d via %s\n", game_index, inet_ntoa(group_addr->sin_addr),
+           MULTICAST_PORT, interface);
+}
+
+// Function to acknowledge a reliable frame received from a client
+void send_ack(Transport *transport, ClientInfo *client, uint16_t message, uint8_t seq) {
+    ControlFrame frame = {message, FRAME_FLAG_ACK, seq};
+    deliver_frame(transport, client, &frame, sizeof(frame));
+}
+
+// Function to hand a frame to the transport used by a client
+void deliver_frame(Transport *transport, ClientInfo *client, const void *frame, size_t length) {
+    if (client->shared_memory) {
+        shm_publish(transport->shm[client->home_game], frame, length);
+        return;
+    }
+    if (transport->sink) {
+        transport->sink(transport->sink_context, &client->address, frame, length);
+        return;
+    }
+
+    // Held frames (tick engine) queue like deferred ones and leave with the next flush
+    OutboundQueue *queue = &client->outbound;
+    int held = transport->hold_output && length <= OUTBOUND_FRAME_MAX;
+    if (queue->count == 0) {
+        if (!held) {
+            int result = send_datagram(transport, &client->address, frame, length);
+            if (result == 0) {
+                return;
+            }
+            if (result < 0) {
+                transport->dropped++; // Hard error, nothing to retry
+                return;
+            }
+        }
+        queue->stalled_since_ms = now_ms();
+    }
+
+    // Queue behind earlier frames; when full the new frame is dropped (tosses get
+    // repaired and control messages retransmitted by their own mechanisms)
+    if (queue->count == OUTBOUND_QUEUE_FRAMES || length > OUTBOUND_FRAME_MAX) {
+        queue->drops++;
+        transport->dropped++;
+        return;
+    }
+    int tail = (queue->head + queue->count) % OUTBOUND_QUEUE_FRAMES;
+    memcpy(queue->frames[tail], frame, length);
+    queue->lengths[tail] = length;
+    queue->count++;
+    if (!held) {
+        transport->queued++;
+    }
+}
+
+// Function to send one datagram without blocking.
+// Returns 0 when sent, 1 when the socket buffer is full and -1 on other errors.
+int send_datagram(Transport *transport, const struct sockaddr_in *address, const void *frame, size_t length) {
+    if (sendto(transport->server_fd, frame, length, 0, (const struct sockaddr *)address, transport->addr_len) >= 0) {
+        return 0;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+        return 1;
+    }
+    return -1;
+}
+
+// Function to check whether any client has frames waiting for the socket
+int outbound_pending(ClientInfo clients[]) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].registered && clients[i].outbound.count > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to drain the per-client queues once the socket is writable (or a tick ends).
+// Clients take turns one frame at a time so a long queue cannot starve the rest; the
+// frames of up to SEND_BATCH turns go to the socket in one sendmmsg().
+void flush_outbound(Transport *transport, ClientInfo clients[]) {
+    struct mmsghdr messages[SEND_BATCH];
+    struct iovec vectors[SEND_BATCH];
+    int owners[SEND_BATCH];
+    while (1) {
+        // Lay out the next turns without taking anything off the queues yet
+        int taken[MAX_CLIENTS] = {0};
+        int count = 0;
+        int progress = 1;
+        while (progress && count < SEND_BATCH) {
+            progress = 0;
+            for (int n = 0; n < MAX_CLIENTS && count < SEND_BATCH; n++) {
+                int i = (transport->flush_start + n) % MAX_CLIENTS;
+                OutboundQueue *queue = &clients[i].outbound;
+                if (!clients[i].registered || taken[i] == queue->count) {
+                    continue;
+                }
+                int slot = (queue->head + taken[i]++) % OUTBOUND_QUEUE_FRAMES;
+                vectors[count].iov_base = queue->frames[slot];
+                vectors[count].iov_len = queue->lengths[slot];
+                memset(&messages[count].msg_hdr, 0, sizeof(messages[count].msg_hdr));
+                messages[count].msg_hdr.msg_name = &clients[i].address;
+                messages[count].msg_hdr.msg_namelen = transport->addr_len;
+                messages[count].msg_hdr.msg_iov = &vectors[count];
+                messages[count].msg_hdr.msg_iovlen = 1;
+                owners[count++] = i;
+                progress = 1;
+            }
+        }
+        if (count == 0) {
+            break;
+        }
+
+        int sent = sendmmsg(transport->server_fd, messages, count, 0);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                transport->flush_start = owners[0]; // Socket full, this client goes first next time
+                return;
+            }
+            transport->dropped++; // The first frame failed hard, drop it and go on with the rest
+            sent = 1;
+        }
+        for (int m = 0; m < sent; m++) {
+            OutboundQueue *queue = &clients[owners[m]].outbound;
+            queue->head = (queue->head + 1) % OUTBOUND_QUEUE_FRAMES;
+            queue->count--;
+            queue->stalled_since_ms = now_ms();
+            if (queue->count == 0) {
+                queue->drops = 0; // Drained, the next stall starts counting afresh
+            }
+        }
+        if (sent < count) {
+            transport->flush_start = owners[sent]; // Socket full again
+            return;
+        }
+    }
+    transport->flush_start = (transport->flush_start + 1) % MAX_CLIENTS;
+}
+
+// Function to evict clients whose queue has stopped draining or keeps overflowing
+void evict_slow_clients(Transport *transport, ClientInfo clients[]) {
+    long long now = now_ms();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        OutboundQueue *queue = &clients[i].outbound;
+        if (!clients[i].registered || queue->count == 0) {
+            continue;
+        }
+        if (now - queue->stalled_since_ms < SLOW_PEER_STALL_MS && queue->drops < SLOW_PEER_MAX_DROPS) {
+            continue;
+        }
+        printf("Evicting slow client %d (%d frames queued, %d dropped)\n",
+               clients[i].client_id, queue->count, queue->drops);
+        clients[i].registered = 0;
+        clients[i].currently_playing = 0;
+        clients[i].game = -1;
+        memset(clients[i].pending, 0, sizeof(clients[i].pending));
+        memset(queue, 0, sizeof(*queue));
+        transport->evicted++;
+    }
+}
+
+// Function to split a received frame into the ALP word, frame flags and sequence number.
+// Plain ALP words are best-effort; extended frames carry flags and a payload.
+// Returns -1 if the frame is too short to hold an ALP word.
+int parse_frame(const uint8_t *buffer, size_t length, uint16_t *message, uint8_t *flags, uint8_t *seq, size_t *payload_len) {
+    if (length < sizeof(*message)) {
+        return -1;
+    }
+    memcpy(message, buffer, sizeof(*message));
+    *flags = 0;
+    *seq = 0;
+    *payload_len = 0;
+    if (length >= sizeof(ControlFrame)) {
+        const ControlFrame *frame = (const ControlFrame *)buffer;
+        *flags = frame->flags;
+        *seq = frame->seq;
+        *payload_len = length - sizeof(ControlFrame);
+    }
+    return 0;
+}
+
+// Function to release the pending control message acknowledged by a client
+void handle_ack(Transport *transport, ClientInfo *client, uint8_t seq) {
+    for (int i = 0; i < RELIABLE_WINDOW; i++) {
+        if (client->pending[i].active && client->pending[i].seq == seq) {
+            client->pending[i].active = 0;
+            admit_backlog(transport, client);
+            return;
+        }
+    }
+}
+
+// Function to retransmit unacknowledged control messages whose timer expired
+void service_retransmissions(Transport *transport, ClientInfo clients[]) {
+    long long now = now_ms();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!clients[i].registered || !clients[i].reliable) {
+            continue;
+        }
+        for (int j = 0; j < RELIABLE_WINDOW; j++) {
+            PendingControl *pending = &clients[i].pending[j];
+            if (!pending->active || pending->deadline_ms > now) {
+                continue;
+            }
+            if (pending->attempts >= RETRANSMIT_MAX_ATTEMPTS) {
+                printf("Client ID %d did not acknowledge message %d, giving up.\n",
+                       clients[i].client_id, pending->seq);
+                pending->active = 0;
+                admit_backlog(transport, &clients[i]);
+                continue;
+            }
+            pending->attempts++;
+            pending->backoff_ms *= 2;
+            if (pending->backoff_ms > RETRANSMIT_MAX_MS) {
+                pending->backoff_ms = RETRANSMIT_MAX_MS;
+            }
+            pending->deadline_ms = now + pending->backoff_ms;
+
+            transmit_pending(transport, &clients[i], pending);
+        }
+    }
+}
+
+// Function to probe the RTT of timing clients that are playing, once per interval
+void send_rtt_probes(Transport *transport, ClientInfo clients[]) {
+    long long now = now_ms();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientInfo *client = &clients[i];
+        // Clients between games are not reading, their echo would time the prompt
+        if (!client->registered || !client->timing || !client->currently_playing || now < client->next_probe_ms) {
+            continue;
+        }
+        uint8_t buffer[sizeof(ControlFrame) + sizeof(TimingPayload)];
+        ControlFrame frame = {create_server_message(0, MSG_ACK, client->client_id, 0), FRAME_FLAG_TIMING, 0};
+        client->probe_stamp_us = now_us() | 1; // Never 0, that means no probe outstanding
+        TimingPayload timing = {htonl(client->probe_stamp_us), 0};
+        memcpy(buffer, &frame, sizeof(frame));
+        memcpy(buffer + sizeof(frame), &timing, sizeof(timing));
+        deliver_frame(transport, client, buffer, sizeof(buffer));
+        client->next_probe_ms = now + RTT_PROBE_INTERVAL_MS;
+    }
+}
+
+// Function to take an RTT sample from a probe echo (smoothed as in TCP: gains 1/8 and 1/4)
+void handle_probe_echo(ClientInfo *client, const uint8_t *payload, size_t payload_len) {
+    TimingPayload timing;
+    if (payload_len < sizeof(timing)) {
+        return;
+    }
+    memcpy(&timing, payload, sizeof(timing));
+    uint32_t stamp = ntohl(timing.stamp_us);
+    if (stamp == 0 || stamp != client->probe_stamp_us) {
+        return; // Late echo of an earlier probe, or a duplicate
+    }
+    client->probe_stamp_us = 0;
+    uint32_t elapsed = now_us() - stamp;
+    uint32_t hold = ntohl(timing.hold_us);
+    uint32_t rtt = hold < elapsed ? elapsed - hold : 0;
+
+    latency_record(&client->rtt, rtt);
+    if (client->srtt_us == 0) {
+        client->srtt_us = rtt ? rtt : 1;
+        client->rttvar_us = rtt / 2;
+    } else {
+        uint32_t deviation = rtt > client->srtt_us ? rtt - client->srtt_us : client->srtt_us - rtt;
+        client->rttvar_us = (3 * (uint64_t)client->rttvar_us + deviation) / 4;
+        client->srtt_us = (7 * (uint64_t)client->srtt_us + rtt) / 8;
+    }
+}
+
+// Function to time a WIN against the toss that completed the pattern. A timed
+// WIN also says how much of that the client itself spent before claiming.
+void record_claim_latency(Game *game, ClientInfo *client, uint8_t frame_flags, const uint8_t *payload,
+                          size_t payload_len, int claim_length) {
+    if (claim_length < 1 || claim_length > game->coin_sequence_length ||
+        game->coin_sequence_length - claim_length >= COIN_HISTORY) {
+        return;
+    }
+    uint32_t sent_us = game->toss_sent_us[(claim_length - 1) % COIN_HISTORY];
+    if (sent_us) { // 0: tossed before a restart, not timed in this run
+        latency_record(&client->claim_latency, now_us() - sent_us);
+    }
+    if ((frame_flags & FRAME_FLAG_TIMING) && payload_len >= sizeof(TimingPayload)) {
+        TimingPayload timing;
+        memcpy(&timing, payload, sizeof(timing));
+        latency_record(&client->claim_hold, ntohl(timing.hold_us));
+    }
+}
+
+// Function to map a truncated toss index from the wire to the latest matching
+// absolute index in the current game (-1 if no such toss was sent yet)
+int resolve_toss_index(uint16_t wire_index, uint16_t wire_mask, int coin_sequence_length) {
+    int last = coin_sequence_length - 1;
+    return last - (int)((uint16_t)(last - wire_index) & wire_mask);
+}
+
+// Function to answer a toss repair request with the requested range
+void send_repair(Transport *transport, ClientInfo *client, const uint8_t *payload, size_t payload_len,
+                 uint8_t coin_sequence[], int coin_sequence_length) {
+    if (payload_len < REPAIR_REQUEST_SIZE || coin_sequence_length == 0) {
+        return;
+    }
+    RepairPayload request;
+    memcpy(&request, payload, REPAIR_REQUEST_SIZE);
+
+    int first = resolve_toss_index(ntohs(request.first_toss), 0xFFFF, coin_sequence_length);
+    int count = request.count;
+    if (count > REPAIR_MAX_TOSSES) {
+        count = REPAIR_MAX_TOSSES;
+    }
+    if (first < 0 || first < coin_sequence_length - COIN_HISTORY) {
+        return; // Too old, no longer in the history
+    }
+    if (first + count > coin_sequence_length) {
+        count = coin_sequence_length - first;
+    }
+
+    struct __attribute__((packed)) {
+        ControlFrame header;
+        RepairPayload repair;
+    } frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.header.message = create_server_message(0, MSG_TOSSING, client->client_id, 0);
+    frame.header.flags = FRAME_FLAG_REPAIR;
+    frame.repair.first_toss = htons(first & 0xFFFF);
+    frame.repair.count = count;
+    for (int i = 0; i < count; i++) {
+        if (coin_sequence[(first + i) % COIN_HISTORY]) {
+            frame.repair.bits[i / 8] |= 0x80 >> (i % 8);
+        }
+    }
+    size_t frame_len = sizeof(ControlFrame) + REPAIR_REQUEST_SIZE + (count + 7) / 8;
+    deliver_frame(transport, client, &frame, frame_len);
+}
+
+// Function to read a monotonic clock in milliseconds
+long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Function to get the time in microseconds for latency stamps (wraps every ~71 minutes)
+uint32_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+// Function to get the wall-clock time in microseconds since the epoch (game history timestamps)
+uint64_t wall_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 // Function to parse a client message according to the ALP protocol
 void parse_client_message(uint16_t message, uint8_t *message_code, uint8_t *client_id, uint8_t *sequence, uint8_t *pattern_length)  {
     // Convert message from network byte order to host byte order
@@ -494,6 +2222,27 @@ void print_diagnostics(int completed_games) {
     printf("-------------------\n");
 }
 
+// Function to report packets dropped by the rate limiter since the last report
+void report_rate_limiter(RateLimiter *limiter, unsigned long long *reported_drops) {
+    if (limiter->dropped == *reported_drops) {
+        return;
+    }
+    printf("Rate limiter: dropped %llu packets (%llu total dropped, %llu accepted)\n",
+           limiter->dropped - *reported_drops, limiter->dropped, limiter->allowed);
+    *reported_drops = limiter->dropped;
+}
+
+// Function to report deferred, dropped and evicted traffic since the last report
+void report_outbound(Transport *transport, unsigned long long *reported_losses) {
+    unsigned long long losses = transport->dropped + transport->evicted;
+    if (losses == *reported_losses) {
+        return;
+    }
+    printf("Outbound: %llu sends deferred, %llu frames dropped, %llu clients evicted\n",
+           transport->queued, transport->dropped, transport->evicted);
+    *reported_losses = losses;
+}
+
 // Function to print statistics
 void print_statistics(PatternStats pattern_stats[], int pattern_stats_count) {
     printf("\n--- Statistics ---\n");
@@ -505,9 +2254,9 @@ void print_statistics(PatternStats pattern_stats[], int pattern_stats_count) {
         float win_probability = (float)pattern_stats[j].wins / pattern_stats[j].total_games;
         float average_flips = (float)pattern_stats[j].total_flips / pattern_stats[j].total_games;
 
-        // Convert pattern to displayable format ('H' and 'T')
-        char pattern_display[MAX_PATTERN_LENGTH + 1];
-        uint8_t pattern = pattern_stats[j].pattern;
+        // Displayable format ('H' and 'T') and expected waiting time come from the pattern tables
+        char scratch[MAX_PATTERN_LENGTH + 1];
+        uint64_t pattern = pattern_stats[j].pattern;
         int length = pattern_stats[j].pattern_length;
 
         // Print the exact bit representation of pattern
@@ -521,16 +2270,319 @@ void print_statistics(PatternStats pattern_stats[], int pattern_stats_count) {
 
         // printf("Pattern Length: %d\n", pattern_stats[j].pattern_length);
 
+        printf("Pattern: %s, Wins: %d, Total Games: %d, Win Probability: %.2f, Average Flips: %.2f, Expected Flips Alone: %.0f\n",
+               pattern_display(pattern, length, scratch), pattern_stats[j].wins,
+               pattern_stats[j].total_games, win_probability, average_flips,
+               pattern_expected_wait(pattern, length));
+    }
+    printf("-------------------\n");
+}
+
+// Function to open the admin socket on the loopback interface, -1 if unavailable
+int create_admin_socket(int admin_port) {
+    int admin_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (admin_fd < 0) {
+        perror("Admin socket creation failed");
+        return -1;
+    }
+    struct sockaddr_in admin_addr;
+    memset(&admin_addr, 0, sizeof(admin_addr));
+    admin_addr.sin_family = AF_INET;
+    admin_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    admin_addr.sin_port = htons(admin_port);
+    if (bind(admin_fd, (const struct sockaddr *)&admin_addr, sizeof(admin_addr)) < 0) {
+        perror("Admin bind failed");
+        close(admin_fd);
+        return -1;
+    }
+    printf("Admin interface listening on 127.0.0.1:%d\n", admin_port);
+    return admin_fd;
+}
+
+// Function to answer an admin request. Text commands, one per datagram:
+//   advise <length>   best pattern of that length against the registered patterns
+//   odds              win probabilities of the registered patterns
+//   health            toss source health tests
+//   latency           per-client RTT and toss-to-claim latency (median / 99th percentile)
+//   games             game instances, matchmaking queue and average wait to the first toss
+//   jitter            how late the loop got back to its timed work (percentiles and histogram, us)
+void handle_admin_request(int admin_fd, PatternAdvisor *advisor, ClientInfo clients[], const RngHealth *health,
+                          Game games[], const Matchmaker *matchmaker, HistoryStore *history,
+                          const LatencyHistogram *wakeup_jitter, int low_latency_cpu) {
+    char request[BUFFER_SIZE];
+    char reply[BUFFER_SIZE * 16];
+    struct sockaddr_in admin_client;
+    socklen_t admin_len = sizeof(admin_client);
+    ssize_t length = recvfrom(admin_fd, request, sizeof(request) - 1, MSG_DONTWAIT,
+                              (struct sockaddr *)&admin_client, &admin_len);
+    if (length <= 0) {
+        return;
+    }
+    request[length] = '\0';
+
+    // The table is the registered patterns
+    PatternKey table[MAX_CLIENTS];
+    int table_count = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].registered) {
+            table[table_count].pattern = clients[i].pattern;
+            table[table_count].length = clients[i].pattern_length;
+            table_count++;
+        }
+    }
+
+    int pattern_length;
+    size_t used = 0;
+    char scratch[MAX_PATTERN_LENGTH + 1];
+    if (sscanf(request, "advise %d", &pattern_length) == 1) {
+        Advice advice;
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (table_count == 0) {
+            used = snprintf(reply, sizeof(reply), "error no patterns registered\n");
+        } else if (advisor_best_counter(advisor, table, table_count, pattern_length, &advice) < 0) {
+            used = snprintf(reply, sizeof(reply), "error no counter-pattern of length %d (1 to %d)\n",
+                            pattern_length, ADVISOR_MAX_SEARCH_LENGTH);
+        } else {
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            long micros = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+            used = snprintf(reply, sizeof(reply), "best %s %.4f searched %d %s %ld us\n",
+                            pattern_display(advice.best.pattern, advice.best.length, scratch),
+                            advice.win_probability, advice.candidates,
+                            advice.cached ? "cached" : "computed", micros);
+        }
+    } else if (strncmp(request, "odds", 4) == 0) {
+        PatternKey field[MAX_CLIENTS];
+        double odds[MAX_CLIENTS];
+        int field_count = table_count ? advisor_field_odds(advisor, table, table_count, field, odds) : -1;
+        if (field_count < 0) {
+            used = snprintf(reply, sizeof(reply), "error no patterns registered\n");
+        }
+        for (int i = 0; i < field_count && used < sizeof(reply); i++) {
+            used += snprintf(reply + used, sizeof(reply) - used, "%s %.4f\n",
+                             pattern_display(field[i].pattern, field[i].length, scratch), odds[i]);
+        }
+    } else if (strncmp(request, "health", 6) == 0) {
+        used = rng_health_describe(health, reply, sizeof(reply) - 1);
+        reply[used++] = '\n';
+    } else if (strncmp(request, "latency", 7) == 0) {
+        LatencyHistogram all_claims;
+        memset(&all_claims, 0, sizeof(all_claims));
+        for (int i = 0; i < MAX_CLIENTS && used < sizeof(reply); i++) {
+            const ClientInfo *client = &clients[i];
+            if (!client->registered) {
+                continue;
+            }
+            latency_merge(&all_claims, &client->claim_latency);
+            used += snprintf(reply + used, sizeof(reply) - used,
+                             "client %d srtt %u rttvar %u rtt p50 %u p99 %u n %u claim p50 %u p99 %u n %u hold p50 %u p99 %u n %u\n",
+                             client->client_id, client->srtt_us, client->rttvar_us,
+                             latency_percentile(&client->rtt, 0.5), latency_percentile(&client->rtt, 0.99),
+                             client->rtt.samples,
+                             latency_percentile(&client->claim_latency, 0.5),
+                             latency_percentile(&client->claim_latency, 0.99), client->claim_latency.samples,
+                             latency_percentile(&client->claim_hold, 0.5),
+                             latency_percentile(&client->claim_hold, 0.99), client->claim_hold.samples);
+        }
+        if (used < sizeof(reply)) {
+            used += snprintf(reply + used, sizeof(reply) - used, "all claim p50 %u p99 %u max %u n %u (us)\n",
+                             latency_percentile(&all_claims, 0.5), latency_percentile(&all_claims, 0.99),
+                             all_claims.max_us, all_claims.samples);
+        }
+    } else if (strncmp(request, "games", 5) == 0) {
+        for (int g = 0; g < MAX_GAMES && used < sizeof(reply); g++) {
+            used += snprintf(reply + used, sizeof(reply) - used, "game %d %s players %d flips %d\n", g,
+                             games[g].in_progress ? "playing" : "free", games[g].players,
+                             games[g].coin_sequence_length);
+        }
+        int waiting = 0;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            waiting += clients[i].registered && clients[i].currently_playing && clients[i].game < 0;
+        }
+        if (used < sizeof(reply)) {
+            used += snprintf(reply + used, sizeof(reply) - used,
+                             "queue %d started %llu seated %llu average wait %.1f ms table %d\n", waiting,
+                             matchmaker->games_started, matchmaker->players_seated,
+                             matchmaker->players_seated ? (double)matchmaker->total_wait_ms / matchmaker->players_seated : 0.0,
+                             matchmaker->table_size);
+        }
+    } else if (strncmp(request, "jitter", 6) == 0) {
+        if (low_latency_cpu >= 0) {
+            used = snprintf(reply, sizeof(reply), "mode spin cpu %d", low_latency_cpu);
+        } else {
+            used = snprintf(reply, sizeof(reply), "mode select");
+        }
+        used += snprintf(reply + used, sizeof(reply) - used,
+                         " tick %d p50 %u p90 %u p99 %u p999 %u max %u mean %.1f n %u (us)\n", LOOP_TICK_US,
+                         latency_percentile(wakeup_jitter, 0.5), latency_percentile(wakeup_jitter, 0.9),
+                         latency_percentile(wakeup_jitter, 0.99), latency_percentile(wakeup_jitter, 0.999),
+                         wakeup_jitter->max_us,
+                         wakeup_jitter->samples ? (double)wakeup_jitter->total_us / wakeup_jitter->samples : 0.0,
+                         wakeup_jitter->samples);
+        for (int b = 0; b < LATENCY_BUCKETS && used < sizeof(reply); b++) {
+            if (wakeup_jitter->counts[b]) {
+                used += snprintf(reply + used, sizeof(reply) - used, "bucket %u-%u %u\n", b ? 1u << b : 0,
+                                 (2u << b) - 1, wakeup_jitter->counts[b]);
+            }
+        }
+    } else if (strncmp(request, "history", 7) == 0) {
+        used = history ? describe_history(history, request + 7, reply, sizeof(reply))
+                       : (size_t)snprintf(reply, sizeof(reply), "error no game history\n");
+    } else {
+        used = snprintf(reply, sizeof(reply),
+                        "error unknown command (advise <length> | odds | health | latency | games | jitter | history)\n");
+    }
+    if (used > sizeof(reply)) {
+        used = sizeof(reply);
+    }
+    sendto(admin_fd, reply, used, MSG_DONTWAIT, (struct sockaddr *)&admin_client, admin_len);
+}
+
+// Function to answer a game history query:
+//   history                          games and segments in the store
+//   history pattern <H/T...> [n]     the pattern's last n games (default 1000)
+//   history client <ip:port> [days]  the client's games and wins over the last days (default 7)
+size_t describe_history(HistoryStore *history, const char *request, char *reply, size_t size) {
+    static HistoryGame recent[HISTORY_QUERY_MAX]; // Too large for the stack
+    char text[MAX_PATTERN_LENGTH + 1];
+    char host[32];
+    int port, count = HISTORY_QUERY_GAMES, days = HISTORY_QUERY_DAYS;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (strncmp(request, " pattern", 8) == 0) {
+        uint64_t pattern = 0;
+        int length = sscanf(request, " pattern %64s %d", text, &count) >= 1 ? strlen(text) : 0;
+        if (length == 0) {
+            return snprintf(reply, size, "error expected pattern <H/T...> [count]\n");
+        }
         for (int i = 0; i < length; i++) {
-            uint8_t bit = (pattern >> (length - 1 - i)) & 0b1;
-            // printf("Bit %d: %d\n", i, bit);
-            pattern_display[i] = (bit == 0) ? 'H' : 'T';
+            char c = toupper(text[i]);
+            if (c != 'H' && c != 'T') {
+                return snprintf(reply, size, "error pattern is 1 to %d of 'H'/'T'\n", MAX_PATTERN_LENGTH);
+            }
+            pattern = (pattern << 1) | (c == 'T');
+        }
+        if (count < 1 || count > HISTORY_QUERY_MAX) {
+            return snprintf(reply, size, "error game count is 1 to %d\n", HISTORY_QUERY_MAX);
+        }
+        int found = history_recent_by_pattern(history, pattern, length, recent, count);
+        uint64_t wins = 0, flips = 0;
+        for (int g = 0; g < found; g++) {
+            flips += recent[g].flips;
+            for (int p = 0; p < recent[g].player_count; p++) {
+                HistoryPlayer *player = &recent[g].players[p];
+                if (player->pattern == pattern && player->pattern_length == length && player->won) {
+                    wins++;
+                    break;
+                }
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        long micros = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+        if (found == 0) {
+            return snprintf(reply, size, "pattern %s games 0 %ld us\n", pattern_display(pattern, length, text), micros);
+        }
+        return snprintf(reply, size, "pattern %s games %d wins %llu win rate %.4f average flips %.2f games %llu to %llu %ld us\n",
+                        pattern_display(pattern, length, text), found, (unsigned long long)wins, (double)wins / found,
+                        (double)flips / found, (unsigned long long)recent[found - 1].game_id,
+                        (unsigned long long)recent[0].game_id, micros);
+    }
+    if (strncmp(request, " client", 7) == 0) {
+        struct in_addr address;
+        if (sscanf(request, " client %31[^:]:%d %d", host, &port, &days) < 2 ||
+            inet_pton(AF_INET, host, &address) != 1 || port <= 0 || port > 65535 || days < 1) {
+            return snprintf(reply, size, "error expected client <ip:port> [days]\n");
         }
-        pattern_display[length] = '\0';
+        HistorySummary summary;
+        uint32_t since_s = wall_us() / 1000000 - (uint32_t)days * 86400;
+        history_client_summary(history, address.s_addr, htons(port), since_s, &summary);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        long micros = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+        return snprintf(reply, size, "client %s:%d days %d games %llu wins %llu win rate %.4f %ld us\n", host, port,
+                        days, (unsigned long long)summary.games, (unsigned long long)summary.wins,
+                        summary.games ? (double)summary.wins / summary.games : 0.0, micros);
+    }
+    return snprintf(reply, size, "games %llu segments %d appended %llu\n", (unsigned long long)history_games(history),
+                    history->segment_count, history->appended);
+}
 
-        printf("Pattern: %s, Wins: %d, Total Games: %d, Win Probability: %.2f, Average Flips: %.2f\n",
-               pattern_display, pattern_stats[j].wins,
-               pattern_stats[j].total_games, win_probability, average_flips);
+// Function to write the server state to the checkpoint file (skipped when nothing changed)
+void save_snapshot(Checkpoint *checkpoint, ServerSnapshot *snapshot, ClientInfo clients[], PatternStats pattern_stats[],
+                   int pattern_stats_count, Game games[], int completed_games) {
+    memcpy(snapshot->clients, clients, sizeof(snapshot->clients));
+    memcpy(snapshot->pattern_stats, pattern_stats, sizeof(snapshot->pattern_stats));
+    snapshot->pattern_stats_count = pattern_stats_count;
+    memcpy(snapshot->games, games, sizeof(snapshot->games));
+    snapshot->completed_games = completed_games;
+
+    // Leave out what only means something to this run (monotonic stamps, RTT probes,
+    // latency samples, frames in flight), so an idle server saves an unchanged snapshot.
+    // restore_snapshot starts these afresh.
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientInfo *client = &snapshot->clients[i];
+        client->queued_ms = 0;
+        for (int j = 0; j < RELIABLE_WINDOW; j++) {
+            client->pending[j].deadline_ms = 0;
+        }
+        for (int j = 0; j < CONTROL_BACKLOG; j++) {
+            client->backlog[j].deadline_ms = 0;
+        }
+        memset(&client->outbound, 0, sizeof(client->outbound));
+        client->probe_stamp_us = 0;
+        client->next_probe_ms = 0;
+        client->srtt_us = 0;
+        client->rttvar_us = 0;
+        memset(&client->rtt, 0, sizeof(client->rtt));
+        memset(&client->claim_latency, 0, sizeof(client->claim_latency));
+        memset(&client->claim_hold, 0, sizeof(client->claim_hold));
     }
-    printf("-------------------\n");
-}
\ No newline at end of file
+    for (int g = 0; g < MAX_GAMES; g++) {
+        memset(snapshot->games[g].toss_sent_us, 0, sizeof(snapshot->games[g].toss_sent_us));
+    }
+    checkpoint_save(checkpoint, snapshot);
+}
+
+// Function to restore the server state saved by a previous run.
+// Returns 1 if a snapshot was restored, 0 to start from scratch.
+int restore_snapshot(Checkpoint *checkpoint, ServerSnapshot *snapshot, Transport *transport, ClientInfo clients[],
+                     PatternStats pattern_stats[], int *pattern_stats_count, Game games[], int *completed_games) {
+    if (!checkpoint_restore(checkpoint, snapshot)) {
+        return 0;
+    }
+    memcpy(clients, snapshot->clients, sizeof(snapshot->clients));
+    memcpy(pattern_stats, snapshot->pattern_stats, sizeof(snapshot->pattern_stats));
+    *pattern_stats_count = snapshot->pattern_stats_count;
+    if (*pattern_stats_count < 0 || *pattern_stats_count > MAX_PATTERN_STATS) {
+        *pattern_stats_count = 0;
+    }
+    memcpy(games, snapshot->games, sizeof(snapshot->games));
+    *completed_games = snapshot->completed_games;
+
+    long long now = now_ms();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!clients[i].registered) {
+            continue;
+        }
+        // Shared-memory players are still mapped to the previous run's region, they have to register again
+        if (clients[i].shared_memory) {
+            printf("Client %d used shared memory, dropped on restore\n", clients[i].client_id);
+            clients[i].registered = 0;
+            clients[i].currently_playing = 0;
+            continue;
+        }
+        if (clients[i].home_game < 0 || clients[i].home_game >= MAX_GAMES) {
+            clients[i].home_game = 0;
+        }
+        // Without toss groups the multicast players get their tosses by unicast
+        if (!transport->group_addrs) {
+            clients[i].multicast = 0;
+        }
+        // Unacknowledged control messages go out again right away; RTT is measured afresh
+        for (int j = 0; j < RELIABLE_WINDOW; j++) {
+            clients[i].pending[j].deadline_ms = now;
+        }
+        clients[i].queued_ms = now;
+    }
+    return 1;
+}
@@ -0,0 +1,177 @@
+// shm_transport.c
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm_transport.h"
+
+// Function to build the shared-memory object name of a game
+static void shm_region_name(char *name, int port, int game_index) {
+    snprintf(name, SHM_NAME_MAX, SHM_NAME_FORMAT, port, game_index);
+}
+
+// Function to create (or recreate) the shared-memory region of a game
+ShmGameRegion *shm_create_region(int port, int game_index) {
+    char name[SHM_NAME_MAX];
+    shm_region_name(name, port, game_index);
+    shm_unlink(name); // Drop a region left behind by a previous run
+
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_EXCL, 0666);
+    if (fd < 0) {
+        perror("Shared memory creation failed");
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(ShmGameRegion)) < 0) {
+        perror("Shared memory sizing failed");
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    ShmGameRegion *region = mmap(NULL, sizeof(ShmGameRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        perror("Shared memory mapping failed");
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // Fresh pages are zeroed: ring slots hold no frame, command slot p is free for position p
+    for (uint64_t i = 0; i < SHM_COMMAND_SLOTS; i++) {
+        atomic_store_explicit(&region->commands[i].sequence, i, memory_order_relaxed);
+    }
+    region->ring_slots = SHM_RING_SLOTS;
+    atomic_thread_fence(memory_order_release);
+    region->magic = SHM_MAGIC;
+    return region;
+}
+
+// Function to unmap and remove the region of a game
+void shm_destroy_region(ShmGameRegion *region, int port, int game_index) {
+    char name[SHM_NAME_MAX];
+    shm_region_name(name, port, game_index);
+    munmap(region, sizeof(ShmGameRegion));
+    shm_unlink(name);
+}
+
+// Function to publish a frame to every reader of the broadcast ring (single writer)
+void shm_publish(ShmGameRegion *region, const void *frame, size_t length) {
+    if (length > SHM_FRAME_MAX) {
+        return;
+    }
+    uint64_t index = atomic_load_explicit(&region->head, memory_order_relaxed);
+    ShmSlot *slot = &region->ring[index & (SHM_RING_SLOTS - 1)];
+
+    atomic_store_explicit(&slot->sequence, 2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(slot->data, frame, length);
+    slot->length = length;
+    atomic_store_explicit(&slot->sequence, 2 * index + 2, memory_order_release);
+    atomic_store_explicit(&region->head, index + 1, memory_order_release);
+}
+
+// Function to take the next frame posted by a player.
+// Returns 1 when a frame was copied out, 0 when the queue is empty.
+int shm_command_pop(ShmGameRegion *region, void *frame, size_t *length) {
+    uint64_t position = region->command_head;
+    ShmCommandSlot *slot = &region->commands[position & (SHM_COMMAND_SLOTS - 1)];
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != position + 1) {
+        return 0;
+    }
+    *length = slot->length <= SHM_FRAME_MAX ? slot->length : SHM_FRAME_MAX;
+    memcpy(frame, slot->data, *length);
+    atomic_store_explicit(&slot->sequence, position + SHM_COMMAND_SLOTS, memory_order_release);
+    region->command_head = position + 1;
+    return 1;
+}
+
+// Function to map the region of a game created by a local server.
+// The cursor starts at the current head, older frames are not replayed.
+ShmGameRegion *shm_open_region(int port, int game_index, uint64_t *cursor) {
+    char name[SHM_NAME_MAX];
+    shm_region_name(name, port, game_index);
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    ShmGameRegion *region = mmap(NULL, sizeof(ShmGameRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    if (region->magic != SHM_MAGIC || region->ring_slots != SHM_RING_SLOTS) {
+        munmap(region, sizeof(ShmGameRegion));
+        return NULL;
+    }
+    *cursor = atomic_load_explicit(&region->head, memory_order_acquire);
+    return region;
+}
+
+// Function to read the next frame of the broadcast ring.
+// Returns 1 when a frame was copied out, 0 when there is nothing new and
+// -1 when the reader fell behind and frames were overwritten (the cursor
+// then skips to the oldest frame still available).
+int shm_read(ShmGameRegion *region, uint64_t *cursor, void *frame, size_t *length) {
+    uint64_t head = atomic_load_explicit(&region->head, memory_order_acquire);
+    if (*cursor == head) {
+        return 0;
+    }
+    if (head - *cursor > SHM_RING_SLOTS) {
+        *cursor = head - SHM_RING_SLOTS;
+        return -1;
+    }
+
+    ShmSlot *slot = &region->ring[*cursor & (SHM_RING_SLOTS - 1)];
+    uint64_t expected = 2 * *cursor + 2;
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != expected) {
+        (*cursor)++;
+        return -1;
+    }
+    *length = slot->length <= SHM_FRAME_MAX ? slot->length : SHM_FRAME_MAX;
+    memcpy(frame, slot->data, *length);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != expected) {
+        (*cursor)++; // Overwritten while we copied it
+        return -1;
+    }
+    (*cursor)++;
+    return 1;
+}
+
+// Function to drop every frame published so far
+void shm_skip(ShmGameRegion *region, uint64_t *cursor) {
+    *cursor = atomic_load_explicit(&region->head, memory_order_acquire);
+}
+
+// Function to post a frame to the server (many producers).
+// Returns 1 on success, 0 when the queue is full.
+int shm_command_push(ShmGameRegion *region, const void *frame, size_t length) {
+    if (length > SHM_FRAME_MAX) {
+        return 0;
+    }
+    uint64_t position = atomic_load_explicit(&region->command_tail, memory_order_relaxed);
+    ShmCommandSlot *slot;
+    while (1) {
+        slot = &region->commands[position & (SHM_COMMAND_SLOTS - 1)];
+        uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int64_t diff = (int64_t)(sequence - position);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&region->command_tail, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            position = atomic_load_explicit(&region->command_tail, memory_order_relaxed);
+        }
+    }
+    memcpy(slot->data, frame, length);
+    slot->length = length;
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    return 1;
+}
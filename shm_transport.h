@@ -0,0 +1,64 @@
+// shm_transport.h
+//
+// Shared-memory transport for players running on the server's host.
+//
+// Each game owns one mmap'd region. The server publishes every frame meant
+// for co-located players (tosses, control messages, ACKs, repairs) into a
+// broadcast ring; each reader keeps its own cursor and filters on the client
+// ID in the ALP word. Players post their frames (WIN, READY, ACK, REPAIR)
+// through a lock-free multi-producer command queue drained by the server.
+// Frames have exactly the same layout as UDP datagrams.
+
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define SHM_NAME_FORMAT   "/pen-%d-game-%d" // Server port, game index
+#define SHM_NAME_MAX      32
+#define SHM_MAGIC         0x50454E31 // "PEN1"
+#define SHM_RING_SLOTS    4096 // Power of two
+#define SHM_COMMAND_SLOTS 1024 // Power of two
+#define SHM_FRAME_MAX     32
+
+// Broadcast ring slot, guarded by its own sequence counter: odd while the
+// server writes it, 2 * index + 2 once frame number index is published.
+typedef struct {
+    _Atomic uint64_t sequence;
+    uint8_t length;
+    uint8_t data[SHM_FRAME_MAX];
+} ShmSlot;
+
+// Command queue slot (bounded MPSC queue): free for position p when
+// sequence == p, holds the frame for position p when sequence == p + 1.
+typedef struct {
+    _Atomic uint64_t sequence;
+    uint8_t length;
+    uint8_t data[SHM_FRAME_MAX];
+} ShmCommandSlot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t ring_slots;
+    _Alignas(64) _Atomic uint64_t head;         // Frames published by the server
+    ShmSlot ring[SHM_RING_SLOTS];
+    _Alignas(64) _Atomic uint64_t command_tail; // Next position claimed by a producer
+    _Alignas(64) uint64_t command_head;         // Next position consumed by the server
+    ShmCommandSlot commands[SHM_COMMAND_SLOTS];
+} ShmGameRegion;
+
+// Server side
+ShmGameRegion *shm_create_region(int port, int game_index);
+void shm_destroy_region(ShmGameRegion *region, int port, int game_index);
+void shm_publish(ShmGameRegion *region, const void *frame, size_t length);
+int shm_command_pop(ShmGameRegion *region, void *frame, size_t *length);
+
+// Client side
+ShmGameRegion *shm_open_region(int port, int game_index, uint64_t *cursor);
+int shm_read(ShmGameRegion *region, uint64_t *cursor, void *frame, size_t *length);
+void shm_skip(ShmGameRegion *region, uint64_t *cursor);
+int shm_command_push(ShmGameRegion *region, const void *frame, size_t length);
+
+#endif // SHM_TRANSPORT_H
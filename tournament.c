@@ -0,0 +1,877 @@
+// tournament.c
+//
+// Penney's tournament runner. Builds the real server logic (server.c without
+// its main, like turbo.c) and plays every match of a single-elimination
+// bracket or of a Swiss event at a table of its own: both players register,
+// ready up, follow the tosses and claim through handle_client_message,
+// send_coin_flip and process_win_claim, and the WINs the table sends back
+// decide the games. Tables run in fairness mode, so patterns completing on
+// the same toss share the game and it is replayed.
+//
+// Matches are played on worker threads. A bracket match is queued as soon
+// as both of its players are known, not when its round is over, so the
+// event takes the time of its longest chain of matches rather than the sum
+// of them. Swiss rounds are paired from the standings, so each round waits
+// for the previous one. Player and pattern standings are updated as every
+// match completes.
+//
+// Usage: ./tournament [-n players] [-l length] [-g games_per_match] [-s swiss_rounds]
+//                     [-t threads] [-S seed] [pattern ...]
+// Players get random patterns of the given length (default 3) unless
+// patterns are listed, which are dealt out in turn. Every match draws its
+// tosses from a stream seeded by its place in the event, so results do not
+// depend on the thread count or on scheduling.
+
+#define _GNU_SOURCE // As server.c, which is included below
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Random bit source of a table (xoshiro256**), reseeded for every match
+typedef struct {
+    uint64_t state[4];
+    uint64_t bits;      // Unused random bits
+    int bits_left;
+} RandomStream;
+
+// Tables share the server code but not its globals: the tosses of a table come
+// from its match's stream instead of rand(), and its logging is compiled out
+// (workers would otherwise queue up on the stdout lock)
+static __thread RandomStream *table_stream;
+static int table_rand(void);
+static int table_log(const char *format, ...);
+#define rand table_rand
+#define printf table_log
+#define SERVER_EMBEDDED
+#include "server.c"
+#undef rand
+#undef printf
+
+#define TOURNAMENT_MAX_PLAYERS (1 << 18)
+#define TOURNAMENT_GAMES 3           // Best of three by default
+#define TOURNAMENT_GAME_LIMIT 4      // A match undecided after this many times its length goes to a coin toss
+#define TOURNAMENT_PATTERN_ROWS 16384 // Pattern standings (open addressing), power of two
+#define TOURNAMENT_LEADERS 10        // Players listed in the final standings
+#define TOURNAMENT_PATTERNS_SHOWN 16
+
+// Structure to hold a player and its standing, updated as its matches complete
+typedef struct {
+    uint64_t pattern;
+    int pattern_length;
+    int match_wins;
+    int match_losses;
+    int byes;
+    int game_wins;
+    int game_losses;
+} PlayerRecord;
+
+// Structure to hold the standing of one pattern over all players using it
+typedef struct {
+    uint64_t pattern;
+    int pattern_length; // 0 for an empty row
+    int players;
+    unsigned long long matches;
+    unsigned long long match_wins;
+    unsigned long long games;
+    unsigned long long shared_games; // Counted in games, but neither seat won them
+    unsigned long long game_wins;
+    unsigned long long tosses;
+} PatternRecord;
+
+// Structure to hold one match. In a bracket, match k (1 is the final) is fed by
+// matches 2k and 2k+1; entries from the bracket size up stand for the players.
+typedef struct {
+    int players[2];     // Player indices, -1 for nobody (a bye)
+    int arrived;        // Bracket: feeders that have delivered their winner
+    int winner;         // Seat 0 or 1 once played, -1 before
+    int games;
+    int shared_games;   // Both patterns completed on the same toss
+    int mirror;         // Both players hold the same pattern, decided by one toss
+    int game_wins[2];
+    unsigned long long tosses;
+    uint64_t duration_us;
+    uint64_t path_us;   // Longest chain of matches up to and including this one
+} Match;
+
+// Structure to hold the event shared by all workers. Everything below the lock
+// is only touched with it held.
+typedef struct {
+    PlayerRecord *players;
+    int player_count;
+    Match *matches;
+    int bracket_size;   // 0 for a Swiss event
+    int swiss_rounds;
+    int round;          // Swiss: round being played
+    int games_per_match;
+    uint64_t seed;
+    int worker_count;
+    pthread_mutex_t lock;
+    pthread_cond_t match_ready;
+    pthread_cond_t round_done;
+    int *queue;         // Ring of matches ready to play
+    int queue_size;
+    int queue_head;
+    int queue_count;
+    int outstanding;    // Swiss: matches of the round not finished yet
+    int finished;       // No match will be queued again, workers leave
+    int champion;
+    PatternRecord *rows;
+    int row_count;
+    unsigned long long matches_played;
+    unsigned long long byes;
+    unsigned long long games_played;
+    unsigned long long shared_games;
+    unsigned long long mirrors;
+    unsigned long long tosses;
+    uint64_t busy_us;   // Summed match durations
+    uint64_t round_us;  // Swiss: longest match of the round being played
+    uint64_t path_us;   // Swiss: summed longest match of every round
+} Tournament;
+
+// Structure to hold one player at a table: the virtual client of turbo.c
+typedef struct {
+    uint64_t pattern;
+    int pattern_length;
+    uint64_t mask;
+    uint8_t client_id;
+    int registered;
+    uint64_t window;    // Rolling window of the last pattern_length tosses
+    int flips;          // Tosses seen in the current game
+    int claimed;        // WIN sent in the current game
+    int won;            // WIN received in the current game
+} Seat;
+
+// Structure to hold a table: server state, exactly as server.c's main keeps it, for two seats
+typedef struct {
+    ClientInfo clients[MAX_CLIENTS];
+    PatternStats pattern_stats[MAX_PATTERN_STATS];
+    int pattern_stats_count;
+    Game games[MAX_GAMES];
+    int completed_games;
+    Matchmaker matchmaker;
+    RngHealth rng_health;
+    Transport transport;
+    Seat seats[2];
+    uint16_t inbox[2];  // Claims posted during a toss
+    int inbox_seat[2];
+    int inbox_count;
+} Table;
+
+typedef struct {
+    Tournament *tournament;
+    int index;
+} Worker;
+
+// Function to advance a splitmix64 state, used to seed the xoshiro streams
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Function to seed a stream for one match, so results do not depend on scheduling
+static void stream_seed(RandomStream *stream, uint64_t seed, uint64_t match) {
+    uint64_t state = seed ^ (match * 0xD6E8FEB86659FD93ULL);
+    for (int i = 0; i < 4; i++) {
+        stream->state[i] = splitmix64(&state);
+    }
+    stream->bits_left = 0;
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Function to draw 64 random bits (xoshiro256**)
+static inline uint64_t stream_next(RandomStream *stream) {
+    uint64_t *s = stream->state;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// Function to toss one fair coin
+static inline int stream_toss(RandomStream *stream) {
+    if (stream->bits_left == 0) {
+        stream->bits = stream_next(stream);
+        stream->bits_left = 64;
+    }
+    int toss = stream->bits & 1;
+    stream->bits >>= 1;
+    stream->bits_left--;
+    return toss;
+}
+
+// Function standing in for rand() in the server code: a toss of the table's match
+static int table_rand(void) {
+    return stream_toss(table_stream);
+}
+
+// Function standing in for printf() in the server code
+static int table_log(const char *format, ...) {
+    (void)format;
+    return 0;
+}
+
+// Function to build a client ALP word (clients never set the transmitter or toss bits)
+static uint16_t table_client_message(uint8_t message_code, uint8_t client_id, uint8_t sequence) {
+    uint16_t message = (message_code & 0b11) << BITS_MESSAGE;
+    message |= (client_id & 0b1111) << BITS_CLIENT_ID;
+    message |= sequence & 0xFF;
+    return htons(message);
+}
+
+// Function to receive a frame the table sent to one of its seats (Transport sink)
+static void table_sink(void *context, const struct sockaddr_in *address, const void *frame, size_t length) {
+    Table *table = context;
+    int index = ntohs(address->sin_port) - 1;
+    if (index < 0 || index > 1 || length < sizeof(uint16_t)) {
+        return;
+    }
+    Seat *seat = &table->seats[index];
+
+    uint16_t word;
+    memcpy(&word, frame, sizeof(word));
+    word = ntohs(word);
+    uint8_t toss = (word >> BIT_TOSS) & 0b1;
+    uint8_t message_code = (word >> BITS_MESSAGE) & 0b11;
+
+    if (message_code == MSG_REGISTER) {
+        seat->client_id = (word >> BITS_CLIENT_ID) & 0b1111;
+        seat->registered = 1;
+    } else if (message_code == MSG_WIN) {
+        seat->won = 1;
+    } else if (message_code == MSG_TOSSING && !seat->claimed) {
+        // Same O(1) rolling-window check as client.c
+        seat->window = ((seat->window << 1) | toss) & seat->mask;
+        seat->flips++;
+        if (seat->flips >= seat->pattern_length && seat->window == seat->pattern) {
+            table->inbox[table->inbox_count] = table_client_message(MSG_WIN, seat->client_id, 0);
+            table->inbox_seat[table->inbox_count++] = index;
+            seat->claimed = 1;
+        }
+    }
+}
+
+// Function to clear a table and seat two players at it. Returns 0, or -1 if the server refused one.
+static int open_table(Table *table, const PlayerRecord *first, const PlayerRecord *second) {
+    initialize_clients(table->clients);
+    table->pattern_stats_count = 0;
+    memset(table->games, 0, sizeof(table->games));
+    table->completed_games = 0;
+    // Both seats play every game together, seated as soon as they are queued
+    initialize_matchmaker(&table->matchmaker, 2);
+    table->matchmaker.wait_ms = 0;
+    table->matchmaker.mix_ms = 0;
+    memset(&table->transport, 0, sizeof(table->transport));
+    table->transport.server_fd = -1;
+    table->transport.addr_len = sizeof(struct sockaddr_in);
+    table->transport.sink = table_sink;
+    table->transport.sink_context = table;
+    table->transport.fair = 1;
+    table->inbox_count = 0;
+
+    // Register both players with their full pattern; the port names the seat
+    const PlayerRecord *players[2] = {first, second};
+    for (int s = 0; s < 2; s++) {
+        Seat *seat = &table->seats[s];
+        memset(seat, 0, sizeof(*seat));
+        seat->pattern = players[s]->pattern;
+        seat->pattern_length = players[s]->pattern_length;
+        seat->mask = PATTERN_MASK(seat->pattern_length);
+
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(s + 1);
+        int short_length = seat->pattern_length < SHORT_PATTERN_LENGTH ? seat->pattern_length : SHORT_PATTERN_LENGTH;
+        uint16_t message = htons((MSG_REGISTER << BITS_MESSAGE) | ((short_length - 1) << 9) | (seat->pattern & 0xFF));
+        PatternPayload full = {seat->pattern_length, htobe64(seat->pattern)};
+        handle_client_message(&table->transport, table->clients, table->pattern_stats, &table->pattern_stats_count,
+                              message, FRAME_FLAG_PATTERN, 0, (const uint8_t *)&full, sizeof(full), address,
+                              table->games, &table->completed_games);
+        if (!seat->registered) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to play one game at a table. Returns the seats that won it (bit 0 and bit 1), 0 if it did not start.
+static int play_table_game(Table *table, unsigned long long *tosses) {
+    // READY queues both seats and the matchmaker deals them into game 0
+    for (int s = 0; s < 2; s++) {
+        Seat *seat = &table->seats[s];
+        seat->window = 0;
+        seat->flips = 0;
+        seat->claimed = 0;
+        seat->won = 0;
+        int client_index = find_client_index(table->clients, seat->client_id);
+        handle_client_message(&table->transport, table->clients, table->pattern_stats, &table->pattern_stats_count,
+                              table_client_message(MSG_READY, seat->client_id, 0), 0, 0, NULL, 0,
+                              table->clients[client_index].address, table->games, &table->completed_games);
+    }
+    run_matchmaker(&table->matchmaker, table->clients, table->games);
+
+    Game *game = &table->games[0];
+    while (game->in_progress) {
+        send_coin_flip(&table->transport, table->clients, table->games, 0, &table->rng_health);
+        (*tosses)++;
+
+        // Claims are handled after the toss, as if they had just arrived
+        for (int f = 0; f < table->inbox_count; f++) {
+            Seat *seat = &table->seats[table->inbox_seat[f]];
+            int client_index = find_client_index(table->clients, seat->client_id);
+            handle_client_message(&table->transport, table->clients, table->pattern_stats,
+                                  &table->pattern_stats_count, table->inbox[f], 0, 0, NULL, 0,
+                                  table->clients[client_index].address, table->games, &table->completed_games);
+        }
+        table->inbox_count = 0;
+    }
+    return table->seats[0].won | table->seats[1].won << 1;
+}
+
+// Function to play a match to its end at the worker's table; the winner is the seat
+// that first takes a majority of games_per_match
+static void play_match(Tournament *tournament, Table *table, Match *match, uint64_t match_key) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RandomStream stream;
+    stream_seed(&stream, tournament->seed, match_key);
+    table_stream = &stream;
+
+    int needed = tournament->games_per_match / 2 + 1;
+    int limit = tournament->games_per_match * TOURNAMENT_GAME_LIMIT;
+    PlayerRecord *first = &tournament->players[match->players[0]];
+    PlayerRecord *second = &tournament->players[match->players[1]];
+    if (first->pattern == second->pattern && first->pattern_length == second->pattern_length) {
+        match->mirror = 1; // Every game would be shared and replayed until the limit
+    } else if (open_table(table, first, second) == 0) {
+        while (match->game_wins[0] < needed && match->game_wins[1] < needed && match->games < limit) {
+            int winners = play_table_game(table, &match->tosses);
+            match->games++;
+            if (winners == 1 || winners == 2) {
+                match->game_wins[winners - 1]++;
+            } else {
+                match->shared_games++; // Replayed
+            }
+        }
+    }
+    if (match->game_wins[0] != match->game_wins[1]) {
+        match->winner = match->game_wins[1] > match->game_wins[0];
+    } else {
+        match->winner = stream_toss(&stream); // Mirror match, or the table refused a player
+    }
+    table_stream = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    match->duration_us = (end.tv_sec - start.tv_sec) * 1000000ULL + (end.tv_nsec - start.tv_nsec) / 1000;
+    match->path_us += match->duration_us;
+}
+
+// Function to find (or add) the standing row of a pattern, NULL if the table is full
+static PatternRecord *pattern_row(Tournament *tournament, uint64_t pattern, int pattern_length) {
+    uint64_t slot = (pattern * 0x9E3779B97F4A7C15ULL + pattern_length) & (TOURNAMENT_PATTERN_ROWS - 1);
+    for (int probe = 0; probe < TOURNAMENT_PATTERN_ROWS; probe++) {
+        PatternRecord *row = &tournament->rows[(slot + probe) & (TOURNAMENT_PATTERN_ROWS - 1)];
+        if (row->pattern_length == 0) {
+            row->pattern = pattern;
+            row->pattern_length = pattern_length;
+            tournament->row_count++;
+            return row;
+        }
+        if (row->pattern == pattern && row->pattern_length == pattern_length) {
+            return row;
+        }
+    }
+    return NULL;
+}
+
+// Function to queue a match for the workers (lock held)
+static void push_match(Tournament *tournament, int match) {
+    tournament->queue[(tournament->queue_head + tournament->queue_count) % tournament->queue_size] = match;
+    tournament->queue_count++;
+    pthread_cond_signal(&tournament->match_ready);
+}
+
+// Function to wait for a match to play. Returns it, or -1 once the event is over.
+static int next_match(Tournament *tournament) {
+    pthread_mutex_lock(&tournament->lock);
+    while (tournament->queue_count == 0 && !tournament->finished) {
+        pthread_cond_wait(&tournament->match_ready, &tournament->lock);
+    }
+    int match = -1;
+    if (tournament->queue_count > 0) {
+        match = tournament->queue[tournament->queue_head];
+        tournament->queue_head = (tournament->queue_head + 1) % tournament->queue_size;
+        tournament->queue_count--;
+    }
+    pthread_mutex_unlock(&tournament->lock);
+    return match;
+}
+
+// Function to hand a bracket winner (or nobody, -1) to the match it feeds, and on up
+// through byes. Queues the next match once both of its players are known (lock held).
+static void advance(Tournament *tournament, int node, int winner) {
+    while (node > 1) {
+        Match *parent = &tournament->matches[node / 2];
+        parent->players[node & 1] = winner;
+        if (tournament->matches[node].path_us > parent->path_us) {
+            parent->path_us = tournament->matches[node].path_us;
+        }
+        if (++parent->arrived < 2) {
+            return;
+        }
+        node /= 2;
+        if (parent->players[0] >= 0 && parent->players[1] >= 0) {
+            push_match(tournament, node);
+            return;
+        }
+        // A bye: whoever is there goes up without playing
+        winner = parent->players[0] >= 0 ? parent->players[0] : parent->players[1];
+        if (winner >= 0) {
+            tournament->players[winner].byes++;
+            tournament->byes++;
+        }
+    }
+    tournament->champion = winner;
+    tournament->path_us = tournament->matches[1].path_us;
+    tournament->finished = 1;
+    pthread_cond_broadcast(&tournament->match_ready);
+}
+
+// Function to fold a played match into the standings and schedule what it unlocks (lock held)
+static void finish_match(Tournament *tournament, int index) {
+    Match *match = &tournament->matches[index];
+    for (int s = 0; s < 2; s++) {
+        PlayerRecord *player = &tournament->players[match->players[s]];
+        int won = match->winner == s;
+        player->match_wins += won;
+        player->match_losses += !won;
+        player->game_wins += match->game_wins[s];
+        player->game_losses += match->game_wins[!s];
+        PatternRecord *row = pattern_row(tournament, player->pattern, player->pattern_length);
+        if (row) {
+            row->matches++;
+            row->match_wins += won;
+            row->games += match->games;
+            row->shared_games += match->shared_games;
+            row->game_wins += match->game_wins[s];
+            row->tosses += match->tosses;
+        }
+    }
+    tournament->matches_played++;
+    tournament->games_played += match->games;
+    tournament->shared_games += match->shared_games;
+    tournament->mirrors += match->mirror;
+    tournament->tosses += match->tosses;
+    tournament->busy_us += match->duration_us;
+
+    if (tournament->bracket_size) {
+        advance(tournament, index, match->players[match->winner]);
+        return;
+    }
+    if (match->duration_us > tournament->round_us) {
+        tournament->round_us = match->duration_us;
+    }
+    if (--tournament->outstanding == 0) {
+        pthread_cond_signal(&tournament->round_done);
+    }
+}
+
+// Function run by every worker thread, with a table of its own
+static void *worker_main(void *arg) {
+    Worker *worker = arg;
+    Tournament *tournament = worker->tournament;
+    Table *table = calloc(1, sizeof(Table));
+    if (!table) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    rng_health_init(&table->rng_health);
+    int index;
+    while ((index = next_match(tournament)) >= 0) {
+        // Bracket matches are keyed by node, Swiss ones by round and board
+        uint64_t key = tournament->bracket_size ? (uint64_t)index
+                                                : ((uint64_t)(tournament->round + 1) << 32) | (uint64_t)index;
+        play_match(tournament, table, &tournament->matches[index], key);
+        pthread_mutex_lock(&tournament->lock);
+        finish_match(tournament, index);
+        pthread_mutex_unlock(&tournament->lock);
+    }
+    free(table);
+    return NULL;
+}
+
+// Function to deliver every player (and bye) of the first round to the bracket
+static void seed_bracket(Tournament *tournament) {
+    // Players 0 to half-1 take seat 0 of the first-round matches and the rest seat 1,
+    // so byes only happen in the first round
+    int half = tournament->bracket_size / 2;
+    pthread_mutex_lock(&tournament->lock);
+    for (int j = 0; j < half; j++) {
+        int leaf = tournament->bracket_size + 2 * j;
+        advance(tournament, leaf, j < tournament->player_count ? j : -1);
+        advance(tournament, leaf + 1, half + j < tournament->player_count ? half + j : -1);
+    }
+    pthread_mutex_unlock(&tournament->lock);
+}
+
+// Function to compare players in the standings: more match wins (and byes) first, then
+// game difference, then seed. Orders the Swiss pairings and the final table.
+static Tournament *ranking_tournament;
+static int compare_standing(const void *a, const void *b) {
+    const PlayerRecord *x = &ranking_tournament->players[*(const int *)a];
+    const PlayerRecord *y = &ranking_tournament->players[*(const int *)b];
+    int x_points = x->match_wins + x->byes, y_points = y->match_wins + y->byes;
+    if (x_points != y_points) {
+        return y_points - x_points;
+    }
+    int x_games = x->game_wins - x->game_losses, y_games = y->game_wins - y->game_losses;
+    if (x_games != y_games) {
+        return y_games - x_games;
+    }
+    return *(const int *)a - *(const int *)b;
+}
+
+// Function to play a Swiss event: every round pairs neighbours in the standings,
+// avoiding rematches where the next players allow it
+static void run_swiss(Tournament *tournament, int *order, int *opponents) {
+    int count = tournament->player_count;
+    int rounds = tournament->swiss_rounds;
+    char *paired = malloc(count);
+    if (!paired) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < count; i++) {
+            order[i] = i;
+        }
+        ranking_tournament = tournament;
+        qsort(order, count, sizeof(int), compare_standing);
+        memset(paired, 0, (unsigned)count);
+
+        // With an odd field the lowest-ranked player without a bye sits out
+        if (count % 2) {
+            int bye = order[count - 1];
+            for (int i = count - 1; i >= 0; i--) {
+                if (tournament->players[order[i]].byes == 0) {
+                    bye = order[i];
+                    break;
+                }
+            }
+            paired[bye] = 1;
+            opponents[bye * rounds + round] = -1;
+            tournament->players[bye].byes++;
+            tournament->byes++;
+        }
+
+        pthread_mutex_lock(&tournament->lock);
+        tournament->round = round;
+        tournament->round_us = 0;
+        int boards = 0;
+        for (int i = 0; i < count; i++) {
+            int a = order[i];
+            if (paired[a]) {
+                continue;
+            }
+            int b = -1;
+            for (int j = i + 1; j < count; j++) {
+                int candidate = order[j];
+                if (paired[candidate]) {
+                    continue;
+                }
+                if (b < 0) {
+                    b = candidate; // Fallback: the next player, even for a rematch
+                }
+                int met = 0;
+                for (int r = 0; r < round && !met; r++) {
+                    met = opponents[a * rounds + r] == candidate;
+                }
+                if (!met) {
+                    b = candidate;
+                    break;
+                }
+            }
+            paired[a] = paired[b] = 1;
+            opponents[a * rounds + round] = b;
+            opponents[b * rounds + round] = a;
+            Match *match = &tournament->matches[boards];
+            memset(match, 0, sizeof(*match));
+            match->players[0] = a;
+            match->players[1] = b;
+            match->winner = -1;
+            push_match(tournament, boards++);
+        }
+        tournament->outstanding = boards;
+        pthread_cond_broadcast(&tournament->match_ready);
+        while (tournament->outstanding > 0) {
+            pthread_cond_wait(&tournament->round_done, &tournament->lock);
+        }
+        tournament->path_us += tournament->round_us;
+        pthread_mutex_unlock(&tournament->lock);
+    }
+
+    pthread_mutex_lock(&tournament->lock);
+    tournament->finished = 1;
+    pthread_cond_broadcast(&tournament->match_ready);
+    pthread_mutex_unlock(&tournament->lock);
+    free(paired);
+}
+
+// Function to parse an 'H'/'T' pattern, returns -1 if it is invalid
+static int parse_player_pattern(const char *text, PlayerRecord *player) {
+    int length = strlen(text);
+    if (length < 1 || length > MAX_PATTERN_LENGTH) {
+        return -1;
+    }
+    player->pattern = 0;
+    for (int i = 0; i < length; i++) {
+        char c = toupper(text[i]);
+        if (c != 'H' && c != 'T') {
+            return -1;
+        }
+        player->pattern = (player->pattern << 1) | (c == 'T');
+    }
+    player->pattern_length = length;
+    return 0;
+}
+
+// Function to order pattern rows by match win rate, best first
+static int compare_rows(const void *a, const void *b) {
+    const PatternRecord *x = a;
+    const PatternRecord *y = b;
+    double x_rate = x->matches ? (double)x->match_wins / x->matches : -1;
+    double y_rate = y->matches ? (double)y->match_wins / y->matches : -1;
+    return (x_rate < y_rate) - (x_rate > y_rate);
+}
+
+int main(int argc, char *argv[]) {
+    static Tournament tournament;
+    tournament.player_count = 10000;
+    tournament.games_per_match = TOURNAMENT_GAMES;
+    tournament.seed = time(NULL);
+    tournament.worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int length = 3;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:g:s:t:S:")) != -1) {
+        switch (opt) {
+            case 'n':
+                tournament.player_count = atoi(optarg);
+                break;
+            case 'l':
+                length = atoi(optarg);
+                break;
+            case 'g':
+                tournament.games_per_match = atoi(optarg);
+                break;
+            case 's':
+                tournament.swiss_rounds = atoi(optarg);
+                if (tournament.swiss_rounds < 1) {
+                    fprintf(stderr, "Swiss events need at least 1 round\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 't':
+                tournament.worker_count = atoi(optarg);
+                break;
+            case 'S':
+                tournament.seed = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n players] [-l length] [-g games_per_match] [-s swiss_rounds] "
+                                "[-t threads] [-S seed] [pattern ...]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (tournament.player_count < 2 || tournament.player_count > TOURNAMENT_MAX_PLAYERS) {
+        fprintf(stderr, "Players must be 2 to %d\n", TOURNAMENT_MAX_PLAYERS);
+        exit(EXIT_FAILURE);
+    }
+    if (length < 1 || length > MAX_PATTERN_LENGTH || tournament.games_per_match < 1 ||
+        tournament.games_per_match % 2 == 0 || tournament.worker_count < 1) {
+        fprintf(stderr, "Pattern length must be 1 to %d, games per match odd and threads at least 1\n",
+                MAX_PATTERN_LENGTH);
+        exit(EXIT_FAILURE);
+    }
+
+    // Players: the listed patterns in turn, or random ones drawn from the event seed
+    int count = tournament.player_count;
+    tournament.players = calloc(count, sizeof(PlayerRecord));
+    tournament.rows = calloc(TOURNAMENT_PATTERN_ROWS, sizeof(PatternRecord));
+    if (!tournament.players || !tournament.rows) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    RandomStream dealer;
+    stream_seed(&dealer, tournament.seed, ~0ULL);
+    for (int i = 0; i < count; i++) {
+        PlayerRecord *player = &tournament.players[i];
+        if (optind < argc) {
+            const char *text = argv[optind + i % (argc - optind)];
+            if (parse_player_pattern(text, player) < 0) {
+                fprintf(stderr, "Invalid pattern %s (1 to %d of 'H'/'T')\n", text, MAX_PATTERN_LENGTH);
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            player->pattern = stream_next(&dealer) & PATTERN_MASK(length);
+            player->pattern_length = length;
+        }
+        PatternRecord *row = pattern_row(&tournament, player->pattern, player->pattern_length);
+        if (row) {
+            row->players++;
+        }
+    }
+
+    // A bracket holds a match per node of a complete binary tree over the players;
+    // a Swiss round needs a board per pair
+    int *order = NULL;
+    int *opponents = NULL;
+    if (tournament.swiss_rounds) {
+        tournament.matches = calloc(count / 2 + 1, sizeof(Match));
+        tournament.queue_size = count / 2 + 1;
+        order = malloc(count * sizeof(int));
+        opponents = calloc((size_t)count * tournament.swiss_rounds, sizeof(int));
+        if (!order || !opponents) {
+            perror("Allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < count * tournament.swiss_rounds; i++) {
+            opponents[i] = -1; // No opponent yet
+        }
+    } else {
+        tournament.bracket_size = 2;
+        while (tournament.bracket_size < count) {
+            tournament.bracket_size *= 2;
+        }
+        tournament.matches = calloc(2 * tournament.bracket_size, sizeof(Match));
+        tournament.queue_size = tournament.bracket_size;
+        for (int m = 0; tournament.matches && m < tournament.bracket_size; m++) {
+            tournament.matches[m].players[0] = tournament.matches[m].players[1] = -1;
+            tournament.matches[m].winner = -1;
+        }
+    }
+    tournament.queue = malloc(tournament.queue_size * sizeof(int));
+    if (!tournament.matches || !tournament.queue) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&tournament.lock, NULL);
+    pthread_cond_init(&tournament.match_ready, NULL);
+    pthread_cond_init(&tournament.round_done, NULL);
+
+    if (tournament.bracket_size) {
+        printf("Bracket of %d players (%d slots), best of %d, on %d threads (seed %llu)\n", count,
+               tournament.bracket_size, tournament.games_per_match, tournament.worker_count,
+               (unsigned long long)tournament.seed);
+    } else {
+        printf("Swiss event of %d players over %d rounds, best of %d, on %d threads (seed %llu)\n", count,
+               tournament.swiss_rounds, tournament.games_per_match, tournament.worker_count,
+               (unsigned long long)tournament.seed);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t *threads = malloc(tournament.worker_count * sizeof(pthread_t));
+    Worker *workers = malloc(tournament.worker_count * sizeof(Worker));
+    if (!threads || !workers) {
+        perror("Allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int w = 0; w < tournament.worker_count; w++) {
+        workers[w].tournament = &tournament;
+        workers[w].index = w;
+        if (pthread_create(&threads[w], NULL, worker_main, &workers[w]) != 0) {
+            perror("Thread creation failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (tournament.bracket_size) {
+        seed_bracket(&tournament);
+    } else {
+        run_swiss(&tournament, order, opponents);
+    }
+    for (int w = 0; w < tournament.worker_count; w++) {
+        pthread_join(threads[w], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("Matches: %llu (%llu byes, %llu mirrors), Games: %llu (%llu shared and replayed), Tosses: %llu\n",
+           tournament.matches_played, tournament.byes, tournament.mirrors, tournament.games_played, tournament.shared_games,
+           tournament.tosses);
+    printf("Elapsed: %.3f s, longest match path %.3f s, all matches %.3f s (%.1fx overlap)\n", elapsed,
+           tournament.path_us / 1e6, tournament.busy_us / 1e6, elapsed > 0 ? tournament.busy_us / 1e6 / elapsed : 0);
+
+    char scratch[MAX_PATTERN_LENGTH + 1];
+    if (tournament.bracket_size) {
+        PlayerRecord *champion = &tournament.players[tournament.champion];
+        printf("Champion: player %d, %s\n", tournament.champion,
+               pattern_display(champion->pattern, champion->pattern_length, scratch));
+    }
+    if (!order) {
+        order = malloc(count * sizeof(int));
+        if (!order) {
+            perror("Allocation failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    ranking_tournament = &tournament;
+    for (int i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    qsort(order, count, sizeof(int), compare_standing);
+    printf("\nRANK  PLAYER  PATTERN          POINTS  MATCHES  GAMES\n");
+    for (int i = 0; i < count && i < TOURNAMENT_LEADERS; i++) {
+        PlayerRecord *player = &tournament.players[order[i]];
+        printf("%4d  %6d  %-15s  %6d  %3d-%-3d  %3d-%d\n", i + 1, order[i],
+               pattern_display(player->pattern, player->pattern_length, scratch), player->match_wins + player->byes,
+               player->match_wins, player->match_losses, player->game_wins, player->game_losses);
+    }
+
+    // Pattern standings, best match win rate first
+    PatternRecord *rows = malloc(tournament.row_count * sizeof(PatternRecord));
+    int row_count = 0;
+    for (int r = 0; rows && r < TOURNAMENT_PATTERN_ROWS; r++) {
+        if (tournament.rows[r].pattern_length) {
+            rows[row_count++] = tournament.rows[r];
+        }
+    }
+    qsort(rows, row_count, sizeof(PatternRecord), compare_rows);
+    printf("\nPATTERN          PLAYERS  MATCHES  MATCH WIN%%  GAME WIN%%  SHARED  TOSSES/GAME\n");
+    for (int r = 0; r < row_count && r < TOURNAMENT_PATTERNS_SHOWN; r++) {
+        PatternRecord *row = &rows[r];
+        unsigned long long decided = row->games - row->shared_games;
+        printf("%-15s  %7d  %7llu  %9.1f  %9.1f  %6llu  %11.2f\n",
+               pattern_display(row->pattern, row->pattern_length, scratch), row->players, row->matches,
+               row->matches ? 100.0 * row->match_wins / row->matches : 0.0,
+               decided ? 100.0 * row->game_wins / decided : 0.0, row->shared_games,
+               row->games ? (double)row->tosses / row->games : 0.0);
+    }
+    if (row_count > TOURNAMENT_PATTERNS_SHOWN) {
+        printf("(%d more patterns)\n", row_count - TOURNAMENT_PATTERNS_SHOWN);
+    }
+
+    free(rows);
+    free(threads);
+    free(workers);
+    free(order);
+    free(opponents);
+    free(tournament.queue);
+    free(tournament.matches);
+    free(tournament.rows);
+    free(tournament.players);
+    return 0;
+}
@@ -0,0 +1,325 @@
+// turbo.c
+//
+// Headless game simulator. Builds the real server logic (server.c without
+// its main) and plays it against in-memory virtual clients: no sockets, no
+// timers, just handle_client_message, send_coin_flip, process_win_claim and
+// update_pattern_stats as fast as they run. Server logging goes to
+// /dev/null unless -v is given; the report goes to the original stdout.
+//
+// Usage: ./turbo [-g games] [-S seed] [-f] [-l tosses] [-H history_dir] [-v] [pattern ...]   (default HHT THH)
+// -f plays in fairness mode (wins settled on the toss index, see server.c).
+// -l delays the first pattern's claims by this many tosses; they name the toss
+//    that completed the pattern, like an extended client's claim crossing a slow link.
+// -H appends every game to a game history store (see history.h).
+
+#define SERVER_EMBEDDED
+#include "server.c"
+
+#define TURBO_INBOX 64 // Frames virtual clients may post between two tosses
+
+// Structure to hold a virtual client
+typedef struct {
+    const char *text;
+    uint64_t pattern;
+    int pattern_length;
+    uint64_t mask;
+    uint8_t client_id;
+    int registered;
+    uint64_t window;    // Rolling window of the last pattern_length tosses
+    int flips;          // Tosses seen in the current game
+    int claimed;        // WIN sent in the current game
+    int verdict;        // WIN or LOSE received in the current game
+    uint8_t tx_seq;     // Sequence of the last reliable claim
+} VirtualClient;
+
+// Frame posted by a virtual client for the server
+typedef struct {
+    int player;
+    uint16_t message;   // ALP word in network byte order
+    uint8_t flags;
+    uint8_t seq;
+    unsigned long long due; // Toss count at which the frame reaches the server
+} TurboFrame;
+
+// Structure to hold the simulation: the virtual clients and their outbox
+typedef struct {
+    VirtualClient players[MAX_CLIENTS];
+    int player_count;
+    TurboFrame inbox[TURBO_INBOX];
+    int inbox_count;
+    unsigned long long claims;
+    unsigned long long tosses;
+    int late_tosses;                // Delay of the first pattern's claims
+    unsigned long long late_claims; // Claims that were delayed
+    unsigned long long unanswered;  // Players a finished game sent neither WIN nor LOSE
+} Simulation;
+
+// Function to build a client ALP word (clients never set the transmitter or toss bits)
+uint16_t turbo_client_message(uint8_t message_code, uint8_t client_id, uint8_t sequence) {
+    uint16_t message = (message_code & 0b11) << BITS_MESSAGE;
+    message |= (client_id & 0b1111) << BITS_CLIENT_ID;
+    message |= sequence & 0xFF;
+    return htons(message);
+}
+
+// Function to receive a frame the server sent to a virtual client (Transport sink)
+void turbo_sink(void *context, const struct sockaddr_in *address, const void *frame, size_t length) {
+    Simulation *sim = context;
+    int index = ntohs(address->sin_port) - 1;
+    if (index < 0 || index >= sim->player_count || length < sizeof(uint16_t)) {
+        return;
+    }
+    VirtualClient *player = &sim->players[index];
+
+    if (length >= sizeof(ControlFrame) && (((const ControlFrame *)frame)->flags & FRAME_FLAG_ACK)) {
+        return; // Acknowledges a late claim, nothing to do
+    }
+
+    uint16_t word;
+    memcpy(&word, frame, sizeof(word));
+    word = ntohs(word);
+    uint8_t toss = (word >> BIT_TOSS) & 0b1;
+    uint8_t message_code = (word >> BITS_MESSAGE) & 0b11;
+
+    if (message_code == MSG_REGISTER) {
+        player->client_id = (word >> BITS_CLIENT_ID) & 0b1111;
+        player->registered = 1;
+    } else if (message_code == MSG_TOSSING && !player->claimed) {
+        // Same O(1) rolling-window check as client.c
+        player->window = ((player->window << 1) | toss) & player->mask;
+        player->flips++;
+        if (player->flips >= player->pattern_length && player->window == player->pattern &&
+            sim->inbox_count < TURBO_INBOX) {
+            TurboFrame *claim = &sim->inbox[sim->inbox_count++];
+            claim->player = index;
+            claim->message = turbo_client_message(MSG_WIN, player->client_id, 0);
+            claim->flags = 0;
+            claim->seq = 0;
+            claim->due = sim->tosses + 1; // Arrives right after the toss being sent
+            if (index == 0 && sim->late_tosses > 0) {
+                // A late claim names its toss, so the server judges it against that toss
+                claim->message = turbo_client_message(MSG_WIN, player->client_id, (player->flips - 1) & 0xFF);
+                claim->flags = FRAME_FLAG_RELIABLE;
+                claim->seq = ++player->tx_seq;
+                claim->due += sim->late_tosses;
+                sim->late_claims++;
+            }
+            player->claimed = 1;
+        }
+    } else if ((message_code == MSG_WIN || message_code == MSG_LOSE) && !toss) {
+        player->verdict = 1;
+    }
+}
+
+// Function to parse an 'H'/'T' pattern, returns -1 if it is invalid
+int turbo_parse_pattern(const char *text, VirtualClient *player) {
+    int length = strlen(text);
+    if (length < 1 || length > MAX_PATTERN_LENGTH) {
+        return -1;
+    }
+    player->pattern = 0;
+    for (int i = 0; i < length; i++) {
+        char c = toupper(text[i]);
+        if (c != 'H' && c != 'T') {
+            return -1;
+        }
+        player->pattern = (player->pattern << 1) | (c == 'T');
+    }
+    player->text = text;
+    player->pattern_length = length;
+    player->mask = PATTERN_MASK(length);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    static Simulation sim; // Holds the inbox, keep it off the stack
+    long game_count = 100000;
+    unsigned int seed = time(NULL);
+    int verbose = 0;
+    int fair = 0;
+    const char *history_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "g:S:fl:H:v")) != -1) {
+        switch (opt) {
+            case 'g':
+                game_count = atol(optarg);
+                break;
+            case 'S':
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                fair = 1;
+                break;
+            case 'l':
+                sim.late_tosses = atoi(optarg);
+                break;
+            case 'H':
+                history_path = optarg;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-g games] [-S seed] [-f] [-l tosses] [-H history_dir] [-v] [pattern ...]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    static const char *default_patterns[] = {"HHT", "THH"};
+    const char **patterns = (const char **)&argv[optind];
+    int pattern_count = argc - optind;
+    if (pattern_count == 0) {
+        patterns = default_patterns;
+        pattern_count = 2;
+    }
+    if (pattern_count < MIN_PLAYERS || pattern_count > MAX_CLIENTS) {
+        fprintf(stderr, "Need %d to %d patterns\n", MIN_PLAYERS, MAX_CLIENTS);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < pattern_count; i++) {
+        if (turbo_parse_pattern(patterns[i], &sim.players[i]) < 0) {
+            fprintf(stderr, "Invalid pattern %s (1 to %d of 'H'/'T')\n", patterns[i], MAX_PATTERN_LENGTH);
+            exit(EXIT_FAILURE);
+        }
+    }
+    sim.player_count = pattern_count;
+
+    // The report keeps the real stdout, server logging is discarded
+    FILE *report = stdout;
+    if (!verbose) {
+        report = fdopen(dup(STDOUT_FILENO), "w");
+        if (!report || !freopen("/dev/null", "w", stdout)) {
+            perror("Redirecting server output failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Server state, exactly as server.c's main keeps it
+    ClientInfo clients[MAX_CLIENTS];
+    PatternStats pattern_stats[MAX_PATTERN_STATS];
+    int pattern_stats_count = 0;
+    static Game games[MAX_GAMES];
+    int completed_games = 0;
+    initialize_clients(clients);
+    srand(seed);
+    // One table of every virtual client, seated as soon as they are all queued
+    Matchmaker matchmaker;
+    initialize_matchmaker(&matchmaker, sim.player_count);
+    matchmaker.wait_ms = 0;
+    matchmaker.mix_ms = 0;
+    static RngHealth rng_health;
+    rng_health_init(&rng_health);
+
+    Transport transport;
+    memset(&transport, 0, sizeof(transport));
+    transport.server_fd = -1;
+    transport.addr_len = sizeof(struct sockaddr_in);
+    transport.sink = turbo_sink;
+    transport.sink_context = &sim;
+    transport.fair = fair;
+    static HistoryStore history;
+    if (history_path) {
+        if (history_open(&history, history_path) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        transport.history = &history;
+    }
+
+    // Register every virtual client with its full pattern; the port names the player
+    for (int i = 0; i < sim.player_count; i++) {
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(i + 1);
+        VirtualClient *player = &sim.players[i];
+        int short_length = player->pattern_length < SHORT_PATTERN_LENGTH ? player->pattern_length : SHORT_PATTERN_LENGTH;
+        uint16_t message = htons((MSG_REGISTER << BITS_MESSAGE) | ((short_length - 1) << 9) | (player->pattern & 0xFF));
+        PatternPayload full = {player->pattern_length, htobe64(player->pattern)};
+        handle_client_message(&transport, clients, pattern_stats, &pattern_stats_count,
+                              message, FRAME_FLAG_PATTERN, 0, (const uint8_t *)&full, sizeof(full),
+                              address, games, &completed_games);
+        if (!player->registered) {
+            fprintf(report, "Virtual client %s was not registered\n", player->text);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (completed_games < game_count) {
+        if (!games[0].in_progress) {
+            // Everyone plays again: READY queues them and the matchmaker seats the table in game 0.
+            // Claims still on their way belong to the finished game and are lost with it.
+            sim.inbox_count = 0;
+            for (int i = 0; i < sim.player_count; i++) {
+                VirtualClient *player = &sim.players[i];
+                if (player->flips > 0 && !player->verdict) {
+                    sim.unanswered++;
+                }
+                player->window = 0;
+                player->flips = 0;
+                player->claimed = 0;
+                player->verdict = 0;
+                handle_client_message(&transport, clients, pattern_stats, &pattern_stats_count,
+                                      turbo_client_message(MSG_READY, player->client_id, 0), 0, 0, NULL, 0,
+                                      clients[find_client_index(clients, player->client_id)].address,
+                                      games, &completed_games);
+            }
+            run_matchmaker(&matchmaker, clients, games);
+            continue;
+        }
+
+        send_coin_flip(&transport, clients, games, 0, &rng_health);
+        sim.tosses++;
+
+        // Claims are handled after the toss, as if they had just arrived; late ones wait their turn
+        int waiting = 0;
+        for (int f = 0; f < sim.inbox_count; f++) {
+            TurboFrame claim = sim.inbox[f];
+            if (claim.due > sim.tosses) {
+                sim.inbox[waiting++] = claim;
+                continue;
+            }
+            VirtualClient *player = &sim.players[claim.player];
+            int client_index = find_client_index(clients, player->client_id);
+            sim.claims++;
+            handle_client_message(&transport, clients, pattern_stats, &pattern_stats_count,
+                                  claim.message, claim.flags, claim.seq, NULL, 0, clients[client_index].address,
+                                  games, &completed_games);
+        }
+        sim.inbox_count = waiting;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    fprintf(report, "\n--- Turbo simulation (seed %u) ---\n", seed);
+    fprintf(report, "Games: %d, Tosses: %llu, Claims: %llu\n", completed_games, sim.tosses, sim.claims);
+    if (sim.late_tosses > 0) {
+        fprintf(report, "Late claims: %llu (%d tosses late)\n", sim.late_claims, sim.late_tosses);
+    }
+    fprintf(report, "Players left without a verdict: %llu\n", sim.unanswered);
+    fprintf(report, "Elapsed: %.3f s, %.0f tosses/s, %.0f games/s\n",
+            elapsed, sim.tosses / elapsed, completed_games / elapsed);
+    for (int j = 0; j < pattern_stats_count; j++) {
+        char scratch[MAX_PATTERN_LENGTH + 1];
+        fprintf(report, "Pattern: %s, Wins: %d, Total Games: %d, Win Probability: %.4f, Average Flips: %.2f, Expected Flips Alone: %.0f\n",
+                pattern_display(pattern_stats[j].pattern, pattern_stats[j].pattern_length, scratch),
+                pattern_stats[j].wins, pattern_stats[j].total_games,
+                (double)pattern_stats[j].wins / pattern_stats[j].total_games,
+                (double)pattern_stats[j].total_flips / pattern_stats[j].total_games,
+                pattern_expected_wait(pattern_stats[j].pattern, pattern_stats[j].pattern_length));
+    }
+    char health[BUFFER_SIZE];
+    rng_health_describe(&rng_health, health, sizeof(health));
+    fprintf(report, "RNG health: %s\n", health);
+    if (transport.history) {
+        fprintf(report, "History: %llu games appended, %llu in %s (%d segments)\n", history.appended,
+                (unsigned long long)history_games(&history), history_path, history.segment_count);
+        history_close(&history);
+    }
+    fprintf(report, "-------------------\n");
+    fclose(report);
+    return 0;
+}